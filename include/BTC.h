@@ -5,6 +5,13 @@
 #include "ptr_/SharedConstObjPtr.h"
 #include "serialize_/data_type.h"
 #include "serialize_/btc.h"
+#include "serialize_/view.h"
+#include "serialize_/reader.h"
+#include "serialize_/writer.h"
+#include "serialize_/record_log.h"
+#include "serialize_/mapped_file.h"
+#include "serialize_/parallel.h"
+#include "serialize_/snapshot.h"
 
 namespace BTC {
 
@@ -12,6 +19,32 @@ namespace BTC {
 typedef serialize_::BTagCompound BTagCompound;
 typedef ptr_::SharedObjPtr<BTagCompound> BTagCompoundPtr;
 typedef ptr_::SharedConstObjPtr<BTagCompound> BTagCompoundConstPtr;
+typedef serialize_::Projection Projection;
+using serialize_::makeTag;
+
+// Read-only access to serialized data
+typedef serialize_::BTagCompoundView BTagCompoundView;
+typedef serialize_::BTagReader BTagReader;
+typedef serialize_::BTagHandler BTagHandler;
+typedef serialize_::BTagWriter BTagWriter;
+typedef serialize_::RecordLogWriter RecordLogWriter;
+typedef serialize_::RecordLogReader RecordLogReader;
+#if defined(__unix__) || defined(__APPLE__)
+typedef serialize_::MappedFile MappedFile;
+#endif
+#ifdef ASSERT_C11
+using serialize_::parallelDecode;
+using serialize_::parallelSerialize;
+#endif
+#ifdef ATOMIC_REFCOUNT
+typedef serialize_::SharedCompound SharedCompound;
+typedef serialize_::SnapshotReader SnapshotReader;
+typedef serialize_::SnapshotWriter SnapshotWriter;
+#endif
+
+// Buffers
+typedef serialize_::BufferSink BufferSink;
+typedef serialize_::BufferSource BufferSource;
 
 // Data types
 typedef serialize_::SIZE_T SIZE_T;
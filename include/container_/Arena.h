@@ -0,0 +1,160 @@
+#ifndef BTC_CONTAINER_ARENA_H
+#define BTC_CONTAINER_ARENA_H
+
+#include <cstddef>
+#include <new>
+#ifdef ATOMIC_REFCOUNT
+#include <mutex>
+#endif
+
+namespace BTC {
+namespace container_ {
+
+/**
+* Monotonic allocator.
+* Memory is handed out from large blocks by advancing a pointer and is
+* only given back all at once by release() or the destructor.
+* Optionally the first block is memory of the caller (e.g. on the stack).
+* Destructors are not called by the arena, objects that need one have to
+* be destroyed before the memory is released.
+* With ATOMIC_REFCOUNT allocate() takes a lock, so lazy tags of a shared
+* tree may load from the same arena in several threads.
+**/
+class Arena {
+
+    // Header in front of every allocated block.
+    struct Block {
+        Block* next;
+    };
+
+    static const size_t ALIGNMENT = 16;
+
+    char* pos;
+    char* end;
+    Block* blocks;
+    char* initial;
+    size_t initial_size;
+    size_t block_size;
+    size_t count;
+#ifdef ATOMIC_REFCOUNT
+    std::mutex lock;
+#endif
+
+    Arena(const Arena& arena);
+    Arena& operator=(const Arena& arena);
+
+    static size_t alignUp(size_t n);
+    char* newBlock(size_t size);
+    void setRange(char* begin, size_t size);
+
+public:
+    static const size_t DEFAULT_BLOCK_SIZE = 65536;
+
+    explicit Arena(size_t block_size = DEFAULT_BLOCK_SIZE);
+    // The arena starts with the memory buffer of the caller.
+    Arena(char* buffer, size_t size, size_t block_size = DEFAULT_BLOCK_SIZE);
+    ~Arena();
+
+    // Memory for n bytes, aligned to 16 bytes.
+    // Both throw std::bad_alloc if the size does not fit into size_t.
+    void* allocate(size_t n);
+    template<class T> T* allocateArray(size_t n);
+
+    // Frees all blocks, the memory of the caller is reused.
+    void release();
+
+    // Number of blocks allocated on the heap.
+    size_t blockCount() const;
+};
+
+inline size_t Arena::alignUp(size_t n)
+{
+    return((n + ALIGNMENT-1) & ~(ALIGNMENT-1));
+}
+
+inline void Arena::setRange(char* begin, size_t size)
+{
+    size_t skip = alignUp(reinterpret_cast<size_t>(begin)) - reinterpret_cast<size_t>(begin);
+    if(skip > size) skip = size;
+    pos = begin + skip;
+    end = begin + size;
+}
+
+inline Arena::Arena(size_t bs)
+        : pos(0), end(0), blocks(0), initial(0), initial_size(0), block_size(bs), count(0)
+{
+}
+
+inline Arena::Arena(char* buffer, size_t size, size_t bs)
+        : pos(0), end(0), blocks(0), initial(buffer), initial_size(size), block_size(bs), count(0)
+{
+    setRange(initial,initial_size);
+}
+
+inline Arena::~Arena()
+{
+    release();
+}
+
+// Allocates a block with room for size bytes behind the header.
+inline char* Arena::newBlock(size_t size)
+{
+    char* memory = new char[alignUp(sizeof(Block)) + size];
+    Block* block = reinterpret_cast<Block*>(memory);
+    block->next = blocks;
+    blocks = block;
+    ++count;
+    return(memory + alignUp(sizeof(Block)));
+}
+
+inline void* Arena::allocate(size_t n)
+{
+#ifdef ATOMIC_REFCOUNT
+    std::lock_guard<std::mutex> guard(lock);
+#endif
+    if(n > size_t(-1) - ALIGNMENT - alignUp(sizeof(Block))) throw std::bad_alloc();
+    n = alignUp(n);
+    if(n > size_t(end-pos))
+    {
+        if(4*n > block_size)
+        {
+            // Large allocations get their own block, the current one stays.
+            return(newBlock(n));
+        }
+        pos = newBlock(block_size);
+        end = pos + block_size;
+    }
+    char* result = pos;
+    pos += n;
+    return(result);
+}
+
+template<class T>
+T* Arena::allocateArray(size_t n)
+{
+    if(n > size_t(-1)/sizeof(T)) throw std::bad_alloc();
+    return(static_cast<T*>(allocate(n*sizeof(T))));
+}
+
+inline void Arena::release()
+{
+    while(blocks)
+    {
+        Block* next = blocks->next;
+        delete[] reinterpret_cast<char*>(blocks);
+        blocks = next;
+    }
+    count = 0;
+    pos = 0;
+    end = 0;
+    if(initial) setRange(initial,initial_size);
+}
+
+inline size_t Arena::blockCount() const
+{
+    return(count);
+}
+
+}}
+
+#endif
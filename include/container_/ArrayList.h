@@ -55,6 +55,7 @@ public:
     template<class... Args> void add_new(Args&&... args);
 #endif
     template<class Container_T> void add_all(const Container_T& cont);
+    void insert(const T& element, size_t i);
 
     void setCapacity(size_t cap);
     void clear();
@@ -233,11 +234,28 @@ void ArrayList<T>::add_all(const Container_T& cont)
     data.insert(data.end(),cont.begin(),cont.end());
 }
 
+template<class T>
+void ArrayList<T>::insert(const T& element, size_t i)
+{
+#ifdef DEBUG
+    if(i > data.size())
+    {
+        std::cout << "Error (ArrayList.insert): Index out of range!" << std::endl;
+        exit(1);
+    }
+#endif
+    data.insert(data.begin()+i,element);
+}
+
 template<class T>
 void ArrayList<T>::setCapacity(size_t cap)
 {
     if(cap > data.size()) data.reserve(cap);
+#ifdef ASSERT_C11
     else data.shrink_to_fit();
+#else
+    else std::vector<T>(data).swap(data);
+#endif
 }
 
 template<class T>
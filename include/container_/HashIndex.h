@@ -0,0 +1,121 @@
+#ifndef BTC_CONTAINER_HASHINDEX_H
+#define BTC_CONTAINER_HASHINDEX_H
+
+#include <cstddef>
+#include <vector>
+
+namespace BTC {
+namespace container_ {
+
+/**
+* FNV-1a hash of a byte string (32 bit parameters, widened to size_t).
+**/
+inline size_t hashBytes(const char* data, size_t len)
+{
+    size_t hash = 2166136261u;
+    for(size_t i=0; i<len; ++i)
+    {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 16777619u;
+    }
+    return(hash);
+}
+
+/**
+* Open addressing hash table that maps hashes to positions in an external list.
+* The keys themselves are not stored: every slot holds the full hash and the
+* position, a candidate with equal hash is confirmed by the match predicate
+* of the caller (match(position) -> bool).
+* Lookups never allocate. Linear probing, the load is kept below 1/2.
+**/
+class HashIndex {
+
+    struct Slot {
+        size_t hash;
+        size_t position;
+    };
+
+    std::vector<Slot> slots;
+    size_t count;
+
+    void grow();
+
+public:
+    static const size_t npos = size_t(-1);
+
+    HashIndex();
+
+    // Properties
+    size_t size() const;
+
+    // Add a position, the hash must not be contained yet with a matching key.
+    void insert(size_t hash, size_t position);
+    // Position of the entry with the hash that fulfills match, npos if none.
+    template<class Match> size_t find(size_t hash, const Match& match) const;
+
+    void clear();
+};
+
+inline HashIndex::HashIndex() : slots(), count(0)
+{
+}
+
+inline size_t HashIndex::size() const
+{
+    return(count);
+}
+
+inline void HashIndex::grow()
+{
+    std::vector<Slot> old;
+    old.swap(slots);
+    Slot empty;
+    empty.hash = 0;
+    empty.position = npos;
+    slots.resize(old.empty() ? 16 : 2*old.size(),empty);
+    size_t mask = slots.size()-1;
+    for(size_t i=0; i<old.size(); ++i)
+    {
+        if(old[i].position != npos)
+        {
+            size_t j = old[i].hash & mask;
+            while(slots[j].position != npos) j = (j+1) & mask;
+            slots[j] = old[i];
+        }
+    }
+}
+
+inline void HashIndex::insert(size_t hash, size_t position)
+{
+    if(2*(count+1) > slots.size()) grow();
+    size_t mask = slots.size()-1;
+    size_t i = hash & mask;
+    while(slots[i].position != npos) i = (i+1) & mask;
+    slots[i].hash = hash;
+    slots[i].position = position;
+    ++count;
+}
+
+template<class Match>
+size_t HashIndex::find(size_t hash, const Match& match) const
+{
+    if(slots.empty()) return(npos);
+    size_t mask = slots.size()-1;
+    size_t i = hash & mask;
+    while(slots[i].position != npos)
+    {
+        if(slots[i].hash == hash && match(slots[i].position)) return(slots[i].position);
+        i = (i+1) & mask;
+    }
+    return(npos);
+}
+
+inline void HashIndex::clear()
+{
+    slots.clear();
+    count = 0;
+}
+
+}}
+
+#endif
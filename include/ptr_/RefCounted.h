@@ -0,0 +1,77 @@
+#ifndef BTC_PTR_REFCOUNTED_H
+#define BTC_PTR_REFCOUNTED_H
+
+#include <cstddef>
+#ifdef ATOMIC_REFCOUNT
+#ifndef ASSERT_C11
+#error "ATOMIC_REFCOUNT needs ASSERT_C11"
+#endif
+#include <atomic>
+#endif
+
+namespace BTC {
+namespace ptr_ {
+
+template<typename T> class SharedObjPtr;
+template<typename T> class SharedConstObjPtr;
+
+// Base of the objects held by SharedObjPtr and SharedConstObjPtr, the
+// reference count is stored in the object itself (no extra allocation).
+// A copy of an object starts with its own count.
+// With ATOMIC_REFCOUNT defined the count is atomic, so pointers to the
+// same object can be copied and destroyed in several threads at once.
+// An object constructed in memory it does not own (e.g. of an arena) is
+// marked with setPooled(), the last release then only runs its destructor.
+class RefCounted {
+
+    template<typename T> friend class SharedObjPtr;
+    template<typename T> friend class SharedConstObjPtr;
+
+#ifdef ATOMIC_REFCOUNT
+    mutable std::atomic<size_t> refcount;
+#else
+    mutable size_t refcount;
+#endif
+    bool pooled;
+
+    void addReference() const {
+#ifdef ATOMIC_REFCOUNT
+        refcount.fetch_add(1,std::memory_order_relaxed);
+#else
+        ++refcount;
+#endif
+    }
+
+    // True if it was the last reference.
+    bool removeReference() const {
+#ifdef ATOMIC_REFCOUNT
+        return(refcount.fetch_sub(1,std::memory_order_acq_rel) == 1);
+#else
+        return(--refcount == 0);
+#endif
+    }
+
+  protected:
+    RefCounted() : refcount(0), pooled(false) {}
+
+    RefCounted(const RefCounted&) : refcount(0), pooled(false) {}
+
+    RefCounted& operator=(const RefCounted&) {
+        return(*this);
+    }
+
+    ~RefCounted() {}
+
+  public:
+    void setPooled() {
+        pooled = true;
+    }
+
+    bool isPooled() const {
+        return(pooled);
+    }
+};
+
+}}
+
+#endif
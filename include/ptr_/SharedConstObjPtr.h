@@ -1,57 +1,55 @@
 #ifndef BTC_PTR_SHAREDCONSTOBJPOINTER_H
 #define BTC_PTR_SHAREDCONSTOBJPOINTER_H
 
+#include "SharedObjPtr.h"
+
 namespace BTC {
 namespace ptr_ {
 
+// Shared pointer to a const object, see SharedObjPtr.
 template<typename T>
-struct ConstObjPtrData {
+class SharedConstObjPtr {
 
-    const T* data;
-    size_t counter;
+    template<typename U> friend class SharedConstObjPtr;
 
-    ConstObjPtrData() : data(0), counter(0) {}
+    const T* data;
 
-    ~ConstObjPtrData() {
-        delete data;
+    void acquire() {
+        if (data) {
+            static_cast<const RefCounted*>(data)->addReference();
+        }
     }
-};
-
-template<typename T>
-class SharedConstObjPtr {
 
-    template<typename U> friend class SharedConstObjPtr;
-
-    ConstObjPtrData<T>* data;
+    void release() {
+        if (data && static_cast<const RefCounted*>(data)->removeReference()) {
+            if (static_cast<const RefCounted*>(data)->isPooled()) {
+                data->~T();
+            } else {
+                delete data;
+            }
+        }
+    }
 
   public:
-    SharedConstObjPtr() : data(0) {
-        data = new ConstObjPtrData<T>();
-        ++(data->counter);
-    }
+    SharedConstObjPtr() : data(0) {}
 
     SharedConstObjPtr(const SharedConstObjPtr<T>& ptr) : data(ptr.data) {
-        ++(data->counter);
+        acquire();
     }
 
     // Const pointer can be constructed from non-const pointer.
     // (But not vice versa!)
-    SharedConstObjPtr(const SharedObjPtr<T>& ptr) : data(0) {
-        data = reinterpret_cast<ConstObjPtrData<T>*>(ptr.data);
-        ++(data->counter);
+    SharedConstObjPtr(const SharedObjPtr<T>& ptr) : data(ptr.data) {
+        acquire();
     }
 
-    SharedConstObjPtr(const T* d) : data(0) {
-        data = new ConstObjPtrData<T>();
-        data->data = d;
-        ++(data->counter);
+    // Takes ownership of d.
+    SharedConstObjPtr(const T* d) : data(d) {
+        acquire();
     }
 
     ~SharedConstObjPtr() {
-        --(data->counter);
-        if (data->counter == 0) {
-            delete data;
-        }
+        release();
     }
 
     static SharedConstObjPtr<T> fromObject(const T* d) {
@@ -59,34 +57,32 @@ class SharedConstObjPtr {
         return ptr;
     }
 
+    // U and T have to be related, the object is not checked.
     template<typename U>
-    static SharedConstObjPtr<T> reinterpretCast(SharedConstObjPtr<U>& ptr) {
-        SharedConstObjPtr<T> new_ptr;
-        delete new_ptr.data;
-        new_ptr.data = reinterpret_cast<ConstObjPtrData<T>*>(ptr.data);
-        ++((new_ptr.data)->counter);
-        return new_ptr;
+    static SharedConstObjPtr<T> reinterpretCast(const SharedConstObjPtr<U>& ptr) {
+        return SharedConstObjPtr<T>(static_cast<const T*>(ptr.data));
     }
 
     SharedConstObjPtr<T>& operator=(const SharedConstObjPtr<T>& ptr) {
-        --(data->counter);
-        if (data->counter == 0) {
-            delete data;
-        }
-        data = ptr.data;
-        ++(data->counter);
+        SharedConstObjPtr<T> temp(ptr);
+        swap(temp);
+        return *this;
     }
 
     const T& operator*() const {
-        return *(data->data);
+        return *data;
     }
 
     const T* operator->() const {
-        return data->data;
+        return data;
+    }
+
+    bool isNull() const {
+        return(data == 0);
     }
 
     void swap(SharedConstObjPtr<T>& ptr) {
-        ConstObjPtrData<T>* data_ptr = data;
+        const T* data_ptr = data;
         data = ptr.data;
         ptr.data = data_ptr;
     }
@@ -1,50 +1,59 @@
 #ifndef BTC_PTR_SHAREDOBJPOINTER_H
 #define BTC_PTR_SHAREDOBJPOINTER_H
 
+#include "RefCounted.h"
+
 namespace BTC {
 namespace ptr_ {
 
-template<typename T>
-struct ObjPtrData {
-
-    T* data;
-    size_t counter;
-
-    ObjPtrData() : data(0), counter(0) {}
-
-    ~ObjPtrData() {
-        delete data;
-    }
-};
+template<typename T> class SharedConstObjPtr;
 
+// Shared pointer with the reference count in the object, T has to derive
+// from RefCounted. A default constructed pointer is null.
 template<typename T>
 class SharedObjPtr {
 
     template<typename U> friend class SharedObjPtr;
+    template<typename U> friend class SharedConstObjPtr;
 
-    ObjPtrData<T>* data;
+    T* data;
 
-  public:
-    SharedObjPtr() : data(0) {
-        data = new ObjPtrData<T>();
-        ++(data->counter);
+    void acquire() {
+        if (data) {
+            static_cast<const RefCounted*>(data)->addReference();
+        }
+    }
+
+    void release() {
+        if (data && static_cast<const RefCounted*>(data)->removeReference()) {
+            if (static_cast<const RefCounted*>(data)->isPooled()) {
+                data->~T();
+            } else {
+                delete data;
+            }
+        }
     }
 
+  public:
+    SharedObjPtr() : data(0) {}
+
     SharedObjPtr(const SharedObjPtr<T>& ptr) : data(ptr.data) {
-        ++(data->counter);
+        acquire();
     }
 
-    explicit SharedObjPtr(T* d) : data(0) {
-        data = new ObjPtrData<T>();
-        data->data = d;
-        ++(data->counter);
+#ifdef ASSERT_C11
+    SharedObjPtr(SharedObjPtr<T>&& ptr) : data(ptr.data) {
+        ptr.data = 0;
+    }
+#endif
+
+    // Takes ownership of d.
+    explicit SharedObjPtr(T* d) : data(d) {
+        acquire();
     }
 
     ~SharedObjPtr() {
-        --(data->counter);
-        if (data->counter == 0) {
-            delete data;
-        }
+        release();
     }
 
     static SharedObjPtr<T> fromObject(T* d) {
@@ -52,35 +61,39 @@ class SharedObjPtr {
         return ptr;
     }
 
+    // U and T have to be related, the object is not checked.
     template<typename U>
     static SharedObjPtr<T> reinterpretCast(const SharedObjPtr<U>& ptr) {
-        SharedObjPtr<T> new_ptr;
-        delete new_ptr.data;
-        new_ptr.data = reinterpret_cast<ObjPtrData<T>*>(ptr.data);
-        ++((new_ptr.data)->counter);
-        return new_ptr;
+        return SharedObjPtr<T>(static_cast<T*>(ptr.data));
     }
 
     SharedObjPtr<T>& operator=(const SharedObjPtr<T>& ptr) {
-        --(data->counter);
-        if (data->counter == 0) {
-            delete data;
-        }
-        data = ptr.data;
-        ++(data->counter);
+        SharedObjPtr<T> temp(ptr);
+        swap(temp);
         return *this;
     }
 
+#ifdef ASSERT_C11
+    SharedObjPtr<T>& operator=(SharedObjPtr<T>&& ptr) {
+        swap(ptr);
+        return *this;
+    }
+#endif
+
     T& operator*() const {
-        return *(data->data);
+        return *data;
     }
 
     T* operator->() const {
-        return data->data;
+        return data;
+    }
+
+    bool isNull() const {
+        return(data == 0);
     }
 
     void swap(SharedObjPtr<T>& ptr) {
-        ObjPtrData<T>* data_ptr = data;
+        T* data_ptr = data;
         data = ptr.data;
         ptr.data = data_ptr;
     }
@@ -1,13 +1,31 @@
 #ifndef BTC_SERIALIZE_BTC_H
 #define BTC_SERIALIZE_BTC_H
 
+#include <cstring>
+#include <sstream>
+#include <vector>
+#ifdef ASSERT_C11
+#include <utility>
+#endif
+#ifdef ATOMIC_REFCOUNT
+#include <atomic>
+#include <mutex>
+#endif
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
 #include "container_/ArrayList.h"
+#include "container_/HashIndex.h"
 #include "container_/algorithm.h"
+#include "ptr_/RefCounted.h"
 #include "ptr_/SharedObjPtr.h"
 
+#include "buffer.h"
 #include "function.h"
 #include "data_type.h"
 #include "exception.h"
+#include "projection.h"
 
 namespace BTC {
 namespace serialize_ {
@@ -16,7 +34,8 @@ namespace serialize_ {
 // Logical data types
 
 // Interface for BTag data objects.
-class IBTagBase {
+// The reference count of SharedObjPtr is part of the object.
+class IBTagBase : public ptr_::RefCounted {
 
   public:
     virtual ~IBTagBase() {}
@@ -28,10 +47,61 @@ class IBTagBase {
     virtual void serialize(std::ostream& os) const = 0;
     // Deserialize the BTag from stream.
     virtual void deserialize(std::istream& is) = 0;
+    // Serialize the BTag to a buffer.
+    // The tags of this library override this, for other tags the default 
+    // goes through the stream version.
+    virtual void serialize(BufferSink& os) const {
+        std::ostringstream ss;
+        serialize(ss);
+        const std::string& bytes = ss.str();
+        os.write(bytes.data(),bytes.size());
+    }
+    // Deserialize the BTag from a buffer.
+    // The tags of this library override this, for other tags the default 
+    // goes through the stream version.
+    virtual void deserialize(BufferSource& is) {
+        if (is.getStream()) {
+            deserialize(*is.getStream());
+            return;
+        }
+        MemoryStreamBuf buf(is.current(),is.current()+is.remaining());
+        std::istream stream(&buf);
+        deserialize(stream);
+        is.skip(buf.consumed());
+    }
     // Human readable print of the BTag
     virtual std::ostream& print(std::ostream& os, unsigned char increment) const = 0;
 };
 
+// New tag object in a SharedObjPtr (one allocation), e.g.
+//     ptr_::SharedObjPtr<BTagCompound> comp = makeTag<BTagCompound>();
+#ifdef ASSERT_C11
+template<typename T, typename... Args>
+ptr_::SharedObjPtr<T> makeTag(Args&&... args) {
+    return ptr_::SharedObjPtr<T>(new T(std::forward<Args>(args)...));
+}
+#else
+template<typename T>
+ptr_::SharedObjPtr<T> makeTag() {
+    return ptr_::SharedObjPtr<T>(new T());
+}
+
+template<typename T, typename A1>
+ptr_::SharedObjPtr<T> makeTag(const A1& a1) {
+    return ptr_::SharedObjPtr<T>(new T(a1));
+}
+
+template<typename T, typename A1, typename A2>
+ptr_::SharedObjPtr<T> makeTag(const A1& a1, const A2& a2) {
+    return ptr_::SharedObjPtr<T>(new T(a1,a2));
+}
+
+template<typename T, typename A1, typename A2, typename A3>
+ptr_::SharedObjPtr<T> makeTag(const A1& a1, const A2& a2, const A3& a3) {
+    return ptr_::SharedObjPtr<T>(new T(a1,a2,a3));
+}
+#endif
+
 template<typename T>
 class BTagVal : public IBTagBase {
     
@@ -66,10 +136,18 @@ class BTagByte : public BTagVal<T> {
         serializeByte(os,this->data);
     }
 
+    void serialize(BufferSink& os) const {
+        serializeByte(os,this->data);
+    }
+
     void deserialize(std::istream& is) {
         this->data = deserializeByte(is);
     }
 
+    void deserialize(BufferSource& is) {
+        this->data = deserializeByte(is);
+    }
+
     std::ostream& print(std::ostream& os, unsigned char increment) const {
         os << "b{" << int(this->data) << '}';
         return os;
@@ -96,10 +174,18 @@ class BTagShort : public BTagVal<T> {
         serializeShort(os,this->data);
     }
 
+    void serialize(BufferSink& os) const {
+        serializeShort(os,this->data);
+    }
+
     void deserialize(std::istream& is) {
         this->data = deserializeShort(is);
     }
 
+    void deserialize(BufferSource& is) {
+        this->data = deserializeShort(is);
+    }
+
     std::ostream& print(std::ostream& os, unsigned char increment) const {
         os << "s{" << this->data << '}';
         return os;
@@ -126,10 +212,18 @@ class BTagInt : public BTagVal<T> {
         serializeInt(os,this->data);
     }
 
+    void serialize(BufferSink& os) const {
+        serializeInt(os,this->data);
+    }
+
     void deserialize(std::istream& is) {
         this->data = deserializeInt(is);
     }
 
+    void deserialize(BufferSource& is) {
+        this->data = deserializeInt(is);
+    }
+
     std::ostream& print(std::ostream& os, unsigned char increment) const {
         os << "i{" << this->data << '}';
         return os;
@@ -156,10 +250,18 @@ class BTagLong : public BTagVal<T> {
         serializeLong(os,this->data);
     }
 
+    void serialize(BufferSink& os) const {
+        serializeLong(os,this->data);
+    }
+
     void deserialize(std::istream& is) {
         this->data = deserializeLong(is);
     }
 
+    void deserialize(BufferSource& is) {
+        this->data = deserializeLong(is);
+    }
+
     std::ostream& print(std::ostream& os, unsigned char increment) const {
         os << "l{" << this->data << '}';
         return os;
@@ -186,10 +288,18 @@ class BTagFloat : public BTagVal<T> {
         serializeFloat(os,this->data);
     }
 
+    void serialize(BufferSink& os) const {
+        serializeFloat(os,this->data);
+    }
+
     void deserialize(std::istream& is) {
         this->data = deserializeFloat(is);
     }
 
+    void deserialize(BufferSource& is) {
+        this->data = deserializeFloat(is);
+    }
+
     std::ostream& print(std::ostream& os, unsigned char increment) const {
         os << "f{" << this->data << '}';
         return os;
@@ -216,16 +326,58 @@ class BTagDouble : public BTagVal<T> {
         serializeDouble(os,this->data);
     }
 
+    void serialize(BufferSink& os) const {
+        serializeDouble(os,this->data);
+    }
+
     void deserialize(std::istream& is) {
         this->data = deserializeDouble(is);
     }
 
+    void deserialize(BufferSource& is) {
+        this->data = deserializeDouble(is);
+    }
+
     std::ostream& print(std::ostream& os, unsigned char increment) const {
         os << "d{" << this->data << '}';
         return os;
     }
 };
 
+// Float in the layout of DataTypeID::FLOAT_LEGACY.
+// Only used to read old data, it is written back as DataTypeID::FLOAT.
+template<typename T>
+class BTagFloatLegacy : public BTagFloat<T> {
+
+  public:
+    BTagFloatLegacy() : BTagFloat<T>() {}
+
+    void deserialize(std::istream& is) {
+        this->data = deserializeFloatLegacy(is);
+    }
+
+    void deserialize(BufferSource& is) {
+        this->data = deserializeFloatLegacy(is);
+    }
+};
+
+// Double in the layout of DataTypeID::DOUBLE_LEGACY.
+// Only used to read old data, it is written back as DataTypeID::DOUBLE.
+template<typename T>
+class BTagDoubleLegacy : public BTagDouble<T> {
+
+  public:
+    BTagDoubleLegacy() : BTagDouble<T>() {}
+
+    void deserialize(std::istream& is) {
+        this->data = deserializeDoubleLegacy(is);
+    }
+
+    void deserialize(BufferSource& is) {
+        this->data = deserializeDoubleLegacy(is);
+    }
+};
+
 template<typename T>
 class BTagString : public BTagVal<T> {
 
@@ -246,16 +398,27 @@ class BTagString : public BTagVal<T> {
         serializeString(os,this->data);
     }
 
+    void serialize(BufferSink& os) const {
+        serializeString(os,this->data);
+    }
+
     void deserialize(std::istream& is) {
         this->data = deserializeString(is);
     }
 
+    void deserialize(BufferSource& is) {
+        this->data = deserializeString(is);
+    }
+
     std::ostream& print(std::ostream& os, unsigned char increment) const {
         os << "st{\"" << this->data << "\"}";
         return os;
     }
 };
 
+// Base of the array tags.
+// The array is deleted with the tag if owner is set. Arrays deserialized
+// with an arena are not owned.
 template<typename T>
 class BTagArr : public IBTagBase {
     
@@ -326,6 +489,10 @@ class BTagByteArr : public BTagArr<T> {
         serializeByteArray(os,this->len,this->data);
     }
 
+    void serialize(BufferSink& os) const {
+        serializeByteArray(os,this->len,this->data);
+    }
+
     void deserialize(std::istream& is) {
         if(this->owner) {
             delete[] this->data;
@@ -334,6 +501,14 @@ class BTagByteArr : public BTagArr<T> {
         this->owner = true;
     }
 
+    void deserialize(BufferSource& is) {
+        if(this->owner) {
+            delete[] this->data;
+        }
+        this->data = deserializeByteArray<T>(is,this->len);
+        this->owner = !is.getArena();
+    }
+
     std::ostream& print(std::ostream& os, UINT8_T increment) const {
         os << "ba{len=" << this->len << ",own=" << this->owner << '}';
         return os;
@@ -371,6 +546,10 @@ class BTagShortArr : public BTagArr<T> {
         serializeShortArray(os,this->len,this->data);
     }
 
+    void serialize(BufferSink& os) const {
+        serializeShortArray(os,this->len,this->data);
+    }
+
     void deserialize(std::istream& is) {
         if(this->owner) {
             delete[] this->data;
@@ -379,6 +558,14 @@ class BTagShortArr : public BTagArr<T> {
         this->owner = true;
     }
 
+    void deserialize(BufferSource& is) {
+        if(this->owner) {
+            delete[] this->data;
+        }
+        this->data = deserializeShortArray<T>(is,this->len);
+        this->owner = !is.getArena();
+    }
+
     std::ostream& print(std::ostream& os, UINT8_T increment) const {
         os << "sa{len=" << this->len << ",own=" << this->owner << '}';
         return os;
@@ -416,6 +603,10 @@ class BTagIntArr : public BTagArr<T> {
         serializeIntArray(os,this->len,this->data);
     }
 
+    void serialize(BufferSink& os) const {
+        serializeIntArray(os,this->len,this->data);
+    }
+
     void deserialize(std::istream& is) {
         if(this->owner) {
             delete[] this->data;
@@ -424,6 +615,14 @@ class BTagIntArr : public BTagArr<T> {
         this->owner = true;
     }
 
+    void deserialize(BufferSource& is) {
+        if(this->owner) {
+            delete[] this->data;
+        }
+        this->data = deserializeIntArray<T>(is,this->len);
+        this->owner = !is.getArena();
+    }
+
     std::ostream& print(std::ostream& os, UINT8_T increment) const {
         os << "ia{len=" << this->len << ",own=" << this->owner << '}';
         return os;
@@ -461,6 +660,10 @@ class BTagLongArr : public BTagArr<T> {
         serializeLongArray(os,this->len,this->data);
     }
 
+    void serialize(BufferSink& os) const {
+        serializeLongArray(os,this->len,this->data);
+    }
+
     void deserialize(std::istream& is) {
         if(this->owner) {
             delete[] this->data;
@@ -469,6 +672,14 @@ class BTagLongArr : public BTagArr<T> {
         this->owner = true;
     }
 
+    void deserialize(BufferSource& is) {
+        if(this->owner) {
+            delete[] this->data;
+        }
+        this->data = deserializeLongArray<T>(is,this->len);
+        this->owner = !is.getArena();
+    }
+
     std::ostream& print(std::ostream& os, UINT8_T increment) const {
         os << "la{len=" << this->len << ",own=" << this->owner << '}';
         return os;
@@ -506,6 +717,10 @@ class BTagFloatArr : public BTagArr<T> {
         serializeFloatArray(os,this->len,this->data);
     }
 
+    void serialize(BufferSink& os) const {
+        serializeFloatArray(os,this->len,this->data);
+    }
+
     void deserialize(std::istream& is) {
         if(this->owner) {
             delete[] this->data;
@@ -514,6 +729,14 @@ class BTagFloatArr : public BTagArr<T> {
         this->owner = true;
     }
 
+    void deserialize(BufferSource& is) {
+        if(this->owner) {
+            delete[] this->data;
+        }
+        this->data = deserializeFloatArray(is,this->len);
+        this->owner = !is.getArena();
+    }
+
     std::ostream& print(std::ostream& os, UINT8_T increment) const {
         os << "fa{len=" << this->len << ",own=" << this->owner << '}';
         return os;
@@ -551,6 +774,10 @@ class BTagDoubleArr : public BTagArr<T> {
         serializeDoubleArray(os,this->len,this->data);
     }
 
+    void serialize(BufferSink& os) const {
+        serializeDoubleArray(os,this->len,this->data);
+    }
+
     void deserialize(std::istream& is) {
         if(this->owner) {
             delete[] this->data;
@@ -559,12 +786,70 @@ class BTagDoubleArr : public BTagArr<T> {
         this->owner = true;
     }
 
+    void deserialize(BufferSource& is) {
+        if(this->owner) {
+            delete[] this->data;
+        }
+        this->data = deserializeDoubleArray(is,this->len);
+        this->owner = !is.getArena();
+    }
+
     std::ostream& print(std::ostream& os, UINT8_T increment) const {
         os << "da{len=" << this->len << ",own=" << this->owner << '}';
         return os;
     }
 };
 
+// Float array in the layout of DataTypeID::FLOAT_ARR_LEGACY.
+// Only used to read old data, it is written back as DataTypeID::FLOAT_ARR.
+template<typename T>
+class BTagFloatArrLegacy : public BTagFloatArr<T> {
+
+  public:
+    BTagFloatArrLegacy() : BTagFloatArr<T>() {}
+
+    void deserialize(std::istream& is) {
+        if(this->owner) {
+            delete[] this->data;
+        }
+        this->data = deserializeFloatArrayLegacy(is,this->len);
+        this->owner = true;
+    }
+
+    void deserialize(BufferSource& is) {
+        if(this->owner) {
+            delete[] this->data;
+        }
+        this->data = deserializeFloatArrayLegacy(is,this->len);
+        this->owner = !is.getArena();
+    }
+};
+
+// Double array in the layout of DataTypeID::DOUBLE_ARR_LEGACY.
+// Only used to read old data, it is written back as DataTypeID::DOUBLE_ARR.
+template<typename T>
+class BTagDoubleArrLegacy : public BTagDoubleArr<T> {
+
+  public:
+    BTagDoubleArrLegacy() : BTagDoubleArr<T>() {}
+
+    void deserialize(std::istream& is) {
+        if(this->owner) {
+            delete[] this->data;
+        }
+        this->data = deserializeDoubleArrayLegacy(is,this->len);
+        this->owner = true;
+    }
+
+    void deserialize(BufferSource& is) {
+        if(this->owner) {
+            delete[] this->data;
+        }
+        this->data = deserializeDoubleArrayLegacy(is,this->len);
+        this->owner = !is.getArena();
+    }
+};
+
 template<typename T>
 class BTagStringArr : public BTagArr<T> {
 
@@ -600,6 +885,10 @@ class BTagStringArr : public BTagArr<T> {
         serializeStringArray(os,this->len,this->data);
     }
 
+    void serialize(BufferSink& os) const {
+        serializeStringArray(os,this->len,this->data);
+    }
+
     void deserialize(std::istream& is) {
         if(this->owner) {
             delete[] this->data;
@@ -608,6 +897,14 @@ class BTagStringArr : public BTagArr<T> {
         this->owner = true;
     }
 
+    void deserialize(BufferSource& is) {
+        if(this->owner) {
+            delete[] this->data;
+        }
+        this->data = deserializeStringArray(is,this->len);
+        this->owner = true;
+    }
+
     std::ostream& print(std::ostream& os, UINT8_T increment) const {
         os << "sta{len=" << this->len << ",own=" << this->owner << '}';
         return os;
@@ -615,115 +912,1190 @@ class BTagStringArr : public BTagArr<T> {
 };
 
 
-// BTagCompound
+// Number array that is serialized in chunks of chunk_len elements.
+// Layout behind the byte size: the type of the chunks (the plain array 
+// type), the length, chunk_len, a table with the byte offset of every 
+// chunk (8 bytes each, counted from the end of the table) and the chunks
+// in the layout of the plain array type.
+// readSlice() reads a range of the serialized array by decoding only the
+// chunks that cover it. In memory the array is contiguous.
+template<typename T>
+class BTagChunkedArr : public BTagArr<T> {
+
+    // Elements of a chunk in the layout of the plain array type.
+    template<typename Sink>
+    void serializeElements(Sink& os, const T* values, SIZE_T n) const {
+        switch (array_type) {
+            case DataTypeID::UINT8_ARR: serializeWordArrayData<UINT8_T>(os,n,values); break;
+            case DataTypeID::UINT16_ARR: serializeWordArrayData<UINT16_T>(os,n,values); break;
+            case DataTypeID::UINT32_ARR: serializeWordArrayData<UINT32_T>(os,n,values); break;
+            case DataTypeID::UINT64_ARR: serializeWordArrayData<UINT64_T>(os,n,values); break;
+            case DataTypeID::FLOAT_ARR: serializeBitArrayData<UINT32_T>(os,n,values); break;
+            case DataTypeID::DOUBLE_ARR: serializeBitArrayData<UINT64_T>(os,n,values); break;
+        }
+    }
 
-class BTCTagEntry {
+    template<typename Source>
+    static void deserializeElements(Source& is, UINT8_T type_id, T* values, SIZE_T n) {
+        switch (type_id) {
+            case DataTypeID::UINT8_ARR: deserializeWordArrayData<UINT8_T>(is,n,values); break;
+            case DataTypeID::UINT16_ARR: deserializeWordArrayData<UINT16_T>(is,n,values); break;
+            case DataTypeID::UINT32_ARR: deserializeWordArrayData<UINT32_T>(is,n,values); break;
+            case DataTypeID::UINT64_ARR: deserializeWordArrayData<UINT64_T>(is,n,values); break;
+            case DataTypeID::FLOAT_ARR: deserializeBitArrayData<UINT32_T>(is,n,values); break;
+            case DataTypeID::DOUBLE_ARR: deserializeBitArrayData<UINT64_T>(is,n,values); break;
+        }
+    }
 
-  public:
-    STRING_T tag;
-    size_t position;
+    static SIZE_T chunkCount(SIZE_T length, SIZE_T chunk_length) {
+        return((chunk_length == 0) ? 0 : (length+chunk_length-1)/chunk_length);
+    }
 
-    bool operator<(const BTCTagEntry& entry) const {
-        return(tag.compare(entry.tag) < 0);
+    SIZE_T chunkByteSize(SIZE_T n) const {
+        return(getIntVarByteSize(n) + n*getElementByteSize(array_type));
     }
-};
 
-class BTCDataEntry {
+    template<typename Sink>
+    void serializeChunks(Sink& os) const {
+        serializeByte(os,array_type);
+        serializeIntVar(os,this->len);
+        serializeIntVar(os,chunk_len);
+        SIZE_T count = chunkCount(this->len,chunk_len);
+        UINT64_T offset = 0;
+        for (SIZE_T i=0; i<count; ++i) {
+            serializeLong(os,offset);
+            offset += chunkByteSize(std::min(chunk_len,this->len-i*chunk_len));
+        }
+        for (SIZE_T i=0; i<count; ++i) {
+            SIZE_T n = std::min(chunk_len,this->len-i*chunk_len);
+            serializeIntVar(os,n);
+            serializeElements(os,this->data+i*chunk_len,n);
+        }
+    }
+
+    template<typename Source>
+    void deserializeChunks(Source& is, bool own) {
+        if (this->owner) {
+            delete[] this->data;
+        }
+        this->data = 0;
+        this->len = 0;
+        this->owner = own;
+        UINT8_T type_id = deserializeByte(is);
+        if (type_id != array_type) {
+            throw unknown_type_error("BTC::serialize_::BTagChunkedArr::deserialize", type_id);
+        }
+        SIZE_T length = deserializeIntVar<SIZE_T>(is);
+        chunk_len = deserializeIntVar<SIZE_T>(is);
+        SIZE_T count = chunkCount(length,chunk_len);
+        this->data = newArray<T>(is,length,getElementByteSize(array_type));
+        this->len = length;
+        // the chunks follow each other, the table is not needed
+        for (SIZE_T i=0; i<count; ++i) {
+            deserializeLong(is);
+        }
+        SIZE_T filled = 0;
+        for (SIZE_T i=0; i<count; ++i) {
+            SIZE_T n = deserializeIntVar<SIZE_T>(is);
+            if (n > length-filled) {
+                throw buffer_overflow_error("BTC::serialize_::BTagChunkedArr::deserialize", n, length-filled);
+            }
+            deserializeElements(is,array_type,this->data+filled,n);
+            filled += n;
+        }
+        if (filled != length) {
+            throw buffer_overflow_error("BTC::serialize_::BTagChunkedArr::deserialize", length, filled);
+        }
+    }
 
   public:
-    STRING_T tag;
-    ptr_::SharedObjPtr<IBTagBase> data;
+    static const SIZE_T DEFAULT_CHUNK_LENGTH = 4096;
 
-    BTCDataEntry()
-            : tag(), data() {
-    }
+    // The plain array type of the elements (e.g. DataTypeID::DOUBLE_ARR).
+    UINT8_T array_type;
+    SIZE_T chunk_len;
 
-    BTCDataEntry(const STRING_T& t, ptr_::SharedObjPtr<IBTagBase> d)
-            : tag(t), data(d) {
-    }
-};
+    explicit BTagChunkedArr(UINT8_T type_id) 
+            : BTagArr<T>(), array_type(type_id), chunk_len(DEFAULT_CHUNK_LENGTH) {}
 
-// A binary list that maps tags to data.
-// The user is responsible for the actual type of his data.
-// Setting an entry in this list only specifies how the type
-// is serialized.
-// Retrieving data with the wrong type specified leads to
-// undefined behavior.
-// The order of entries is maintained.
-// When deserialized from a stream, the data types are set
-// to the corresponding type defined by the BTC data types.
-// Example:
-//     4 Byte integer -> BTC::UINT32_T
-//     8 Byte float -> BTC::DOUBLE_T
-class BTagCompound : public IBTagBase {
+    BTagChunkedArr(const BTagChunkedArr<T>& bt) 
+            : BTagArr<T>(bt), array_type(bt.array_type), chunk_len(bt.chunk_len) {}
 
-    // Sorted array to find tags using binary search
-    container_::ArrayList<BTCTagEntry> tagmap;
-    container_::ArrayList<BTCDataEntry> datalist;
+    BTagChunkedArr(UINT8_T type_id, T* value, const SIZE_T& length, bool ownership,
+            SIZE_T chunk_length = DEFAULT_CHUNK_LENGTH) 
+            : BTagArr<T>(value,length,ownership), array_type(type_id), 
+              chunk_len(chunk_length) {}
 
-public:
-    BTagCompound() : tagmap(), datalist() {}
+    UINT8_T getTypeID() const {
+        return getChunkedTypeID(array_type);
+    }
 
-    BTagCompound(const BTagCompound& comp) 
-            : tagmap(comp.tagmap), datalist(comp.datalist) {
+    SIZE_T getByteSize() const {
+        SIZE_T count = chunkCount(this->len,chunk_len);
+        SIZE_T bytesize = 1 + getIntVarByteSize(this->len) + getIntVarByteSize(chunk_len);
+        bytesize += 8*count;
+        for (SIZE_T i=0; i<count; ++i) {
+            bytesize += chunkByteSize(std::min(chunk_len,this->len-i*chunk_len));
+        }
+        return bytesize;
     }
 
-#ifdef ASSERT_C11
-    BTagCompound(BTagCompound&& comp) 
-            : tagmap(std::move(comp.tagmap)), datalist(std::move(comp.datalist)) {
+    void serialize(std::ostream& os) const {
+        serializeChunks(os);
     }
-#endif
 
-    BTagCompound& operator=(const BTagCompound& comp) {
-        datalist = comp.datalist;
-        tagmap = comp.tagmap;
-        return(*this);
+    void serialize(BufferSink& os) const {
+        serializeChunks(os);
     }
 
-#ifdef ASSERT_C11
-    BTagCompound& operator=(BTagCompound&& comp) {
-        datalist = std::move(comp.datalist);
-        tagmap = std::move(comp.tagmap);
-        return(*this);
+    void deserialize(std::istream& is) {
+        deserializeChunks(is,true);
     }
-#endif
 
-    // Add methods
+    void deserialize(BufferSource& is) {
+        deserializeChunks(is,!is.getArena());
+    }
 
-    // Set an IBTagBase object.
-    // BT has to derive from IBTagBase.
-    template<typename BT>
-    void setTag(const STRING_T& tag, ptr_::SharedObjPtr<BT> value) {
-#ifdef DEBUG
-        if(tag.size() > 256) {
-            std::cout << 
-                "Error (serialize_::BTagCompound::setTag): Tag too long!" << 
-                std::endl;
+    // Reads the elements [begin,end) of a serialized chunked array of type 
+    // chunked_type into out. payload points behind the byte size, end is
+    // limited to the length. Only the covering chunks are read.
+    // Returns the number of elements read.
+    // Throws unknown_type_error if the chunks are not of chunked_type and
+    // buffer_overflow_error if the chunks do not match the length.
+    static SIZE_T readSlice(UINT8_T chunked_type, const char* payload, SIZE_T size, 
+            SIZE_T begin, SIZE_T end, T* out) {
+        BufferSource is(payload,size);
+        UINT8_T type_id = deserializeByte(is);
+        if (getChunkedTypeID(type_id) != chunked_type) {
+            throw unknown_type_error("BTC::serialize_::BTagChunkedArr::readSlice", type_id);
+        }
+        SIZE_T element_size = getElementByteSize(type_id);
+        SIZE_T length = deserializeIntVar<SIZE_T>(is);
+        SIZE_T chunk_length = deserializeIntVar<SIZE_T>(is);
+        SIZE_T count = chunkCount(length,chunk_length);
+        if ((length > is.remaining()/element_size) || (count > is.remaining()/8)) {
+            throw buffer_overflow_error("BTC::serialize_::BTagChunkedArr::readSlice", length, is.remaining());
+        }
+        end = std::min(end,length);
+        if ((begin >= end) || (chunk_length == 0)) {
+            return 0;
+        }
+        const char* table = is.current();
+        is.skip(8*count);
+        const char* chunks = is.current();
+        for (SIZE_T i=begin/chunk_length; i*chunk_length<end; ++i) {
+            BufferSource entry(table+8*i,8);
+            SIZE_T offset = SIZE_T(deserializeLong(entry));
+            if (offset > SIZE_T(payload+size-chunks)) {
+                throw buffer_overflow_error("BTC::serialize_::BTagChunkedArr::readSlice", offset, payload+size-chunks);
+            }
+            BufferSource chunk(chunks+offset,payload+size-chunks-offset);
+            SIZE_T n = deserializeIntVar<SIZE_T>(chunk);
+            if (n != std::min(chunk_length,length-i*chunk_length)) {
+                throw buffer_overflow_error("BTC::serialize_::BTagChunkedArr::readSlice", n, 
+                        std::min(chunk_length,length-i*chunk_length));
+            }
+            SIZE_T first = std::max(begin,i*chunk_length);
+            SIZE_T last = std::min(end,i*chunk_length+n);
+            chunk.skip((first-i*chunk_length)*element_size);
+            deserializeElements(chunk,type_id,out+(first-begin),last-first);
+        }
+        return end-begin;
+    }
+
+    std::ostream& print(std::ostream& os, UINT8_T increment) const {
+        os << "cha{len=" << this->len << ",chunk=" << chunk_len << ",own=" << this->owner << '}';
+        return os;
+    }
+};
+
+
+// Integer array serialized as varints (see DataTypeID::DELTA_UINT32_ARR).
+// type_id selects the encoding and the integer width of the wire format.
+template<typename T>
+class BTagVarintArr : public BTagArr<T> {
+
+    bool isDelta() const {
+        return((type_id == DataTypeID::DELTA_UINT32_ARR) || (type_id == DataTypeID::DELTA_UINT64_ARR));
+    }
+
+    bool isLong() const {
+        return((type_id == DataTypeID::DELTA_UINT64_ARR) || (type_id == DataTypeID::ZIGZAG_UINT64_ARR));
+    }
+
+    template<typename Source>
+    void deserializeVarints(Source& is, bool own) {
+        if (this->owner) {
+            delete[] this->data;
+        }
+        this->data = 0;
+        this->len = 0;
+        this->owner = false;
+        if (isLong()) {
+            this->data = deserializeVarintArray<UINT64_T,T>(is,this->len,isDelta());
+        } else {
+            this->data = deserializeVarintArray<UINT32_T,T>(is,this->len,isDelta());
+        }
+        this->owner = own;
+    }
+
+  public:
+    UINT8_T type_id;
+
+    explicit BTagVarintArr(UINT8_T id) : BTagArr<T>(), type_id(id) {}
+
+    BTagVarintArr(const BTagVarintArr<T>& bt) : BTagArr<T>(bt), type_id(bt.type_id) {}
+
+    BTagVarintArr(UINT8_T id, T* value, const SIZE_T& length, bool ownership) 
+            : BTagArr<T>(value,length,ownership), type_id(id) {}
+
+    UINT8_T getTypeID() const {
+        return type_id;
+    }
+
+    SIZE_T getByteSize() const {
+        if (isLong()) {
+            return getVarintArrayByteSize<UINT64_T>(this->len,this->data,isDelta());
+        }
+        return getVarintArrayByteSize<UINT32_T>(this->len,this->data,isDelta());
+    }
+
+    void serialize(std::ostream& os) const {
+        if (isLong()) {
+            serializeVarintArray<UINT64_T>(os,this->len,this->data,isDelta());
+        } else {
+            serializeVarintArray<UINT32_T>(os,this->len,this->data,isDelta());
+        }
+    }
+
+    void serialize(BufferSink& os) const {
+        if (isLong()) {
+            serializeVarintArray<UINT64_T>(os,this->len,this->data,isDelta());
+        } else {
+            serializeVarintArray<UINT32_T>(os,this->len,this->data,isDelta());
+        }
+    }
+
+    void deserialize(std::istream& is) {
+        deserializeVarints(is,true);
+    }
+
+    void deserialize(BufferSource& is) {
+        deserializeVarints(is,!is.getArena());
+    }
+
+    std::ostream& print(std::ostream& os, UINT8_T increment) const {
+        os << "va{len=" << this->len << ",delta=" << isDelta() << ",own=" << this->owner << '}';
+        return os;
+    }
+};
+
+// Integer array serialized bit-packed (see DataTypeID::BITPACK_UINT32_ARR),
+// for values in a small range like codes or counters. type_id selects the
+// integer width of the wire format.
+template<typename T>
+class BTagBitPackedArr : public BTagArr<T> {
+
+    bool isLong() const {
+        return(type_id == DataTypeID::BITPACK_UINT64_ARR);
+    }
+
+    template<typename Source>
+    void deserializeBlocks(Source& is, bool own) {
+        if (this->owner) {
+            delete[] this->data;
+        }
+        this->data = 0;
+        this->len = 0;
+        this->owner = false;
+        if (isLong()) {
+            this->data = deserializeBitPackedArray<UINT64_T,T>(is,this->len);
+        } else {
+            this->data = deserializeBitPackedArray<UINT32_T,T>(is,this->len);
+        }
+        this->owner = own;
+    }
+
+  public:
+    UINT8_T type_id;
+
+    explicit BTagBitPackedArr(UINT8_T id) : BTagArr<T>(), type_id(id) {}
+
+    BTagBitPackedArr(const BTagBitPackedArr<T>& bt) : BTagArr<T>(bt), type_id(bt.type_id) {}
+
+    BTagBitPackedArr(UINT8_T id, T* value, const SIZE_T& length, bool ownership) 
+            : BTagArr<T>(value,length,ownership), type_id(id) {}
+
+    UINT8_T getTypeID() const {
+        return type_id;
+    }
+
+    SIZE_T getByteSize() const {
+        if (isLong()) {
+            return getBitPackedArrayByteSize<UINT64_T>(this->len,this->data);
+        }
+        return getBitPackedArrayByteSize<UINT32_T>(this->len,this->data);
+    }
+
+    void serialize(std::ostream& os) const {
+        if (isLong()) {
+            serializeBitPackedArray<UINT64_T>(os,this->len,this->data);
+        } else {
+            serializeBitPackedArray<UINT32_T>(os,this->len,this->data);
+        }
+    }
+
+    void serialize(BufferSink& os) const {
+        if (isLong()) {
+            serializeBitPackedArray<UINT64_T>(os,this->len,this->data);
+        } else {
+            serializeBitPackedArray<UINT32_T>(os,this->len,this->data);
+        }
+    }
+
+    void deserialize(std::istream& is) {
+        deserializeBlocks(is,true);
+    }
+
+    void deserialize(BufferSource& is) {
+        deserializeBlocks(is,!is.getArena());
+    }
+
+    std::ostream& print(std::ostream& os, UINT8_T increment) const {
+        os << "pa{len=" << this->len << ",own=" << this->owner << '}';
+        return os;
+    }
+};
+
+// Float or double array serialized by the XOR with the previous element
+// (see DataTypeID::XOR_DOUBLE_ARR), for slowly changing series like 
+// sensor data. T is FLOAT_T or DOUBLE_T.
+template<typename T>
+class BTagXorArr : public BTagArr<T> {
+
+    template<typename Source>
+    void deserializeBits(Source& is, bool own) {
+        if (this->owner) {
+            delete[] this->data;
+        }
+        this->data = 0;
+        this->len = 0;
+        this->owner = false;
+        this->data = deserializeXorArray<T>(is,this->len);
+        this->owner = own;
+    }
+
+  public:
+    BTagXorArr() : BTagArr<T>() {}
+
+    BTagXorArr(const BTagXorArr<T>& bt) : BTagArr<T>(bt) {}
+
+    BTagXorArr(T* value, const SIZE_T& length, bool ownership) 
+            : BTagArr<T>(value,length,ownership) {}
+
+    UINT8_T getTypeID() const {
+        return (sizeof(T) == 8) ? DataTypeID::XOR_DOUBLE_ARR : DataTypeID::XOR_FLOAT_ARR;
+    }
+
+    SIZE_T getByteSize() const {
+        return getXorArrayByteSize(this->len,this->data);
+    }
+
+    void serialize(std::ostream& os) const {
+        serializeXorArray(os,this->len,this->data);
+    }
+
+    void serialize(BufferSink& os) const {
+        serializeXorArray(os,this->len,this->data);
+    }
+
+    void deserialize(std::istream& is) {
+        deserializeBits(is,true);
+    }
+
+    void deserialize(BufferSource& is) {
+        deserializeBits(is,!is.getArena());
+    }
+
+    std::ostream& print(std::ostream& os, UINT8_T increment) const {
+        os << "xa{len=" << this->len << ",own=" << this->owner << '}';
+        return os;
+    }
+};
+
+// BTagCompound
+
+class BTagCompound;
+
+// Tag that is not deserialized yet (see BufferSource::setLazy()).
+// Holds the range of its serialized payload (behind the byte size prefix,
+// if the type has one) in the memory of the source and deserializes it on
+// the first call of get(). Until then it is serialized by copying the 
+// range.
+// With ATOMIC_REFCOUNT several threads may call get() at once, the tag is
+// deserialized only once.
+class BTagLazy : public IBTagBase {
+
+    UINT8_T type_id;
+    const char* payload;
+    SIZE_T len;
+    container_::Arena* arena;
+    bool hashed;
+    mutable ptr_::SharedObjPtr<IBTagBase> tag;
+#ifdef ATOMIC_REFCOUNT
+    mutable std::once_flag once;
+    mutable std::atomic<bool> loaded;
+#else
+    mutable bool loaded;
+#endif
+
+    // Deserializes the tag (defined behind BTagCompound).
+    void load() const;
+
+  public:
+    BTagLazy(UINT8_T type, const char* data, SIZE_T length, 
+            container_::Arena* a, bool hash_index)
+            : type_id(type), payload(data), len(length), arena(a), 
+              hashed(hash_index), tag(), loaded(false) {
+    }
+
+    // The deserialized tag (defined behind BTagCompound).
+    const ptr_::SharedObjPtr<IBTagBase>& get() const;
+
+    bool isLoaded() const {
+        return loaded;
+    }
+
+    UINT8_T getTypeID() const {
+        return type_id;
+    }
+
+    SIZE_T getByteSize() const {
+        return(loaded ? tag->getByteSize() : len);
+    }
+
+    void serialize(std::ostream& os) const {
+        if (loaded) {
+            tag->serialize(os);
+        } else {
+            os.write(payload,len);
+        }
+    }
+
+    void serialize(BufferSink& os) const {
+        if (loaded) {
+            tag->serialize(os);
+        } else {
+            os.write(payload,len);
+        }
+    }
+
+    void deserialize(std::istream& is) {
+        get()->deserialize(is);
+    }
+
+    void deserialize(BufferSource& is) {
+        get()->deserialize(is);
+    }
+
+    std::ostream& print(std::ostream& os, unsigned char increment) const {
+        if (loaded) {
+            return tag->print(os,increment);
+        }
+        os << "lazy{type=" << int(type_id) << ",bytes=" << len << '}';
+        return os;
+    }
+};
+
+// Entry of a BTagCompound.
+// Numbers (the types from UINT8 to DOUBLE) are stored inline in value, 
+// scalar holds their type ID (data is null). All other tags (strings, 
+// arrays, compounds and user defined tags) are stored in data and scalar
+// is NO_SCALAR.
+class BTCDataEntry {
+
+  public:
+    static const UINT8_T NO_SCALAR = 255;
+
+    union Scalar {
+        UINT8_T b;
+        UINT16_T s;
+        UINT32_T i;
+        UINT64_T l;
+        FLOAT_T f;
+        DOUBLE_T d;
+    };
+
+    STRING_T tag;
+    ptr_::SharedObjPtr<IBTagBase> data;
+    UINT8_T scalar;
+    Scalar value;
+    // data is a BTagLazy
+    bool lazy;
+
+    BTCDataEntry()
+            : tag(), data(), scalar(NO_SCALAR), value(), lazy(false) {
+    }
+
+    BTCDataEntry(const STRING_T& t, ptr_::SharedObjPtr<IBTagBase> d)
+            : tag(t), data(d), scalar(NO_SCALAR), value(), lazy(false) {
+    }
+
+    // Byte size of the inline value of a type, 0 if it is not stored inline.
+    static SIZE_T scalarSize(UINT8_T type_id) {
+        switch (type_id) {
+            case DataTypeID::UINT8: return 1;
+            case DataTypeID::UINT16: return 2;
+            case DataTypeID::UINT32: return 4;
+            case DataTypeID::UINT64: return 8;
+            case DataTypeID::FLOAT: return 4;
+            case DataTypeID::DOUBLE: return 8;
+            default: return 0;
+        }
+    }
+
+    bool isScalar() const {
+        return(scalar != NO_SCALAR);
+    }
+
+    UINT8_T getTypeID() const {
+        return(isScalar() ? scalar : data->getTypeID());
+    }
+
+    void setData(const ptr_::SharedObjPtr<IBTagBase>& d) {
+        data = d;
+        scalar = NO_SCALAR;
+        lazy = false;
+    }
+
+    // d has to be a BTagLazy.
+    void setLazy(const ptr_::SharedObjPtr<IBTagBase>& d) {
+        data = d;
+        scalar = NO_SCALAR;
+        lazy = true;
+    }
+
+    // Tag object, a lazy tag is deserialized.
+    const ptr_::SharedObjPtr<IBTagBase>& getData() const {
+        if (lazy) {
+            return static_cast<const BTagLazy&>(*data).get();
+        }
+        return data;
+    }
+
+    // T needs to have the size of the type.
+    template<typename T>
+    void setScalar(UINT8_T type_id, const T& val) {
+        std::memcpy(&value,&val,sizeof(T));
+        scalar = type_id;
+        data = ptr_::SharedObjPtr<IBTagBase>();
+        lazy = false;
+    }
+
+    // A copy, the entry moves when the compound grows.
+    template<typename T>
+    T getScalar() const {
+        T val;
+        std::memcpy(&val,&value,sizeof(T));
+        return(val);
+    }
+
+    // New tag object holding a copy of the inline value.
+    ptr_::SharedObjPtr<IBTagBase> box() const {
+        IBTagBase* obj = 0;
+        switch (scalar) {
+            case DataTypeID::UINT8: obj = new BTagByte<UINT8_T>(value.b); break;
+            case DataTypeID::UINT16: obj = new BTagShort<UINT16_T>(value.s); break;
+            case DataTypeID::UINT32: obj = new BTagInt<UINT32_T>(value.i); break;
+            case DataTypeID::UINT64: obj = new BTagLong<UINT64_T>(value.l); break;
+            case DataTypeID::FLOAT: obj = new BTagFloat<FLOAT_T>(value.f); break;
+            case DataTypeID::DOUBLE: obj = new BTagDouble<DOUBLE_T>(value.d); break;
+            default: return(data);
+        }
+        return(ptr_::SharedObjPtr<IBTagBase>::fromObject(obj));
+    }
+
+    // Byte size of the payload including its byte size prefix (see 
+    // hasByteSize()).
+    SIZE_T getByteSize() const {
+        if (isScalar()) {
+            return scalarSize(scalar);
+        }
+        SIZE_T bytesize = data->getByteSize();
+        if (hasByteSize(data->getTypeID())) {
+            bytesize += getIntVarByteSize(bytesize);
+        }
+        return bytesize;
+    }
+
+    // The compound of the entry, 0 for other tags and for lazy compounds 
+    // that are not loaded yet (defined behind BTagCompound).
+    const BTagCompound* getCompound() const;
+
+    template<typename Sink>
+    void serialize(Sink& os) const {
+        switch (scalar) {
+            case DataTypeID::UINT8: serializeByte(os,value.b); break;
+            case DataTypeID::UINT16: serializeShort(os,value.s); break;
+            case DataTypeID::UINT32: serializeInt(os,value.i); break;
+            case DataTypeID::UINT64: serializeLong(os,value.l); break;
+            case DataTypeID::FLOAT: serializeFloat(os,value.f); break;
+            case DataTypeID::DOUBLE: serializeDouble(os,value.d); break;
+            default:
+                if (hasByteSize(data->getTypeID())) {
+                    serializeIntVar(os,data->getByteSize());
+                }
+                data->serialize(os);
+        }
+    }
+
+    // Reads a number of the type inline.
+    // Returns false if the type is not stored inline.
+    // The legacy float layouts are converted to FLOAT and DOUBLE.
+    template<typename Source>
+    bool deserializeScalar(Source& is, UINT8_T type_id) {
+        switch (type_id) {
+            case DataTypeID::UINT8: value.b = deserializeByte(is); break;
+            case DataTypeID::UINT16: value.s = deserializeShort(is); break;
+            case DataTypeID::UINT32: value.i = deserializeInt(is); break;
+            case DataTypeID::UINT64: value.l = deserializeLong(is); break;
+            case DataTypeID::FLOAT: value.f = deserializeFloat(is); break;
+            case DataTypeID::DOUBLE: value.d = deserializeDouble(is); break;
+            case DataTypeID::FLOAT_LEGACY: 
+                value.f = deserializeFloatLegacy(is); 
+                type_id = DataTypeID::FLOAT; 
+                break;
+            case DataTypeID::DOUBLE_LEGACY: 
+                value.d = deserializeDoubleLegacy(is); 
+                type_id = DataTypeID::DOUBLE; 
+                break;
+            default: return(false);
+        }
+        scalar = type_id;
+        return(true);
+    }
+
+    std::ostream& print(std::ostream& os, unsigned char increment) const {
+        switch (scalar) {
+            case DataTypeID::UINT8: os << "b{" << int(value.b) << '}'; break;
+            case DataTypeID::UINT16: os << "s{" << value.s << '}'; break;
+            case DataTypeID::UINT32: os << "i{" << value.i << '}'; break;
+            case DataTypeID::UINT64: os << "l{" << value.l << '}'; break;
+            case DataTypeID::FLOAT: os << "f{" << value.f << '}'; break;
+            case DataTypeID::DOUBLE: os << "d{" << value.d << '}'; break;
+            default: data->print(os,increment);
+        }
+        return os;
+    }
+};
+
+// How BTagCompound::getValue() hands out a value of type T. Numbers may 
+// be stored inline in the entry, which moves when the compound grows, so
+// they are copied. Other values live in their tag object and are 
+// returned by reference.
+template<typename T, bool number = std::numeric_limits<T>::is_specialized>
+struct ValueRef {
+    typedef const T& ConstType;
+    typedef T& Type;
+
+    static bool holds(const BTCDataEntry& entry) {
+        return(!entry.isScalar() && isValue(entry.getTypeID()));
+    }
+
+    static const T& get(const BTCDataEntry& entry) {
+        return((static_cast<const BTagVal<T>&>(*(entry.data))).data);
+    }
+
+    static T& get(BTCDataEntry& entry) {
+        return((static_cast<BTagVal<T>&>(*(entry.data))).data);
+    }
+};
+
+template<typename T>
+struct ValueRef<T,true> {
+    typedef T ConstType;
+    typedef T Type;
+
+    static bool holds(const BTCDataEntry& entry) {
+        return(isValue(entry.getTypeID()));
+    }
+
+    static T get(const BTCDataEntry& entry) {
+        if (entry.isScalar()) {
+            return(entry.template getScalar<T>());
+        }
+        return((static_cast<const BTagVal<T>&>(*(entry.data))).data);
+    }
+};
+
+// Non-owning reference to a tag used as lookup key.
+// Converts implicitly from strings, string literals and (C++17) string
+// views, so looking up a tag never creates a temporary STRING_T.
+// A BTagCompound::Key additionally passes its precomputed hash and its 
+// cached position (hint).
+class TagRef {
+
+  public:
+    const char* data;
+    SIZE_T size;
+    SIZE_T hashcode;
+    bool has_hash;
+    SIZE_T* hint;
+
+    TagRef(const STRING_T& tag)
+            : data(tag.data()), size(tag.size()), hashcode(0), has_hash(false), hint(0) {
+    }
+
+    TagRef(const char* tag)
+            : data(tag), size(std::strlen(tag)), hashcode(0), has_hash(false), hint(0) {
+    }
+
+    TagRef(const char* tag, SIZE_T len)
+            : data(tag), size(len), hashcode(0), has_hash(false), hint(0) {
+    }
+
+    TagRef(const char* tag, SIZE_T len, SIZE_T h, SIZE_T* pos)
+            : data(tag), size(len), hashcode(h), has_hash(true), hint(pos) {
+    }
+
+#if __cplusplus >= 201703L
+    TagRef(std::string_view tag)
+            : data(tag.data()), size(tag.size()), hashcode(0), has_hash(false), hint(0) {
+    }
+#endif
+
+    STRING_T str() const {
+        return(STRING_T(data,size));
+    }
+
+    SIZE_T hash() const {
+        return(has_hash ? hashcode : container_::hashBytes(data,size));
+    }
+};
+
+// A binary list that maps tags to data.
+// The user is responsible for the actual type of his data.
+// Setting an entry in this list only specifies how the type
+// is serialized.
+// Retrieving data with the wrong type specified leads to
+// undefined behavior.
+// The order of entries is maintained.
+// When deserialized from a stream, the data types are set
+// to the corresponding type defined by the BTC data types.
+// Example:
+//     4 Byte integer -> BTC::UINT32_T
+//     8 Byte float -> BTC::DOUBLE_T
+// Threads: the const methods (getValue, getArray, getTag, hasTag, 
+// serialize, print, ...) do not change the compound, so any number of 
+// threads may read it at once while no thread changes it. Reading still
+// copies pointers to the tags, so sharing a tree between threads needs
+// ATOMIC_REFCOUNT (with ASSERT_C11): then the reference counts are atomic
+// and lazy entries are loaded once under std::call_once (an Arena used by
+// the lazy entries is locked while allocating). Without it a 
+// shared tree has to be fully loaded and the pointers to it must not be
+// copied in several threads. A Key must not be shared by threads.
+class BTagCompound : public IBTagBase {
+
+    // Orders positions in the datalist by their tag.
+    class TagOrder {
+
+        const container_::ArrayList<BTCDataEntry>& list;
+
+      public:
+        TagOrder(const container_::ArrayList<BTCDataEntry>& l) : list(l) {}
+
+        // Equal tags are ordered by position.
+        bool operator()(SIZE_T a, SIZE_T b) const {
+            int cmp = list[a].tag.compare(list[b].tag);
+            return((cmp < 0) || ((cmp == 0) && (a < b)));
+        }
+
+        bool operator()(SIZE_T a, const TagRef& tag) const {
+            return(list[a].tag.compare(0,STRING_T::npos,tag.data,tag.size) < 0);
+        }
+    };
+
+    // Checks whether the entry at a position in the datalist has the tag.
+    class TagMatch {
+
+        const container_::ArrayList<BTCDataEntry>& list;
+        const TagRef& tag;
+
+      public:
+        TagMatch(const container_::ArrayList<BTCDataEntry>& l, const TagRef& t) 
+                : list(l), tag(t) {}
+
+        bool operator()(SIZE_T a) const {
+            return(list[a].tag.compare(0,STRING_T::npos,tag.data,tag.size) == 0);
+        }
+    };
+
+    // Positions in the datalist sorted by tag to find tags using binary 
+    // search. Only positions are stored so that inserting into the middle
+    // moves little memory.
+    container_::ArrayList<SIZE_T> tagmap;
+    container_::ArrayList<BTCDataEntry> datalist;
+    // Set between beginBulkInsert() and endBulkInsert(): tagmap is unsorted
+    // and may contain duplicates.
+    bool bulk_insert;
+    // Optional hash index over the datalist positions, see setHashIndex().
+    bool hashed;
+    container_::HashIndex hashindex;
+
+    // Index in tagmap of the first entry whose tag is not smaller than tag.
+    SIZE_T searchTag(const TagRef& tag) const {
+        return(container_::search_lower(tagmap,tag,TagOrder(datalist)));
+    }
+
+    // Position of the tag in the datalist, datalist.size() if not found.
+    SIZE_T findPosition(const TagRef& tag) const {
+        if (tag.hint) {
+            // Key: try the position of the last lookup first
+            if ((*tag.hint < datalist.size()) && TagMatch(datalist,tag)(*tag.hint)) {
+                return(*tag.hint);
+            }
+            SIZE_T pos = searchPosition(tag);
+            if (pos < datalist.size()) {
+                *tag.hint = pos;
+            }
+            return(pos);
+        }
+        return(searchPosition(tag));
+    }
+
+    // Entry of a value of type T.
+    template<typename T>
+    const BTCDataEntry& findValue(const TagRef& tag) const {
+        SIZE_T pos = findPosition(tag);
+        if (pos >= datalist.size()) {
+            throw tag_not_found_error("BTC::serialize_::BTagCompound::getValue", tag.str());
+        }
+        if (!ValueRef<T>::holds(datalist[pos])) {
+            throw wrong_type_error("BTC::serialize_::BTagCompound::getValue", "value");
+        }
+        return(datalist[pos]);
+    }
+
+    SIZE_T searchPosition(const TagRef& tag) const {
+        if (hashed) {
+            SIZE_T pos = hashindex.find(tag.hash(),TagMatch(datalist,tag));
+            return((pos == container_::HashIndex::npos) ? datalist.size() : pos);
+        }
+        SIZE_T pos = searchTag(tag);
+        if ((pos < tagmap.size()) && TagMatch(datalist,tag)(tagmap[pos])) {
+            return(tagmap[pos]);
+        }
+        return(datalist.size());
+    }
+
+    // Position of the entry for tag in the datalist, a new entry is added 
+    // if the tag does not exist.
+    SIZE_T insertTag(const STRING_T& tag) {
+        // Search for tag in tagmap (duplicates in bulk mode are resolved by 
+        // endBulkInsert())
+        SIZE_T pos = bulk_insert ? tagmap.size() : searchTag(tag);
+        if (!bulk_insert && (pos < tagmap.size()) && 
+                (datalist[tagmap[pos]].tag.compare(tag) == 0)) {
+            // Tag exists already
+            return(tagmap[pos]);
+        }
+        // Tag does not exist -> add to list, the tagmap stays sorted
+        tagmap.insert(datalist.size(),pos);
+        datalist.add(BTCDataEntry());
+        datalist[datalist.size()-1].tag = tag;
+        if (hashed && !bulk_insert) {
+            hashindex.insert(TagRef(tag).hash(),datalist.size()-1);
+        }
+        return(datalist.size()-1);
+    }
+
+    // Stores numbers inline, types of another size are stored as tag BT.
+    template<typename BT, typename T>
+    void setScalar(const STRING_T& tag, UINT8_T type_id, const T& value) {
+        if (sizeof(T) == BTCDataEntry::scalarSize(type_id)) {
+            datalist[insertTag(tag)].setScalar(type_id,value);
+        } else {
+            datalist[insertTag(tag)].setData(
+                    ptr_::SharedObjPtr<IBTagBase>::fromObject(new BT(value)));
+        }
+    }
+
+    // Reads the payload of an entry of the given type behind its tag.
+    void deserializeData(BufferSource& is, BTCDataEntry& entry, UINT8_T type_id) {
+        // numbers are stored inline
+        if(entry.deserializeScalar(is,type_id)) {
+            return;
+        }
+        // compounds and arrays are only recorded in lazy mode
+        if(is.isLazy() && !is.getStream() && 
+                (isCompound(type_id) || isArray(type_id))) {
+            const char* payload;
+            SIZE_T payload_size;
+            if(hasByteSize(type_id)) {
+                payload_size = deserializeIntVar<SIZE_T>(is);
+                payload = is.current();
+                is.skip(payload_size);
+            } else {
+                payload = is.current();
+                skipTagPayload(is,type_id);
+                payload_size = is.current()-payload;
+            }
+            container_::Arena* arena = is.getArena();
+            BTagLazy* lazy;
+            if (arena) {
+                lazy = new(arena->allocate(sizeof(BTagLazy))) 
+                        BTagLazy(type_id,payload,payload_size,arena,hashed);
+                lazy->setPooled();
+            } else {
+                lazy = new BTagLazy(type_id,payload,payload_size,arena,hashed);
+            }
+            entry.setLazy(ptr_::SharedObjPtr<IBTagBase>::fromObject(lazy));
+            return;
+        }
+        // the byte size is only needed to skip the payload
+        if(hasByteSize(type_id)) {
+            deserializeIntVar<SIZE_T>(is);
+        }
+        // create new tag
+        entry.data = ptr_::SharedObjPtr<IBTagBase>::fromObject(
+                createTag(type_id,hashed,is.getArena()));
+        entry.data->deserialize(is);
+    }
+
+    // Deserializes the entries below node of the projection.
+    // Skipped entries are not allocated, their tags are read into a 
+    // buffer on the stack.
+    void deserializeProjected(BufferSource& is, const Projection& projection, SIZE_T node) {
+        UINT64_T data_size = deserializeIntVar<UINT64_T>(is);
+        char tag[256];
+        for(UINT64_T i=0; i<data_size; ++i) {
+            UINT8_T tag_len = deserializeByte(is);
+            if(tag_len > 0) {
+                is.read(tag,tag_len);
+            }
+            UINT8_T type_temp = deserializeByte(is);
+            SIZE_T child = projection.find(node,tag,tag_len);
+            if(child == Projection::npos) {
+                skipTagPayload(is,type_temp);
+                continue;
+            }
+            datalist.add(BTCDataEntry());
+            BTCDataEntry& entry = datalist[datalist.size()-1];
+            entry.tag.assign(tag,tag_len);
+            if(isCompound(type_temp) && !projection.isComplete(child)) {
+                if(hasByteSize(type_temp)) {
+                    deserializeIntVar<SIZE_T>(is);
+                }
+                BTagCompound* comp = new BTagCompound();
+                comp->setHashIndex(hashed);
+                entry.data = ptr_::SharedObjPtr<IBTagBase>::fromObject(comp);
+                comp->deserializeProjected(is,projection,child);
+            } else {
+                deserializeData(is,entry,type_temp);
+            }
+            tagmap.add(datalist.size()-1);
+        }
+        if(tagmap.size() > 1) container_::sort(tagmap,TagOrder(datalist));
+        if(hashed) rebuildHashIndex();
+    }
+
+    void rebuildHashIndex() {
+        hashindex.clear();
+        for (SIZE_T i=0; i<datalist.size(); ++i) {
+            hashindex.insert(TagRef(datalist[i].tag).hash(),i);
+        }
+    }
+
+public:
+    // Precompiled tag for repeated lookups of the same tag.
+    // Stores the hash and the position found by the last lookup, so that
+    // on compounds with the same layout a lookup is a single comparison.
+    // A Key can be used with any compound (the position is only a hint),
+    // but not by several threads at once.
+    class Key {
+
+        STRING_T tag;
+        SIZE_T hashcode;
+        mutable SIZE_T position;
+
+      public:
+        explicit Key(const STRING_T& t)
+                : tag(t), hashcode(container_::hashBytes(t.data(),t.size())), position(0) {
+        }
+
+        const STRING_T& str() const {
+            return(tag);
+        }
+
+        operator TagRef() const {
+            return(TagRef(tag.data(),tag.size(),hashcode,&position));
+        }
+    };
+
+    // Entry left out by serializeSkeleton(): its bytes (tag and type ID
+    // excluded) belong at offset of the output.
+    struct DeferredEntry {
+        const BTCDataEntry* entry;
+        SIZE_T offset;
+        SIZE_T size;
+    };
+
+    BTagCompound() : tagmap(), datalist(), bulk_insert(false), hashed(false), hashindex() {}
+
+    BTagCompound(const BTagCompound& comp) 
+            : tagmap(comp.tagmap), datalist(comp.datalist), bulk_insert(comp.bulk_insert),
+              hashed(comp.hashed), hashindex(comp.hashindex) {
+    }
+
+#ifdef ASSERT_C11
+    BTagCompound(BTagCompound&& comp) 
+            : tagmap(std::move(comp.tagmap)), datalist(std::move(comp.datalist)),
+              bulk_insert(comp.bulk_insert), hashed(comp.hashed), 
+              hashindex(std::move(comp.hashindex)) {
+    }
+#endif
+
+    BTagCompound& operator=(const BTagCompound& comp) {
+        datalist = comp.datalist;
+        tagmap = comp.tagmap;
+        bulk_insert = comp.bulk_insert;
+        hashed = comp.hashed;
+        hashindex = comp.hashindex;
+        return(*this);
+    }
+
+#ifdef ASSERT_C11
+    BTagCompound& operator=(BTagCompound&& comp) {
+        datalist = std::move(comp.datalist);
+        tagmap = std::move(comp.tagmap);
+        bulk_insert = comp.bulk_insert;
+        hashed = comp.hashed;
+        hashindex = std::move(comp.hashindex);
+        return(*this);
+    }
+#endif
+
+    // Additionally keep a hash index over the tags.
+    // Lookups then take constant time instead of a binary search with
+    // string comparisons, at the cost of two words per entry.
+    // Compounds deserialized into this compound inherit the setting.
+    void setHashIndex(bool enable) {
+        hashed = enable;
+        if (hashed) {
+            rebuildHashIndex();
+        } else {
+            hashindex.clear();
+        }
+    }
+
+    bool hasHashIndex() const {
+        return(hashed);
+    }
+
+    // Add methods
+
+    // Set an IBTagBase object.
+    // BT has to derive from IBTagBase.
+    template<typename BT>
+    void setTag(const STRING_T& tag, ptr_::SharedObjPtr<BT> value) {
+#ifdef DEBUG
+        if(tag.size() > 256) {
+            std::cout << 
+                "Error (serialize_::BTagCompound::setTag): Tag too long!" << 
+                std::endl;
             exit(1);
         }
 #endif
         // Convenience: one would have to actually pass a ptr onto an IBTagBase object.
         // TODO Add a runtime typecheck here! (Flo)
         ptr_::SharedObjPtr<IBTagBase> val = ptr_::SharedObjPtr<IBTagBase>::reinterpretCast(value);
-        // Search for tag in tagmap
-        BTCTagEntry searchtag;
-        searchtag.tag = tag;
-        SIZE_T pos = 0;
-        if (tagmap.size() > 1) {
-            pos = container_::search_lower(tagmap,searchtag);
-        }
-        if ((pos < tagmap.size()) && (tagmap[pos].tag.compare(tag) == 0)) {
-            // Tag exists already -> set to new value
-            datalist[tagmap[pos].position].data = val;
-        } else {
-            // Tag does not exist -> add to list
-            searchtag.position = datalist.size();
-            tagmap.add(searchtag);
-            datalist.add(BTCDataEntry(searchtag.tag, val));
-            container_::sort(tagmap);
+        datalist[insertTag(tag)].setData(val);
+    }
+
+    // Needs no cast.
+    void setTag(const STRING_T& tag, const ptr_::SharedObjPtr<IBTagBase>& value) {
+#ifdef DEBUG
+        if(tag.size() > 256) {
+            std::cout << 
+                "Error (serialize_::BTagCompound::setTag): Tag too long!" << 
+                std::endl;
+            exit(1);
+        }
+#endif
+        datalist[insertTag(tag)].setData(value);
+    }
+
+    // Start inserting many tags at once.
+    // Until endBulkInsert() is called, the set methods only append the
+    // entries (setting an existing tag again is allowed) and the
+    // compound must not be accessed otherwise.
+    // count is the number of entries expected in total and only used to
+    // reserve memory.
+    void beginBulkInsert(SIZE_T count = 0) {
+        if (count > datalist.size()) {
+            tagmap.setCapacity(count);
+            datalist.setCapacity(count);
+        }
+        bulk_insert = true;
+    }
+
+    // Sort the entries added since beginBulkInsert() once.
+    // If a tag was set more than once, the entry keeps the position of the
+    // first and the value of the last call.
+    void endBulkInsert() {
+        bulk_insert = false;
+        compactBulkInsert();
+        if (hashed) {
+            rebuildHashIndex();
+        }
+    }
+
+private:
+    // Sorts the tagmap and removes duplicate tags (see endBulkInsert()).
+    void compactBulkInsert() {
+        SIZE_T len = tagmap.size();
+        if (len < 2) {
+            return;
+        }
+        // Equal tags end up ordered by position
+        container_::sort(tagmap,TagOrder(datalist));
+        container_::ArrayList<UINT8_T> removed(len);
+        SIZE_T unique = 1;
+        for (SIZE_T i=1; i<len; ++i) {
+            if (datalist[tagmap[i]].tag.compare(datalist[tagmap[unique-1]].tag) == 0) {
+                // Tag set again -> first position, later value
+                datalist[tagmap[unique-1]] = datalist[tagmap[i]];
+                removed[tagmap[i]] = 1;
+            } else {
+                if (unique != i) {
+                    tagmap[unique] = tagmap[i];
+                }
+                ++unique;
+            }
+        }
+        if (unique == len) {
+            return;
+        }
+        // Compact the datalist and renumber the positions in the tagmap
+        container_::ArrayList<SIZE_T> new_position(len);
+        container_::ArrayList<BTCDataEntry> new_datalist;
+        new_datalist.setCapacity(unique);
+        for (SIZE_T i=0; i<len; ++i) {
+            new_position[i] = new_datalist.size();
+            if (!removed[i]) {
+                new_datalist.add(datalist[i]);
+            }
+        }
+        container_::ArrayList<SIZE_T> new_tagmap(unique);
+        for (SIZE_T i=0; i<unique; ++i) {
+            new_tagmap[i] = new_position[tagmap[i]];
         }
+        tagmap = new_tagmap;
+        datalist = new_datalist;
     }
 
+public:
+
     template<typename T>
     void setByte(const STRING_T& tag, T value) {
 #ifdef DEBUG
@@ -734,7 +2106,7 @@ public:
             exit(1);
         }
 #endif
-        setTag(tag, ptr_::SharedObjPtr<BTagByte<T> >(new BTagByte<T>(value)));
+        setScalar<BTagByte<T> >(tag,DataTypeID::UINT8,value);
     }
 
     template<typename T>
@@ -747,7 +2119,7 @@ public:
             exit(1);
         }
 #endif
-        setTag(tag, ptr_::SharedObjPtr<BTagShort<T> >(new BTagShort<T>(value)));
+        setScalar<BTagShort<T> >(tag,DataTypeID::UINT16,value);
     }
 
     template<typename T>
@@ -760,7 +2132,7 @@ public:
             exit(1);
         }
 #endif
-        setTag(tag, ptr_::SharedObjPtr<BTagInt<T> >(new BTagInt<T>(value)));
+        setScalar<BTagInt<T> >(tag,DataTypeID::UINT32,value);
     }
 
     template<typename T>
@@ -773,7 +2145,7 @@ public:
             exit(1);
         }
 #endif
-        setTag(tag, ptr_::SharedObjPtr<BTagLong<T> >(new BTagLong<T>(value)));
+        setScalar<BTagLong<T> >(tag,DataTypeID::UINT64,value);
     }
 
     template<typename T>
@@ -786,7 +2158,7 @@ public:
             exit(1);
         }
 #endif
-        setTag(tag, ptr_::SharedObjPtr<BTagFloat<T> >(new BTagFloat<T>(value)));
+        setScalar<BTagFloat<T> >(tag,DataTypeID::FLOAT,value);
     }
 
     template<typename T>
@@ -799,7 +2171,7 @@ public:
             exit(1);
         }
 #endif
-        setTag(tag, ptr_::SharedObjPtr<BTagDouble<T> >(new BTagDouble<T>(value)));
+        setScalar<BTagDouble<T> >(tag,DataTypeID::DOUBLE,value);
     }
 
     template<typename T>
@@ -812,7 +2184,7 @@ public:
             exit(1);
         }
 #endif
-        setTag(tag, ptr_::SharedObjPtr<BTagString<T> >(new BTagString<T>(value)));
+        setTag(tag, ptr_::SharedObjPtr<IBTagBase>::fromObject(new BTagString<T>(value)));
     }
 
     // Set an entry in the compound that points to the array.
@@ -827,7 +2199,7 @@ public:
             exit(1);
         }
 #endif
-        setTag(tag, ptr_::SharedObjPtr<BTagByteArr<T> >(new BTagByteArr<T>(array,len,false)));
+        setTag(tag, ptr_::SharedObjPtr<IBTagBase>::fromObject(new BTagByteArr<T>(array,len,false)));
     }
 
     // Set an entry in the compound that points to the array.
@@ -842,7 +2214,7 @@ public:
             exit(1);
         }
 #endif
-        setTag(tag, ptr_::SharedObjPtr<BTagShortArr<T> >(new BTagShortArr<T>(array,len,false)));
+        setTag(tag, ptr_::SharedObjPtr<IBTagBase>::fromObject(new BTagShortArr<T>(array,len,false)));
     }
 
     // Set an entry in the compound that points to the array.
@@ -857,7 +2229,7 @@ public:
             exit(1);
         }
 #endif
-        setTag(tag, ptr_::SharedObjPtr<BTagIntArr<T> >(new BTagIntArr<T>(array,len,false)));
+        setTag(tag, ptr_::SharedObjPtr<IBTagBase>::fromObject(new BTagIntArr<T>(array,len,false)));
     }
 
     // Set an entry in the compound that points to the array.
@@ -872,7 +2244,7 @@ public:
             exit(1);
         }
 #endif
-        setTag(tag, ptr_::SharedObjPtr<BTagLongArr<T> >(new BTagLongArr<T>(array,len,false)));
+        setTag(tag, ptr_::SharedObjPtr<IBTagBase>::fromObject(new BTagLongArr<T>(array,len,false)));
     }
 
     // Set an entry in the compound that points to the array.
@@ -887,7 +2259,7 @@ public:
             exit(1);
         }
 #endif
-        setTag(tag, ptr_::SharedObjPtr<BTagFloatArr<T> >(new BTagFloatArr<T>(array,len,false)));
+        setTag(tag, ptr_::SharedObjPtr<IBTagBase>::fromObject(new BTagFloatArr<T>(array,len,false)));
     }
 
     // Set an entry in the compound that points to the array.
@@ -902,7 +2274,120 @@ public:
             exit(1);
         }
 #endif
-        setTag(tag, ptr_::SharedObjPtr<BTagDoubleArr<T> >(new BTagDoubleArr<T>(array,len,false)));
+        setTag(tag, ptr_::SharedObjPtr<IBTagBase>::fromObject(new BTagDoubleArr<T>(array,len,false)));
+    }
+
+    // Set an entry in the compound that points to the array, it is 
+    // serialized in chunks of chunk_len elements (see BTagChunkedArr).
+    // array_type is the plain number array type of the elements, e.g.
+    // DataTypeID::DOUBLE_ARR.
+    // Ownership is not claimed by this method.
+    template<typename T>
+    void setChunkedArray(const STRING_T& tag, UINT8_T array_type, T* array, SIZE_T len,
+            SIZE_T chunk_len = BTagChunkedArr<T>::DEFAULT_CHUNK_LENGTH) {
+#ifdef DEBUG
+        if(tag.size() > 256) {
+            std::cout << 
+                "Error (serialize_::BTagCompound::setChunkedArray): Tag too long!" << 
+                std::endl;
+            exit(1);
+        }
+        if(getChunkedTypeID(array_type) == 0 || chunk_len == 0) {
+            std::cout << 
+                "Error (serialize_::BTagCompound::setChunkedArray): Not a number array type or no chunk length!" << 
+                std::endl;
+            exit(1);
+        }
+#endif
+        setTag(tag, ptr_::SharedObjPtr<IBTagBase>::fromObject(
+                    new BTagChunkedArr<T>(array_type,array,len,false,chunk_len)));
+    }
+
+    // Set an entry in the compound that points to the integer array, it is
+    // serialized as varints of the differences between the elements
+    // (DataTypeID::DELTA_UINT32_ARR or DELTA_UINT64_ARR by the size of T).
+    // Good for sorted data like timestamps or ids.
+    // Ownership is not claimed by this method.
+    template<typename T>
+    void setDeltaArray(const STRING_T& tag, T* array, SIZE_T len) {
+        setVarintArray(tag,(sizeof(T) == 8) ? DataTypeID::DELTA_UINT64_ARR : DataTypeID::DELTA_UINT32_ARR,
+                array,len);
+    }
+
+    // Same as setDeltaArray(), but the elements are zigzag encoded varints
+    // (DataTypeID::ZIGZAG_UINT32_ARR or ZIGZAG_UINT64_ARR), for small 
+    // values that may be negative.
+    template<typename T>
+    void setZigzagArray(const STRING_T& tag, T* array, SIZE_T len) {
+        setVarintArray(tag,(sizeof(T) == 8) ? DataTypeID::ZIGZAG_UINT64_ARR : DataTypeID::ZIGZAG_UINT32_ARR,
+                array,len);
+    }
+
+    // Set an entry with one of the varint array types, see setDeltaArray().
+    // Ownership is not claimed by this method.
+    template<typename T>
+    void setVarintArray(const STRING_T& tag, UINT8_T array_type, T* array, SIZE_T len) {
+#ifdef DEBUG
+        if(tag.size() > 256) {
+            std::cout << 
+                "Error (serialize_::BTagCompound::setVarintArray): Tag too long!" << 
+                std::endl;
+            exit(1);
+        }
+        if(!isVarintArray(array_type) || (sizeof(T) != 4 && sizeof(T) != 8) ||
+                !std::numeric_limits<T>::is_integer) {
+            std::cout << 
+                "Error (serialize_::BTagCompound::setVarintArray): Not a varint array type or no 32/64 bit integer!" << 
+                std::endl;
+            exit(1);
+        }
+#endif
+        setTag(tag, ptr_::SharedObjPtr<IBTagBase>::fromObject(
+                    new BTagVarintArr<T>(array_type,array,len,false)));
+    }
+
+    // Set an entry in the compound that points to the integer array, it is
+    // serialized bit-packed in blocks of 128 elements 
+    // (DataTypeID::BITPACK_UINT32_ARR or BITPACK_UINT64_ARR by the size of
+    // T). Good for values in a small range like codes or counters.
+    // Ownership is not claimed by this method.
+    template<typename T>
+    void setPackedArray(const STRING_T& tag, T* array, SIZE_T len) {
+#ifdef DEBUG
+        if(tag.size() > 256) {
+            std::cout << 
+                "Error (serialize_::BTagCompound::setPackedArray): Tag too long!" << 
+                std::endl;
+            exit(1);
+        }
+        if((sizeof(T) != 4 && sizeof(T) != 8) || !std::numeric_limits<T>::is_integer) {
+            std::cout << 
+                "Error (serialize_::BTagCompound::setPackedArray): No 32/64 bit integer!" << 
+                std::endl;
+            exit(1);
+        }
+#endif
+        setTag(tag, ptr_::SharedObjPtr<IBTagBase>::fromObject(new BTagBitPackedArr<T>(
+                    (sizeof(T) == 8) ? DataTypeID::BITPACK_UINT64_ARR : DataTypeID::BITPACK_UINT32_ARR,
+                    array,len,false)));
+    }
+
+    // Set an entry in the compound that points to the float or double 
+    // array, it is serialized by the XOR with the previous element 
+    // (DataTypeID::XOR_FLOAT_ARR or XOR_DOUBLE_ARR). Good for slowly
+    // changing series, lossless.
+    // Ownership is not claimed by this method.
+    template<typename T>
+    void setXorArray(const STRING_T& tag, T* array, SIZE_T len) {
+#ifdef DEBUG
+        if(tag.size() > 256) {
+            std::cout << 
+                "Error (serialize_::BTagCompound::setXorArray): Tag too long!" << 
+                std::endl;
+            exit(1);
+        }
+#endif
+        setTag(tag, ptr_::SharedObjPtr<IBTagBase>::fromObject(new BTagXorArr<T>(array,len,false)));
     }
 
     // Set an entry in the compound that points to the array.
@@ -917,7 +2402,7 @@ public:
             exit(1);
         }
 #endif
-        setTag(tag, ptr_::SharedObjPtr<BTagStringArr<T> >(new BTagStringArr<T>(array,len,false)));
+        setTag(tag, ptr_::SharedObjPtr<IBTagBase>::fromObject(new BTagStringArr<T>(array,len,false)));
     }
 
     // Set an entry in the compound that points to the array.
@@ -932,7 +2417,7 @@ public:
             exit(1);
         }
 #endif
-        setTag(tag, ptr_::SharedObjPtr<BTagByteArr<T> >(new BTagByteArr<T>(array,len,true)));
+        setTag(tag, ptr_::SharedObjPtr<IBTagBase>::fromObject(new BTagByteArr<T>(array,len,true)));
     }
 
     // Set an entry in the compound that points to the array.
@@ -947,7 +2432,7 @@ public:
             exit(1);
         }
 #endif
-        setTag(tag, ptr_::SharedObjPtr<BTagShortArr<T> >(new BTagShortArr<T>(array,len,true)));
+        setTag(tag, ptr_::SharedObjPtr<IBTagBase>::fromObject(new BTagShortArr<T>(array,len,true)));
     }
 
     // Set an entry in the compound that points to the array.
@@ -962,7 +2447,7 @@ public:
             exit(1);
         }
 #endif
-        setTag(tag, ptr_::SharedObjPtr<BTagIntArr<T> >(new BTagIntArr<T>(array,len,true)));
+        setTag(tag, ptr_::SharedObjPtr<IBTagBase>::fromObject(new BTagIntArr<T>(array,len,true)));
     }
 
     // Set an entry in the compound that points to the array.
@@ -977,7 +2462,7 @@ public:
             exit(1);
         }
 #endif
-        setTag(tag, ptr_::SharedObjPtr<BTagLongArr<T> >(new BTagLongArr<T>(array,len,true)));
+        setTag(tag, ptr_::SharedObjPtr<IBTagBase>::fromObject(new BTagLongArr<T>(array,len,true)));
     }
 
     // Set an entry in the compound that points to the array.
@@ -992,7 +2477,7 @@ public:
             exit(1);
         }
 #endif
-        setTag(tag, ptr_::SharedObjPtr<BTagFloatArr<T> >(new BTagFloatArr<T>(array,len,true)));
+        setTag(tag, ptr_::SharedObjPtr<IBTagBase>::fromObject(new BTagFloatArr<T>(array,len,true)));
     }
 
     // Set an entry in the compound that points to the array.
@@ -1007,7 +2492,7 @@ public:
             exit(1);
         }
 #endif
-        setTag(tag, ptr_::SharedObjPtr<BTagDoubleArr<T> >(new BTagDoubleArr<T>(array,len,true)));
+        setTag(tag, ptr_::SharedObjPtr<IBTagBase>::fromObject(new BTagDoubleArr<T>(array,len,true)));
     }
 
     // Set an entry in the compound that points to the array.
@@ -1022,157 +2507,123 @@ public:
             exit(1);
         }
 #endif
-        setTag(tag, ptr_::SharedObjPtr<BTagStringArr<T> >(new BTagStringArr<T>(array,len,true)));
+        setTag(tag, ptr_::SharedObjPtr<IBTagBase>::fromObject(new BTagStringArr<T>(array,len,true)));
     }
 
     // Get methods.
     // BT needs to inherit from IBTagBase.
     template<typename BT>
-    ptr_::SharedConstObjPtr<BT> getTag(const STRING_T& tag) const {
-        BTCTagEntry searchtag;
-        searchtag.tag = tag;
-        SIZE_T pos = 0;
-        if (tagmap.size() > 1) {
-            pos = container_::search_lower(tagmap,searchtag);
-        }
-        if ((pos < tagmap.size()) && (tagmap[pos].tag.compare(tag) == 0)) {
+    ptr_::SharedConstObjPtr<BT> getTag(const TagRef& tag) const {
+        SIZE_T pos = findPosition(tag);
+        if (pos < datalist.size()) {
             // Tag exists
             // TODO Add a runtime typecheck here! (Flo)
-            return(ptr_::SharedConstObjPtr<BT>::reinterpretCast(
-                        datalist[tagmap[pos].position].data)
-                    );
+            // Inline numbers are returned as a copy
+            ptr_::SharedConstObjPtr<IBTagBase> val(datalist[pos].isScalar() ? 
+                    datalist[pos].box() : datalist[pos].getData());
+            return(ptr_::SharedConstObjPtr<BT>::reinterpretCast(val));
         } else {
-            throw tag_not_found_error("BTC::serialize_::BTagCompound::getTag", tag);
+            throw tag_not_found_error("BTC::serialize_::BTagCompound::getTag", tag.str());
         }
     }
 
     // BT needs to inherit IBTagBase.
     template<typename BT>
-    ptr_::SharedObjPtr<BT> getTag(const STRING_T& tag) {
-        BTCTagEntry searchtag;
-        searchtag.tag = tag;
-        SIZE_T pos = 0;
-        if (tagmap.size() > 1) {
-            pos = container_::search_lower(tagmap,searchtag);
-        }
-        if ((pos < tagmap.size()) && (tagmap[pos].tag.compare(tag) == 0)) {
+    ptr_::SharedObjPtr<BT> getTag(const TagRef& tag) {
+        SIZE_T pos = findPosition(tag);
+        if (pos < datalist.size()) {
             // Tag exists
             // TODO Add a runtime typecheck here! (Flo)
-            return(ptr_::SharedObjPtr<BT>::reinterpretCast(datalist[tagmap[pos].position].data));
+            if (datalist[pos].isScalar()) {
+                // Move an inline number into a tag object, so that changes 
+                // through the returned pointer are kept
+                datalist[pos].setData(datalist[pos].box());
+            } else if (datalist[pos].lazy) {
+                // Replace the lazy tag (copy first, it owns the object)
+                ptr_::SharedObjPtr<IBTagBase> loaded = datalist[pos].getData();
+                datalist[pos].setData(loaded);
+            }
+            return(ptr_::SharedObjPtr<BT>::reinterpretCast(datalist[pos].data));
         } else {
-            throw tag_not_found_error("BTC::serialize_::BTagCompound::getTag", tag);
+            throw tag_not_found_error("BTC::serialize_::BTagCompound::getTag", tag.str());
         }
     }
 
+    // Numbers are returned by copy: they are stored inside the compound 
+    // and move when tags are added. Use setByte, setInt, ... to change
+    // them. Other values (strings) are returned by reference into their
+    // tag object.
     template<typename T>
-    const T& getValue(const STRING_T& tag) const {
-        BTCTagEntry searchtag;
-        searchtag.tag = tag;
-        SIZE_T pos = 0;
-        if (tagmap.size() > 1) {
-            pos = container_::search_lower(tagmap,searchtag);
-        }
-        if ((pos < tagmap.size()) && (tagmap[pos].tag.compare(tag) == 0)) {
-            // Tag exists
-            if (isValue(datalist[tagmap[pos].position].data->getTypeID())) {
-                return((static_cast<BTagVal<T>&>(*(datalist[tagmap[pos].position].data))).data);
-            } else {
-                throw wrong_type_error("BTC::serialize_::BTagCompound::getValue", "value");
-            }
-        } else {
-            throw tag_not_found_error("BTC::serialize_::BTagCompound::getValue", tag);
-        }
+    typename ValueRef<T>::ConstType getValue(const TagRef& tag) const {
+        return(ValueRef<T>::get(findValue<T>(tag)));
     }
 
     template<typename T>
-    T& getValue(const STRING_T& tag) {
-        BTCTagEntry searchtag;
-        searchtag.tag = tag;
-        SIZE_T pos = 0;
-        if (tagmap.size() > 1) {
-            pos = container_::search_lower(tagmap,searchtag);
-        }
-        if ((pos < tagmap.size()) && (tagmap[pos].tag.compare(tag) == 0)) {
-            // Tag exists
-            if (isValue(datalist[tagmap[pos].position].data->getTypeID())) {
-                return((static_cast<BTagVal<T>&>(*(datalist[tagmap[pos].position].data))).data);
-            } else {
-                throw wrong_type_error("BTC::serialize_::BTagCompound::getValue", "value");
-            }
-        } else {
-            throw tag_not_found_error("BTC::serialize_::BTagCompound::getValue", tag);
-        }
+    typename ValueRef<T>::Type getValue(const TagRef& tag) {
+        return(ValueRef<T>::get(const_cast<BTCDataEntry&>(findValue<T>(tag))));
     }
 
     // Gets the pointer without claiming ownership.
     template<typename T>
-    const T* getArray(const STRING_T& tag, SIZE_T& len) const {
-        BTCTagEntry searchtag;
-        searchtag.tag = tag;
-        SIZE_T pos = 0;
-        if (tagmap.size() > 1) {
-            pos = container_::search_lower(tagmap,searchtag);
-        }
-        if ((pos < tagmap.size()) && (tagmap[pos].tag.compare(tag) == 0)) {
+    const T* getArray(const TagRef& tag, SIZE_T& len) const {
+        SIZE_T pos = findPosition(tag);
+        if (pos < datalist.size()) {
             // Tag exists
-            if (isArray(datalist[tagmap[pos].position].data->getTypeID())) {
+            if (isArray(datalist[pos].getTypeID())) {
                 BTagArr<T>& temp = 
-                    static_cast<BTagArr<T>&>(*(datalist[tagmap[pos].position].data));
+                    static_cast<BTagArr<T>&>(*(datalist[pos].getData()));
                 len = temp.len;
                 return(temp.data);
             } else {
                 throw wrong_type_error("BTC::serialize_::BTagCompound::getArray", "array");
             }
         } else {
-            throw tag_not_found_error("BTC::serialize_::BTagCompound::getArray", tag);
+            throw tag_not_found_error("BTC::serialize_::BTagCompound::getArray", tag.str());
         }
     }
 
     template<typename T>
-    T* getArray(const STRING_T& tag, SIZE_T& len) {
-        BTCTagEntry searchtag;
-        searchtag.tag = tag;
-        SIZE_T pos = 0;
-        if (tagmap.size() > 1) {
-            pos = container_::search_lower(tagmap,searchtag);
-        }
-        if ((pos < tagmap.size()) && (tagmap[pos].tag.compare(tag) == 0)) {
+    T* getArray(const TagRef& tag, SIZE_T& len) {
+        SIZE_T pos = findPosition(tag);
+        if (pos < datalist.size()) {
             // Tag exists
-            if (isArray(datalist[tagmap[pos].position].data->getTypeID())) {
+            if (isArray(datalist[pos].getTypeID())) {
                 BTagArr<T>& temp = 
-                    static_cast<BTagArr<T>&>(*(datalist[tagmap[pos].position].data));
+                    static_cast<BTagArr<T>&>(*(datalist[pos].getData()));
                 len = temp.len;
                 return(temp.data);
             } else {
                 throw wrong_type_error("BTC::serialize_::BTagCompound::getArray", "array");
             }
         } else {
-            throw tag_not_found_error("BTC::serialize_::BTagCompound::getArray", tag);
+            throw tag_not_found_error("BTC::serialize_::BTagCompound::getArray", tag.str());
         }
     }
 
     // Gets the pointer, claims ownership.
+    // An array deserialized with an arena belongs to the arena, the caller
+    // gets a copy made with new[] instead.
     template<typename T>
-    T* retrieveArray(const STRING_T& tag, SIZE_T& len) {
-        BTCTagEntry searchtag;
-        searchtag.tag = tag;
-        SIZE_T pos = 0;
-        if (tagmap.size() > 1) {
-            pos = container_::search_lower(tagmap,searchtag);
-        }
-        if ((pos < tagmap.size()) && (tagmap[pos].tag.compare(tag) == 0)) {
+    T* retrieveArray(const TagRef& tag, SIZE_T& len) {
+        SIZE_T pos = findPosition(tag);
+        if (pos < datalist.size()) {
             // Tag exists
-            if (isArray(datalist[tagmap[pos].position].data->getTypeID())) {
+            if (isArray(datalist[pos].getTypeID())) {
                 BTagArr<T>& temp = 
-                    static_cast<BTagArr<T>&>(*(datalist[tagmap[pos].position].data));
-                temp.owner = false;
+                    static_cast<BTagArr<T>&>(*(datalist[pos].getData()));
                 len = temp.len;
+                if (!temp.owner && datalist[pos].getData()->isPooled()) {
+                    T* copy = new T[temp.len];
+                    std::copy(temp.data,temp.data+temp.len,copy);
+                    return(copy);
+                }
+                temp.owner = false;
                 return(temp.data);
             } else {
                 throw wrong_type_error("BTC::serialize_::BTagCompound::retrieveArray", "array");
             }
         } else {
-            throw tag_not_found_error("BTC::serialize_::BTagCompound::retrieveArray", tag);
+            throw tag_not_found_error("BTC::serialize_::BTagCompound::retrieveArray", tag.str());
         }
     }
 
@@ -1180,26 +2631,26 @@ public:
         return datalist.size();
     }
 
+    bool hasTag(const TagRef& tag) const {
+        return(findPosition(tag) < datalist.size());
+    }
+
     void clear() {
         tagmap.clear();
         datalist.clear();
+        hashindex.clear();
     }
 
     UINT8_T getTypeID() const {
         return DataTypeID::COMPOUND;
     }
 
-    UINT8_T getTypeID(const STRING_T& key) const {
-        BTCTagEntry searchtag;
-        searchtag.tag = key;
-        SIZE_T pos = 0;
-        if (tagmap.size() > 1) {
-            pos = container_::search_lower(tagmap,searchtag);
-        }
-        if ((pos < tagmap.size()) && (tagmap[pos].tag.compare(key) == 0)) {
-            return(datalist[tagmap[pos].position].data->getTypeID());
+    UINT8_T getTypeID(const TagRef& key) const {
+        SIZE_T pos = findPosition(key);
+        if (pos < datalist.size()) {
+            return(datalist[pos].getTypeID());
         } else {
-            throw tag_not_found_error("BTC::serialize_::BTagCompound::getTypeID", key);
+            throw tag_not_found_error("BTC::serialize_::BTagCompound::getTypeID", key.str());
         }
     }
 
@@ -1211,111 +2662,300 @@ public:
         for (SIZE_T i=0; i<datalen; ++i) {
             bytesize += 2;
             bytesize += datalist[i].tag.size();
-            bytesize += datalist[i].data->getByteSize();
+            bytesize += datalist[i].getByteSize();
         }
         return bytesize;
     }
 
+    // Appends the byte sizes of the nested compounds to sizes, in the order
+    // serialize() writes them, so that every subtree is measured only once
+    // (instead of once per level above it).
+    // Returns the byte size of this compound, 0 unless measure is set.
+    SIZE_T getByteSizes(std::vector<SIZE_T>& sizes, bool measure = true) const {
+        SIZE_T bytesize = getIntVarByteSize(datalist.size());
+        for (SIZE_T i=0; i<datalist.size(); ++i) {
+            const BTagCompound* comp = datalist[i].getCompound();
+            if (comp) {
+                SIZE_T slot = sizes.size();
+                sizes.push_back(0);
+                SIZE_T size = comp->getByteSizes(sizes);
+                sizes[slot] = size;
+                bytesize += 2 + datalist[i].tag.size() + getIntVarByteSize(size) + size;
+            } else if (measure) {
+                bytesize += 2 + datalist[i].tag.size() + datalist[i].getByteSize();
+            }
+        }
+        return(measure ? bytesize : 0);
+    }
+
     // Serialization methods.
+    // The stream versions pass through a BufferSink/BufferSource.
     void serialize(std::ostream& os) const {
+        BufferSink sink(os);
+        serialize(sink);
+        sink.flush();
+    }
+
+    void serialize(BufferSink& os) const {
+        std::vector<SIZE_T> sizes;
+        getByteSizes(sizes,false);
+        SIZE_T next = 0;
+        serialize(os,sizes,next);
+    }
+
+    // Serializes with the sizes from getByteSizes(), next is the index of
+    // the first size that belongs to this compound.
+    void serialize(BufferSink& os, const std::vector<SIZE_T>& sizes, SIZE_T& next) const {
         serializeIntVar(os,datalist.size());
         for(SIZE_T i=0; i<datalist.size(); ++i) {
             serializeString8(os,datalist[i].tag);
-            serializeByte(os,datalist[i].data->getTypeID());
-            datalist[i].data->serialize(os);
+            serializeByte(os,datalist[i].getTypeID());
+            const BTagCompound* comp = datalist[i].getCompound();
+            if (comp) {
+                serializeIntVar(os,sizes[next++]);
+                comp->serialize(os,sizes,next);
+            } else {
+                datalist[i].serialize(os);
+            }
         }
     }
 
     void deserialize(std::istream& is) {
+        BufferSource source(is);
+        deserialize(source);
+    }
+
+    // Serialize into a vector that is sized once from getByteSize().
+    // The capacity of the vector is reused, so encoding into the same
+    // vector repeatedly does not allocate once it is large enough.
+    // sizes is scratch space for the byte sizes of nested compounds (see
+    // getByteSizes()); without it a compound with nested compounds 
+    // allocates a list of sizes on every call.
+    // Returns the number of bytes written (the new size of the vector).
+    SIZE_T serializeTo(std::vector<char>& buffer, std::vector<SIZE_T>& sizes) const {
+        sizes.clear();
+        SIZE_T bytesize = getByteSizes(sizes);
+        buffer.resize(bytesize);
+        BufferSink sink(&buffer[0],bytesize);
+        SIZE_T next = 0;
+        serialize(sink,sizes,next);
+        return bytesize;
+    }
+
+    SIZE_T serializeTo(std::vector<char>& buffer) const {
+        std::vector<SIZE_T> sizes;
+        return serializeTo(buffer,sizes);
+    }
+
+    // Serialize into caller-owned memory, sizes as above.
+    // Throws buffer_overflow_error if len is smaller than getByteSize().
+    // Returns the number of bytes written.
+    SIZE_T serializeTo(char* data, SIZE_T len, std::vector<SIZE_T>& sizes) const {
+        sizes.clear();
+        SIZE_T bytesize = getByteSizes(sizes);
+        if (bytesize > len) {
+            throw buffer_overflow_error("BTC::serialize_::BTagCompound::serializeTo", bytesize, len);
+        }
+        BufferSink sink(data,bytesize);
+        SIZE_T next = 0;
+        serialize(sink,sizes,next);
+        return bytesize;
+    }
+
+    SIZE_T serializeTo(char* data, SIZE_T len) const {
+        std::vector<SIZE_T> sizes;
+        return serializeTo(data,len,sizes);
+    }
+
+    // Serializes like serialize(os,sizes,next) into a memory sink, but 
+    // entries of at least min_size bytes are skipped and added to deferred;
+    // writing them later with BTCDataEntry::serialize() completes the 
+    // output. Large nested compounds are split up the same way.
+    // Used by parallelSerialize().
+    void serializeSkeleton(BufferSink& os, SIZE_T min_size, std::vector<DeferredEntry>& deferred,
+            const std::vector<SIZE_T>& sizes, SIZE_T& next) const {
+        serializeIntVar(os,datalist.size());
+        for(SIZE_T i=0; i<datalist.size(); ++i) {
+            const BTCDataEntry& entry = datalist[i];
+            serializeString8(os,entry.tag);
+            serializeByte(os,entry.getTypeID());
+            const BTagCompound* comp = entry.getCompound();
+            if (comp) {
+                SIZE_T size = sizes[next++];
+                serializeIntVar(os,size);
+                if (getIntVarByteSize(size)+size < min_size) {
+                    comp->serialize(os,sizes,next);
+                } else {
+                    comp->serializeSkeleton(os,min_size,deferred,sizes,next);
+                }
+                continue;
+            }
+            SIZE_T bytesize = entry.getByteSize();
+            if (entry.isScalar() || (bytesize < min_size)) {
+                entry.serialize(os);
+            } else {
+                DeferredEntry part;
+                part.entry = &entry;
+                part.offset = SIZE_T(os.getByteCount());
+                part.size = bytesize;
+                deferred.push_back(part);
+                os.skip(bytesize);
+            }
+        }
+    }
+
+    // Deserialize from memory.
+    // Returns the number of bytes read.
+    SIZE_T deserializeFrom(const char* data, SIZE_T len) {
+        BufferSource source(data,len);
+        deserialize(source);
+        return len-source.remaining();
+    }
+
+    // New tag object of type BT, constructed in the arena if there is one.
+    template<typename BT>
+    static BT* newTag(container_::Arena* arena) {
+        if (!arena) {
+            return(new BT());
+        }
+        BT* tag = new(arena->allocate(sizeof(BT))) BT();
+        tag->setPooled();
+        return(tag);
+    }
+
+    template<typename BT, typename A>
+    static BT* newTag(container_::Arena* arena, const A& arg) {
+        if (!arena) {
+            return(new BT(arg));
+        }
+        BT* tag = new(arena->allocate(sizeof(BT))) BT(arg);
+        tag->setPooled();
+        return(tag);
+    }
+
+    // New empty tag object for a type ID, as used by deserialize().
+    // Compounds get a hash index if hashed is set.
+    // With an arena the object is constructed in its memory, the arena has
+    // to outlive it.
+    // Throws unknown_type_error for an unknown type.
+    static IBTagBase* createTag(UINT8_T type_id, bool hashed = false, 
+            container_::Arena* arena = 0) {
+        if(isCompound(type_id)) {
+            BTagCompound* comp = newTag<BTagCompound>(arena);
+            comp->setHashIndex(hashed);
+            return(comp);
+        } else if(type_id == DataTypeID::STRING) {
+            return(newTag<BTagString<STRING_T> >(arena));
+        } else if((type_id == DataTypeID::STRING_ARR) || 
+                  (type_id == DataTypeID::STRING_ARR_LEGACY)) {
+            return(newTag<BTagStringArr<STRING_T> >(arena));
+        } else if(type_id == DataTypeID::UINT8_ARR) {
+            return(newTag<BTagByteArr<UINT8_T> >(arena));
+        } else if(type_id == DataTypeID::UINT16_ARR) {
+            return(newTag<BTagShortArr<UINT16_T> >(arena));
+        } else if(type_id == DataTypeID::UINT32_ARR) {
+            return(newTag<BTagIntArr<UINT32_T> >(arena));
+        } else if(type_id == DataTypeID::UINT64_ARR) {
+            return(newTag<BTagLongArr<UINT64_T> >(arena));
+        } else if(type_id == DataTypeID::FLOAT_ARR) {
+            return(newTag<BTagFloatArr<FLOAT_T> >(arena));
+        } else if(type_id == DataTypeID::DOUBLE_ARR) {
+            return(newTag<BTagDoubleArr<DOUBLE_T> >(arena));
+        } else if(type_id == DataTypeID::CHUNKED_UINT8_ARR) {
+            return(newTag<BTagChunkedArr<UINT8_T> >(arena,DataTypeID::UINT8_ARR));
+        } else if(type_id == DataTypeID::CHUNKED_UINT16_ARR) {
+            return(newTag<BTagChunkedArr<UINT16_T> >(arena,DataTypeID::UINT16_ARR));
+        } else if(type_id == DataTypeID::CHUNKED_UINT32_ARR) {
+            return(newTag<BTagChunkedArr<UINT32_T> >(arena,DataTypeID::UINT32_ARR));
+        } else if(type_id == DataTypeID::CHUNKED_UINT64_ARR) {
+            return(newTag<BTagChunkedArr<UINT64_T> >(arena,DataTypeID::UINT64_ARR));
+        } else if(type_id == DataTypeID::CHUNKED_FLOAT_ARR) {
+            return(newTag<BTagChunkedArr<FLOAT_T> >(arena,DataTypeID::FLOAT_ARR));
+        } else if(type_id == DataTypeID::CHUNKED_DOUBLE_ARR) {
+            return(newTag<BTagChunkedArr<DOUBLE_T> >(arena,DataTypeID::DOUBLE_ARR));
+        } else if(type_id == DataTypeID::DELTA_UINT32_ARR || type_id == DataTypeID::ZIGZAG_UINT32_ARR) {
+            return(newTag<BTagVarintArr<UINT32_T> >(arena,type_id));
+        } else if(type_id == DataTypeID::DELTA_UINT64_ARR || type_id == DataTypeID::ZIGZAG_UINT64_ARR) {
+            return(newTag<BTagVarintArr<UINT64_T> >(arena,type_id));
+        } else if(type_id == DataTypeID::BITPACK_UINT32_ARR) {
+            return(newTag<BTagBitPackedArr<UINT32_T> >(arena,type_id));
+        } else if(type_id == DataTypeID::BITPACK_UINT64_ARR) {
+            return(newTag<BTagBitPackedArr<UINT64_T> >(arena,type_id));
+        } else if(type_id == DataTypeID::XOR_FLOAT_ARR) {
+            return(newTag<BTagXorArr<FLOAT_T> >(arena));
+        } else if(type_id == DataTypeID::XOR_DOUBLE_ARR) {
+            return(newTag<BTagXorArr<DOUBLE_T> >(arena));
+        } else if(type_id == DataTypeID::FLOAT_ARR_LEGACY) {
+            return(newTag<BTagFloatArrLegacy<FLOAT_T> >(arena));
+        } else if(type_id == DataTypeID::DOUBLE_ARR_LEGACY) {
+            return(newTag<BTagDoubleArrLegacy<DOUBLE_T> >(arena));
+        }
+        throw unknown_type_error("BTC::serialize_::BTagCompound::createTag", type_id);
+    }
+
+    // Deserialize from memory, but nested compounds and arrays only on 
+    // their first access (see BufferSource::setLazy()).
+    // The memory has to outlive this compound.
+    // Returns the number of bytes read.
+    SIZE_T deserializeLazy(const char* data, SIZE_T len) {
+        BufferSource source(data,len);
+        source.setLazy(true);
+        deserialize(source);
+        return len-source.remaining();
+    }
+
+    // Deserialize from memory, the tag objects below this compound and the
+    // payloads of number arrays are taken from the arena (see 
+    // BufferSource::setArena()). The entry lists of the compounds and 
+    // strings longer than the short string buffer still use the heap 
+    // (two allocations per compound), they are freed when the tags are 
+    // destroyed, which has to happen before the arena is released.
+    // Returns the number of bytes read.
+    SIZE_T deserializeFrom(const char* data, SIZE_T len, container_::Arena& arena) {
+        BufferSource source(data,len);
+        source.setArena(&arena);
+        deserialize(source);
+        return len-source.remaining();
+    }
+
+    // Deserialize only the entries selected by the projection.
+    void deserialize(std::istream& is, const Projection& projection) {
+        BufferSource source(is);
+        deserialize(source,projection);
+    }
+
+    // Returns the number of bytes read.
+    SIZE_T deserializeFrom(const char* data, SIZE_T len, const Projection& projection) {
+        BufferSource source(data,len);
+        deserialize(source,projection);
+        return len-source.remaining();
+    }
+
+    void deserialize(BufferSource& is) {
         UINT64_T data_size = deserializeIntVar<UINT64_T>(is);
-        UINT8_T type_temp;
+        // Reserve the lists once when reading from memory (an entry has at
+        // least 3 bytes, so a corrupt size cannot reserve too much)
+        if (!is.getStream() && (data_size > 0)) {
+            SIZE_T expected = datalist.size() + 
+                SIZE_T(std::min(data_size, UINT64_T(is.remaining()/3)));
+            datalist.setCapacity(expected);
+            tagmap.setCapacity(expected);
+        }
         for(SIZE_T i=0; i<data_size; ++i) {
             datalist.add(BTCDataEntry());
             // tag
             datalist[datalist.size()-1].tag = deserializeString8(is);
             // type
-            type_temp = deserializeByte(is);
-            // create new tag
-            if(type_temp == DataTypeID::COMPOUND) {
-                datalist[datalist.size()-1].data = 
-                    ptr_::SharedObjPtr<IBTagBase>::fromObject((IBTagBase*) new BTagCompound());
-            } else if(type_temp == DataTypeID::STRING) {
-                datalist[datalist.size()-1].data =
-                    ptr_::SharedObjPtr<IBTagBase>::fromObject(
-                            (IBTagBase*) new BTagString<STRING_T>()
-                        );
-            } else if(type_temp == DataTypeID::UINT8) {
-                datalist[datalist.size()-1].data =
-                    ptr_::SharedObjPtr<IBTagBase>::fromObject(
-                            (IBTagBase*) new BTagByte<UINT8_T>()
-                        );
-            } else if(type_temp == DataTypeID::UINT16) {
-                datalist[datalist.size()-1].data =
-                    ptr_::SharedObjPtr<IBTagBase>::fromObject(
-                            (IBTagBase*) new BTagShort<UINT16_T>()
-                        );
-            } else if(type_temp == DataTypeID::UINT32) {
-                datalist[datalist.size()-1].data =
-                    ptr_::SharedObjPtr<IBTagBase>::fromObject(
-                            (IBTagBase*) new BTagInt<UINT32_T>()
-                        );
-            } else if(type_temp == DataTypeID::UINT64) {
-                datalist[datalist.size()-1].data =
-                    ptr_::SharedObjPtr<IBTagBase>::fromObject(
-                            (IBTagBase*) new BTagLong<UINT64_T>()
-                        );
-            } else if(type_temp == DataTypeID::FLOAT) {
-                datalist[datalist.size()-1].data =
-                    ptr_::SharedObjPtr<IBTagBase>::fromObject(
-                            (IBTagBase*) new BTagFloat<FLOAT_T>()
-                        );
-            } else if((type_temp) == DataTypeID::DOUBLE) {
-                datalist[datalist.size()-1].data =
-                    ptr_::SharedObjPtr<IBTagBase>::fromObject(
-                            (IBTagBase*) new BTagDouble<DOUBLE_T>()
-                        );
-            } else if((type_temp) == DataTypeID::STRING_ARR) {
-                datalist[datalist.size()-1].data =
-                    ptr_::SharedObjPtr<IBTagBase>::fromObject(
-                            (IBTagBase*) new BTagStringArr<STRING_T>()
-                        );
-            } else if((type_temp) == DataTypeID::UINT8_ARR) {
-                datalist[datalist.size()-1].data =
-                    ptr_::SharedObjPtr<IBTagBase>::fromObject(
-                            (IBTagBase*) new BTagByteArr<UINT8_T>()
-                        );
-            } else if((type_temp) == DataTypeID::UINT16_ARR) {
-                datalist[datalist.size()-1].data =
-                    ptr_::SharedObjPtr<IBTagBase>::fromObject(
-                            (IBTagBase*) new BTagShortArr<UINT16_T>()
-                        );
-            } else if((type_temp) == DataTypeID::UINT32_ARR) {
-                datalist[datalist.size()-1].data =
-                    ptr_::SharedObjPtr<IBTagBase>::fromObject(
-                            (IBTagBase*) new BTagIntArr<UINT32_T>()
-                        );
-            } else if((type_temp) == DataTypeID::UINT64_ARR) {
-                datalist[datalist.size()-1].data =
-                    ptr_::SharedObjPtr<IBTagBase>::fromObject(
-                            (IBTagBase*) new BTagLongArr<UINT64_T>()
-                        );
-            } else if((type_temp) == DataTypeID::FLOAT_ARR) {
-                datalist[datalist.size()-1].data =
-                    ptr_::SharedObjPtr<IBTagBase>::fromObject(
-                            (IBTagBase*) new BTagFloatArr<FLOAT_T>()
-                        );
-            } else if((type_temp) == DataTypeID::DOUBLE_ARR) {
-                datalist[datalist.size()-1].data =
-                    ptr_::SharedObjPtr<IBTagBase>::fromObject(
-                            (IBTagBase*) new BTagDoubleArr<DOUBLE_T>()
-                        );
-            }
-            datalist[datalist.size()-1].data->deserialize(is);
-            tagmap.add(BTCTagEntry());
-            tagmap[tagmap.size()-1].tag = datalist[datalist.size()-1].tag;
-            tagmap[tagmap.size()-1].position = datalist.size()-1;
+            UINT8_T type_temp = deserializeByte(is);
+            deserializeData(is,datalist[datalist.size()-1],type_temp);
+            tagmap.add(datalist.size()-1);
         }
-        if(tagmap.size() > 1) container_::sort(tagmap);
+        if(tagmap.size() > 1) container_::sort(tagmap,TagOrder(datalist));
+        if(hashed) rebuildHashIndex();
+    }
+
+    void deserialize(BufferSource& is, const Projection& projection) {
+        deserializeProjected(is,projection,Projection::ROOT);
     }
 
     std::ostream& print(std::ostream& os, UINT8_T increment) const {
@@ -1330,7 +2970,7 @@ public:
                 os << ' ';
             }
             os << '(' << i << ",\'" << datalist[i].tag << "\'):";
-            datalist[i].data->print(os,increment+1);
+            datalist[i].print(os,increment+1);
         }
         os << '\n';
         for (UINT8_T i=0; i<increment*2; ++i) {
@@ -1347,6 +2987,42 @@ std::ostream& operator<<(std::ostream& os, const BTagCompound& btc) {
     return(btc.print(os,0));
 }
 
+inline const BTagCompound* BTCDataEntry::getCompound() const {
+    if (isScalar() || (data->getTypeID() != DataTypeID::COMPOUND)) {
+        return 0;
+    }
+    if (lazy) {
+        const BTagLazy& placeholder = static_cast<const BTagLazy&>(*data);
+        if (!placeholder.isLoaded()) {
+            return 0;
+        }
+        return static_cast<const BTagCompound*>(&*placeholder.get());
+    }
+    return static_cast<const BTagCompound*>(&*data);
+}
+
+inline void BTagLazy::load() const {
+    tag = ptr_::SharedObjPtr<IBTagBase>::fromObject(BTagCompound::createTag(type_id,hashed,arena));
+    BufferSource source(payload,len);
+    source.setArena(arena);
+    source.setLazy(true);
+    tag->deserialize(source);
+    loaded = true;
+}
+
+inline const ptr_::SharedObjPtr<IBTagBase>& BTagLazy::get() const {
+#ifdef ATOMIC_REFCOUNT
+    if (!loaded) {
+        std::call_once(once,&BTagLazy::load,this);
+    }
+#else
+    if (!loaded) {
+        load();
+    }
+#endif
+    return tag;
+}
+
 }}
 
 #endif
@@ -0,0 +1,263 @@
+#ifndef BTC_SERIALIZE_BUFFER_H
+#define BTC_SERIALIZE_BUFFER_H
+
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <cstring>
+
+#include "container_/Arena.h"
+
+#include "data_type.h"
+#include "exception.h"
+
+namespace BTC {
+namespace serialize_ {
+
+/**
+ * Byte sink that collects the output in a contiguous buffer.
+ * It offers the same write(const char*, n) call as std::ostream so that
+ * all functions in function.h accept both.
+ * Writing is an inlined bounds check plus memcpy.
+ * Three modes:
+ *  - Attached to an std::ostream: the buffer is written to the stream
+ *    whenever it is full and on flush(). Writes larger than the buffer
+ *    go to the stream directly.
+ *  - Stand-alone: the buffer grows as needed and the result can be
+ *    accessed with data() and size().
+ *  - Over caller-owned memory of fixed size: writing beyond the end 
+ *    throws buffer_overflow_error.
+ */
+class BufferSink {
+
+    char* buffer;
+    SIZE_T capacity;
+    SIZE_T pos;
+    std::ostream* stream;
+    bool owner;
+    // Bytes passed to the stream so far
+    UINT64_T flushed;
+
+    BufferSink(const BufferSink& sink);
+    BufferSink& operator=(const BufferSink& sink);
+
+    void overflow(const char* src, SIZE_T n) {
+        if (stream) {
+            flush();
+            if (n >= capacity) {
+                stream->write(src,n);
+                flushed += n;
+                return;
+            }
+        } else if (!owner) {
+            throw buffer_overflow_error("BTC::serialize_::BufferSink::write", n, capacity-pos);
+        } else {
+            SIZE_T new_cap = 2*capacity;
+            if (new_cap < pos+n) {
+                new_cap = pos+n;
+            }
+            char* new_buffer = new char[new_cap];
+            std::memcpy(new_buffer,buffer,pos);
+            delete[] buffer;
+            buffer = new_buffer;
+            capacity = new_cap;
+        }
+        std::memcpy(buffer+pos,src,n);
+        pos += n;
+    }
+
+  public:
+    static const SIZE_T DEFAULT_CAPACITY = 16384;
+
+    BufferSink()
+            : buffer(new char[DEFAULT_CAPACITY]), capacity(DEFAULT_CAPACITY),
+              pos(0), stream(0), owner(true), flushed(0) {
+    }
+
+    explicit BufferSink(std::ostream& os, SIZE_T cap = DEFAULT_CAPACITY)
+            : buffer(new char[cap]), capacity(cap), pos(0), stream(&os), owner(true), flushed(0) {
+    }
+
+    BufferSink(char* data, SIZE_T len)
+            : buffer(data), capacity(len), pos(0), stream(0), owner(false), flushed(0) {
+    }
+
+    ~BufferSink() {
+        flush();
+        if (owner) {
+            delete[] buffer;
+        }
+    }
+
+    void write(const char* src, SIZE_T n) {
+        if (n > capacity-pos) {
+            overflow(src,n);
+            return;
+        }
+        std::memcpy(buffer+pos,src,n);
+        pos += n;
+    }
+
+    // Leaves n bytes unwritten, they are filled in later through data().
+    // The bytes have to fit into the buffer, only for memory sinks.
+    void skip(SIZE_T n) {
+        if (stream || (n > capacity-pos)) {
+            throw buffer_overflow_error("BTC::serialize_::BufferSink::skip", n, stream ? 0 : capacity-pos);
+        }
+        pos += n;
+    }
+
+    // Writes the buffered bytes to the attached stream.
+    // Does nothing for a stand-alone sink.
+    void flush() {
+        if (stream && pos > 0) {
+            stream->write(buffer,pos);
+            flushed += pos;
+            pos = 0;
+        }
+    }
+
+    const char* data() const {
+        return buffer;
+    }
+
+    // The buffered bytes may be changed in place (see BTagWriter).
+    char* data() {
+        return buffer;
+    }
+
+    // Number of buffered bytes.
+    SIZE_T size() const {
+        return pos;
+    }
+
+    // Number of bytes written in total, the buffered ones included.
+    UINT64_T getByteCount() const {
+        return flushed+pos;
+    }
+
+    void clear() {
+        pos = 0;
+    }
+};
+
+/**
+ * Byte source that reads from a contiguous range of memory.
+ * It offers the same read(char*, n) call as std::istream so that
+ * all functions in function.h accept both.
+ * Reading is an inlined bounds check plus memcpy.
+ * Reading beyond the end throws buffer_overflow_error.
+ * The source can also be attached to an std::istream: then every read
+ * goes to the stream buffer directly (no sentry object and exactly the
+ * requested bytes are consumed, so the stream position stays correct).
+ * A short read sets failbit and eofbit on the stream as istream::read does.
+ * If an arena is set, the payloads of deserialized number arrays are taken
+ * from it instead of new[] (see newArray() in function.h).
+ * In lazy mode a BTagCompound read from memory only records the byte 
+ * ranges of nested compounds and arrays and deserializes them on first
+ * access. The memory then has to outlive the compound.
+ */
+class BufferSource {
+
+    const char* pos;
+    const char* end;
+    std::istream* stream;
+    container_::Arena* arena;
+    bool lazy;
+
+    void underflow(char* dst, SIZE_T n) {
+        if (stream) {
+            std::streamsize count = stream->rdbuf()->sgetn(dst,n);
+            if (count < std::streamsize(n)) {
+                stream->setstate(std::ios::failbit | std::ios::eofbit);
+            }
+            return;
+        }
+        throw buffer_overflow_error("BTC::serialize_::BufferSource::read", n, end-pos);
+    }
+
+  public:
+    BufferSource(const char* data, SIZE_T len)
+            : pos(data), end(data+len), stream(0), arena(0), lazy(false) {
+    }
+
+    explicit BufferSource(std::istream& is)
+            : pos(0), end(0), stream(&is), arena(0), lazy(false) {
+    }
+
+    void read(char* dst, SIZE_T n) {
+        if (n > SIZE_T(end-pos)) {
+            underflow(dst,n);
+            return;
+        }
+        std::memcpy(dst,pos,n);
+        pos += n;
+    }
+
+    // Skip n bytes.
+    void skip(SIZE_T n) {
+        if (n > SIZE_T(end-pos)) {
+            if (stream) {
+                stream->ignore(n);
+                return;
+            }
+            throw buffer_overflow_error("BTC::serialize_::BufferSource::skip", n, end-pos);
+        }
+        pos += n;
+    }
+
+    // Current position in memory (null if attached to a stream).
+    const char* current() const {
+        return pos;
+    }
+
+    // Bytes left in memory (zero if attached to a stream).
+    SIZE_T remaining() const {
+        return end-pos;
+    }
+
+    std::istream* getStream() const {
+        return stream;
+    }
+
+    // Tag objects and array payloads are allocated in the arena, it has to
+    // outlive everything deserialized from this source.
+    void setArena(container_::Arena* a) {
+        arena = a;
+    }
+
+    container_::Arena* getArena() const {
+        return arena;
+    }
+
+    // Has no effect when attached to a stream.
+    void setLazy(bool l) {
+        lazy = l;
+    }
+
+    bool isLazy() const {
+        return lazy;
+    }
+};
+
+/**
+ * Stream buffer over a range of memory.
+ * Used to hand a memory source to a tag that only implements the
+ * std::istream interface.
+ */
+class MemoryStreamBuf : public std::streambuf {
+
+  public:
+    MemoryStreamBuf(const char* begin, const char* end) {
+        char* b = const_cast<char*>(begin);
+        setg(b,b,const_cast<char*>(end));
+    }
+
+    SIZE_T consumed() const {
+        return gptr()-eback();
+    }
+};
+
+}}
+
+#endif
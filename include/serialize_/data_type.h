@@ -29,30 +29,109 @@ typedef double DOUBLE_T;
 typedef std::string STRING_T;
 //#endif
 
+// Type IDs as written to the stream.
+// A change of the encoding of a type gets a new ID, the old one is kept
+// with the suffix _LEGACY so that old data can still be read.
+// Legacy types are converted to the current ones when deserialized.
+// Numbers and strings use the IDs 1 to 31, compounds 0 and 32 to 63 and
+// arrays 64 and above.
+// COMPOUND and STRING_ARR are written with the byte size of their
+// payload in front (see hasByteSize()), so that readers can skip them.
 namespace DataTypeID {
-static const unsigned char COMPOUND = 0;
+static const unsigned char COMPOUND_LEGACY = 0;
 static const unsigned char STRING = 1;
 static const unsigned char UINT8 = 2;
 static const unsigned char UINT16 = 3;
 static const unsigned char UINT32 = 4;
 static const unsigned char UINT64 = 5;
-static const unsigned char FLOAT = 6;
-static const unsigned char DOUBLE = 7;
-static const unsigned char STRING_ARR = 64;
+static const unsigned char FLOAT_LEGACY = 6;
+static const unsigned char DOUBLE_LEGACY = 7;
+static const unsigned char FLOAT = 8;
+static const unsigned char DOUBLE = 9;
+static const unsigned char COMPOUND = 32;
+static const unsigned char STRING_ARR_LEGACY = 64;
 static const unsigned char UINT8_ARR = 65;
 static const unsigned char UINT16_ARR = 66;
 static const unsigned char UINT32_ARR = 67;
 static const unsigned char UINT64_ARR = 68;
-static const unsigned char FLOAT_ARR = 69;
-static const unsigned char DOUBLE_ARR = 70;
+static const unsigned char FLOAT_ARR_LEGACY = 69;
+static const unsigned char DOUBLE_ARR_LEGACY = 70;
+static const unsigned char FLOAT_ARR = 71;
+static const unsigned char DOUBLE_ARR = 72;
+static const unsigned char STRING_ARR = 73;
+// Integer arrays as varints (7 bits per byte, see BTagVarintArr).
+// DELTA stores the zigzag encoded difference to the previous element
+// (for sorted data like timestamps), ZIGZAG the zigzag encoded element
+// (for small signed values).
+static const unsigned char DELTA_UINT32_ARR = 80;
+static const unsigned char DELTA_UINT64_ARR = 81;
+static const unsigned char ZIGZAG_UINT32_ARR = 82;
+static const unsigned char ZIGZAG_UINT64_ARR = 83;
+// Integer arrays in blocks of 128 elements, each stored as the offset to
+// the smallest element of the block with as few bits as the block needs
+// (frame of reference, see BTagBitPackedArr).
+static const unsigned char BITPACK_UINT32_ARR = 84;
+static const unsigned char BITPACK_UINT64_ARR = 85;
+// Float arrays as the XOR of every element with its predecessor with
+// the zero bits left out (Gorilla, see BTagXorArr), for slowly changing
+// series. Lossless.
+static const unsigned char XOR_FLOAT_ARR = 86;
+static const unsigned char XOR_DOUBLE_ARR = 87;
+// Number arrays split into chunks with an offset table, so that a range
+// can be read without decoding the whole array.
+static const unsigned char CHUNKED_UINT8_ARR = 96;
+static const unsigned char CHUNKED_UINT16_ARR = 97;
+static const unsigned char CHUNKED_UINT32_ARR = 98;
+static const unsigned char CHUNKED_UINT64_ARR = 99;
+static const unsigned char CHUNKED_FLOAT_ARR = 100;
+static const unsigned char CHUNKED_DOUBLE_ARR = 101;
 }
 
 inline bool isValue(unsigned char type_id) {
-    return((type_id > DataTypeID::COMPOUND) && (type_id < DataTypeID::STRING_ARR));
+    return((type_id > DataTypeID::COMPOUND_LEGACY) && (type_id < DataTypeID::COMPOUND));
+}
+
+inline bool isCompound(unsigned char type_id) {
+    return((type_id == DataTypeID::COMPOUND_LEGACY) || (type_id == DataTypeID::COMPOUND));
 }
 
 inline bool isArray(unsigned char type_id) {
-    return(type_id >= DataTypeID::STRING_ARR);
+    return(type_id >= DataTypeID::STRING_ARR_LEGACY);
+}
+
+inline bool isChunkedArray(unsigned char type_id) {
+    return((type_id >= DataTypeID::CHUNKED_UINT8_ARR) && (type_id <= DataTypeID::CHUNKED_DOUBLE_ARR));
+}
+
+inline bool isVarintArray(unsigned char type_id) {
+    return((type_id >= DataTypeID::DELTA_UINT32_ARR) && (type_id <= DataTypeID::ZIGZAG_UINT64_ARR));
+}
+
+inline bool isBitPackedArray(unsigned char type_id) {
+    return((type_id == DataTypeID::BITPACK_UINT32_ARR) || (type_id == DataTypeID::BITPACK_UINT64_ARR));
+}
+
+inline bool isXorArray(unsigned char type_id) {
+    return((type_id == DataTypeID::XOR_FLOAT_ARR) || (type_id == DataTypeID::XOR_DOUBLE_ARR));
+}
+
+// The payload starts with its byte size (an int var).
+inline bool hasByteSize(unsigned char type_id) {
+    return((type_id == DataTypeID::COMPOUND) || (type_id == DataTypeID::STRING_ARR) ||
+           isChunkedArray(type_id));
+}
+
+// Chunked type of a number array type, 0 if there is none.
+inline unsigned char getChunkedTypeID(unsigned char array_type) {
+    switch (array_type) {
+        case DataTypeID::UINT8_ARR: return DataTypeID::CHUNKED_UINT8_ARR;
+        case DataTypeID::UINT16_ARR: return DataTypeID::CHUNKED_UINT16_ARR;
+        case DataTypeID::UINT32_ARR: return DataTypeID::CHUNKED_UINT32_ARR;
+        case DataTypeID::UINT64_ARR: return DataTypeID::CHUNKED_UINT64_ARR;
+        case DataTypeID::FLOAT_ARR: return DataTypeID::CHUNKED_FLOAT_ARR;
+        case DataTypeID::DOUBLE_ARR: return DataTypeID::CHUNKED_DOUBLE_ARR;
+        default: return 0;
+    }
 }
 
 /*template<typename T> struct DataType { static const unsigned char value = 255; };
@@ -2,6 +2,8 @@
 #define BTC_SERIALIZE_EXCEPTION_H_
 
 #include <exception>
+#include <sstream>
+#include <string>
 
 class tag_not_found_error : public std::exception {
 
@@ -43,4 +45,103 @@ class wrong_type_error : public std::exception {
     }
 };
 
+class buffer_overflow_error : public std::exception {
+
+    std::string msg;
+
+  public:
+    buffer_overflow_error(const std::string& method_name, size_t requested, size_t available) 
+            : msg("Error (") {
+        std::ostringstream ss;
+        ss << method_name << "): Access of " << requested << " bytes exceeds the buffer (" << 
+            available << " bytes left)!";
+        msg += ss.str();
+    }
+
+    ~buffer_overflow_error() throw() {}
+
+    const char* what() const throw() {
+        return (msg.c_str());
+    }
+};
+
+class unknown_type_error : public std::exception {
+
+    std::string msg;
+
+  public:
+    unknown_type_error(const std::string& method_name, unsigned int type_id) 
+            : msg("Error (") {
+        std::ostringstream ss;
+        ss << method_name << "): Unknown type ID " << type_id << "!";
+        msg += ss.str();
+    }
+
+    ~unknown_type_error() throw() {}
+
+    const char* what() const throw() {
+        return (msg.c_str());
+    }
+};
+
+class io_error : public std::exception {
+
+    std::string msg;
+
+  public:
+    io_error(const std::string& method_name, const std::string& path) 
+            : msg("Error (") {
+        msg += method_name;
+        msg += "): Cannot access the file \"";
+        msg += path;
+        msg += "\"!";
+    }
+
+    ~io_error() throw() {}
+
+    const char* what() const throw() {
+        return (msg.c_str());
+    }
+};
+
+class stream_error : public std::exception {
+
+    std::string msg;
+
+  public:
+    stream_error(const std::string& method_name, const std::string& reason) 
+            : msg("Error (") {
+        msg += method_name;
+        msg += "): ";
+        msg += reason;
+        msg += "!";
+    }
+
+    ~stream_error() throw() {}
+
+    const char* what() const throw() {
+        return (msg.c_str());
+    }
+};
+
+class format_error : public std::exception {
+
+    std::string msg;
+
+  public:
+    format_error(const std::string& method_name, const std::string& reason) 
+            : msg("Error (") {
+        msg += method_name;
+        msg += "): ";
+        msg += reason;
+        msg += "!";
+    }
+
+    ~format_error() throw() {}
+
+    const char* what() const throw() {
+        return (msg.c_str());
+    }
+};
+
 #endif
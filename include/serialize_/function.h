@@ -8,8 +8,18 @@
 #include <ostream>
 #include <limits>
 #include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
+#include "buffer.h"
 #include "data_type.h"
+#include "exception.h"
 
 namespace BTC {
 namespace serialize_ {
@@ -140,19 +150,93 @@ public:
         }
     }
 
+    // Bulk conversion of whole arrays.
+    // The swap is written with shifts on a contiguous block so that the
+    // compiler can vectorize the loop (it maps to bswap/pshufb).
+    void toLittleEndian(UINT8_T* vals, SIZE_T len) const {}
+
+    void toLittleEndian(UINT16_T* vals, SIZE_T len) const {
+        if (!littleEndian) {
+            swapBytes(vals,len);
+        }
+    }
+
+    void toLittleEndian(UINT32_T* vals, SIZE_T len) const {
+        if (!littleEndian) {
+            swapBytes(vals,len);
+        }
+    }
+
+    void toLittleEndian(UINT64_T* vals, SIZE_T len) const {
+        if (!littleEndian) {
+            swapBytes(vals,len);
+        }
+    }
+
+    void toHostEndian(UINT8_T* vals, SIZE_T len) const {}
+
+    void toHostEndian(UINT16_T* vals, SIZE_T len) const {
+        if (!littleEndian) {
+            swapBytes(vals,len);
+        }
+    }
+
+    void toHostEndian(UINT32_T* vals, SIZE_T len) const {
+        if (!littleEndian) {
+            swapBytes(vals,len);
+        }
+    }
+
+    void toHostEndian(UINT64_T* vals, SIZE_T len) const {
+        if (!littleEndian) {
+            swapBytes(vals,len);
+        }
+    }
+
+    static void swapBytes(UINT16_T* vals, SIZE_T len) {
+        for (SIZE_T i=0; i<len; ++i) {
+            UINT16_T v = vals[i];
+            vals[i] = UINT16_T((v >> 8) | (v << 8));
+        }
+    }
+
+    static void swapBytes(UINT32_T* vals, SIZE_T len) {
+        for (SIZE_T i=0; i<len; ++i) {
+            UINT32_T v = vals[i];
+            vals[i] = (v >> 24) | ((v >> 8) & 0x0000FF00u) |
+                      ((v << 8) & 0x00FF0000u) | (v << 24);
+        }
+    }
+
+    static void swapBytes(UINT64_T* vals, SIZE_T len) {
+        for (SIZE_T i=0; i<len; ++i) {
+            UINT64_T v = vals[i];
+            v = ((v >> 8) & UINT64_T(0x00FF00FF00FF00FF)) | ((v & UINT64_T(0x00FF00FF00FF00FF)) << 8);
+            v = ((v >> 16) & UINT64_T(0x0000FFFF0000FFFF)) | ((v & UINT64_T(0x0000FFFF0000FFFF)) << 16);
+            vals[i] = (v >> 32) | (v << 32);
+        }
+    }
+
 };
 
 static const ByteOrder byte_order;
 
+// All functions below are templates on the stream type.
+// A Sink needs write(const char*, n) and a Source read(char*, n), i.e. 
+// std::ostream and std::istream as well as BufferSink and BufferSource
+// from buffer.h can be used.
+
 /**
  * Serialize a single byte.
  * Requirement is that the number is castable to BTC::UINT8_T.
  */
-inline void serializeByte(std::ostream& o, UINT8_T b) {
+template<typename Sink>
+void serializeByte(Sink& o, UINT8_T b) {
     o.write(reinterpret_cast<const char*>(&b),1);
 }
 
-inline UINT8_T deserializeByte(std::istream& i) {
+template<typename Source>
+UINT8_T deserializeByte(Source& i) {
     UINT8_T data = 0;
     i.read(reinterpret_cast<char*>(&data),1);
     return(data);
@@ -164,12 +248,14 @@ inline UINT8_T deserializeByte(std::istream& i) {
  * modulo operations defined.
  */
 //template<typename UINT16_T>
-inline void serializeShort(std::ostream& o, UINT16_T s) {
+template<typename Sink>
+void serializeShort(Sink& o, UINT16_T s) {
     byte_order.toLittleEndian(s);
     o.write(reinterpret_cast<const char*>(&s),2);
 }
 
-inline UINT16_T deserializeShort(std::istream& i) {
+template<typename Source>
+UINT16_T deserializeShort(Source& i) {
     UINT16_T data;
     i.read(reinterpret_cast<char*>(&data),2);
     //data += (UINT16_T(deserializeByte(i)))*256u;
@@ -184,7 +270,8 @@ inline UINT16_T deserializeShort(std::istream& i) {
  * modulo operations defined.
  */
 //template<typename UINT32_T>
-inline void serializeInt(std::ostream& o, UINT32_T i) {
+template<typename Sink>
+void serializeInt(Sink& o, UINT32_T i) {
     byte_order.toLittleEndian(i);
     o.write(reinterpret_cast<const char*>(&i),4);
     //UINT16_T data = i/65536u;
@@ -193,7 +280,8 @@ inline void serializeInt(std::ostream& o, UINT32_T i) {
     //serializeShort(o,data);
 }
 
-inline UINT32_T deserializeInt(std::istream& i) {
+template<typename Source>
+UINT32_T deserializeInt(Source& i) {
     UINT32_T data;
     i.read(reinterpret_cast<char*>(&data),4);
     byte_order.toHostEndian(data);
@@ -208,7 +296,8 @@ inline UINT32_T deserializeInt(std::istream& i) {
  * modulo operations defined.
  */
 //template<typename UINT64_T>
-inline void serializeLong(std::ostream& o, UINT64_T i) {
+template<typename Sink>
+void serializeLong(Sink& o, UINT64_T i) {
     byte_order.toLittleEndian(i);
     o.write(reinterpret_cast<const char*>(&i),8);
     //UINT32_T data = i/4294967296u;
@@ -217,7 +306,8 @@ inline void serializeLong(std::ostream& o, UINT64_T i) {
     //serializeInt(o,data);
 }
 
-inline UINT64_T deserializeLong(std::istream& i) {
+template<typename Source>
+UINT64_T deserializeLong(Source& i) {
     UINT64_T data;
     i.read(reinterpret_cast<char*>(&data),8);
     byte_order.toHostEndian(data);
@@ -232,15 +322,15 @@ inline UINT64_T deserializeLong(std::istream& i) {
  * For this purpose an extra byte is stored in front of the number which tells 
  * of what type the representation is.
  */
-template<typename T>
-void serializeIntVar(std::ostream& o, const T& i) {
-    if(i <= 256u) {
+template<typename Sink, typename T>
+void serializeIntVar(Sink& o, const T& i) {
+    if(i < 256u) {
         serializeByte(o,0);
         serializeByte(o,i);
-    } else if((i > 256u) && (i <= 65536u)) {
+    } else if(i < 65536u) {
         serializeByte(o,1);
         serializeShort(o,i);
-    } else if((i > 65536u) && (i <= 4294967296u)) {
+    } else if(i < 4294967296u) {
         serializeByte(o,2);
         serializeInt(o,i);
     } else {
@@ -249,8 +339,8 @@ void serializeIntVar(std::ostream& o, const T& i) {
     }
 }
 
-template<typename T>
-T deserializeIntVar(std::istream& i) {
+template<typename T, typename Source>
+T deserializeIntVar(Source& i) {
     UINT8_T type = deserializeByte(i);
     if(type == 0) return(deserializeByte(i));
     else if(type == 1) return(deserializeShort(i));
@@ -263,11 +353,11 @@ T deserializeIntVar(std::istream& i) {
  */
 template<typename T>
 SIZE_T getIntVarByteSize(const T& val) {
-    if(val <= 256u) {
+    if(val < 256u) {
         return 2;
-    } else if((val > 256u) && (val <= 65536u)) {
+    } else if(val < 65536u) {
         return 3;
-    } else if((val > 65536u) && (val <= 4294967296u)) {
+    } else if(val < 4294967296u) {
         return 5;
     }
     return 9;
@@ -275,48 +365,55 @@ SIZE_T getIntVarByteSize(const T& val) {
 
 /**
  * Serialize a floating point number of size 4 byte.
- * The number is decomposed numerically and stored in a uint32_t variable
- * in the format |s|exp|mant| where s is 1 bit, exp is 8 bits and mant
- * 23 bits long.
- * It is then serialized as a uint32_t to get rid of byte order issues.
- */
-inline void serializeFloat(std::ostream& os, const FLOAT_T& val) {
-    UINT32_T data = 0;
-    int exp = 0;
-    FLOAT_T mant = std::frexp(val,&exp);
-    // Write sign
-    if (mant < 0) {
-        mant = -mant;
-        data += 2147483648u;  // Set bit 31: 2^31
-    }
-    exp += 127;
-    // Special cases
-    if (val == 0) {
-        mant = 0.5f;
-        exp = 255;
-    } else if(std::isinf(val)) {
-        // Handle inf case
-        mant = 0.75f;
-        exp = 255;
-    } else if(std::isnan(val)) {
-        // Handle quiet NaN case
-        mant = 0.875f;
-        exp = 255;
-    }
-    // Write exponent
-    data += (UINT32_T(exp))*8388608u;  // Set bits 23-30: 2^23
-    // Write mantissa
-    mant -= 0.5f;  // Subtract hidden bit
-    data += UINT32_T(mant*16777216.f);  // Set bits 0-22: (0 <= mant < 0.5)
+ * The IEEE-754 bit pattern of the number is copied into a uint32_t
+ * variable which is then serialized as such to get rid of byte order
+ * issues.
+ * This is bit-exact, i.e. signed zeros and NaN payloads survive.
+ * Written with DataTypeID::FLOAT.
+ */
+template<typename Sink>
+void serializeFloat(Sink& os, const FLOAT_T& val) {
+    UINT32_T data;
+    std::memcpy(&data,&val,4);
     serializeInt(os,data);
 }
 
 /**
  * Deserialize a floating point number of size 4 byte.
  */
-inline FLOAT_T deserializeFloat(std::istream& is) {
+template<typename Source>
+FLOAT_T deserializeFloat(Source& is) {
     UINT32_T data = deserializeInt(is);
-    FLOAT_T val = 0.5f;
+    FLOAT_T val;
+    std::memcpy(&val,&data,4);
+    return(val);
+}
+
+/**
+ * Decode a floating point number of size 4 byte from the layout written
+ * by earlier versions of this library (DataTypeID::FLOAT_LEGACY).
+ * There the number was decomposed with frexp and stored in the format 
+ * |s|exp|mant| where s is 1 bit, exp is 8 bits and mant 23 bits long.
+ * Zero, inf and NaN were stored with exp = 255 and the mantissa 
+ * 0.5, 0.75 and 0.875, respectively.
+ * As frexp normalizes the mantissa to [0.5,1) instead of [1,2), the layout 
+ * of a normal number only differs from IEEE-754 by an exponent that is 
+ * larger by one.
+ * These numbers are converted by a single subtraction, everything else is 
+ * decoded numerically exactly as before.
+ */
+inline FLOAT_T decodeFloatLegacy(UINT32_T data) {
+    FLOAT_T val;
+    UINT32_T exp_bits = (data >> 23) & 255u;
+    UINT32_T mant_bits = data & 8388607u;
+    if ((exp_bits-2u < 253u) || 
+        (exp_bits == 255u && mant_bits != 0u && 
+         mant_bits != 4194304u && mant_bits != 6291456u)) {
+        data -= 8388608u;  // Subtract one from the exponent: 2^23
+        std::memcpy(&val,&data,4);
+        return(val);
+    }
+    val = 0.5f;
     // Get sign
     bool s = data/2147483648u;
     data %= 2147483648u;
@@ -361,48 +458,55 @@ inline FLOAT_T deserializeFloat(std::istream& is) {
     return(val);
 }
 
+template<typename Source>
+FLOAT_T deserializeFloatLegacy(Source& is) {
+    return(decodeFloatLegacy(deserializeInt(is)));
+}
+
 /**
  * Serialize a floating point number of size 8 byte.
- * The number is decomposed numerically and stored in a uint64_t variable in a special format.
- * It is then serialized as a uint64_t to get rid of byte order issues.
- */
-inline void serializeDouble(std::ostream& os, const DOUBLE_T& val) {
-    UINT64_T data = 0;
-    int exp = 0;
-    DOUBLE_T mant = std::frexp(val,&exp);  // Split double into mant and exp: val = mant*2^exp
-    // Write sign
-    if (mant < 0) {
-        mant = -mant;
-        data += 9223372036854775808ul;  // Set bit 63: 2^63
-    }
-    exp += 1023;
-    // Special cases
-    if (val == 0) {
-        mant = 0.5;
-        exp = 2047;
-    } else if(std::isinf(val)) {
-        // Handle inf case
-        mant = 0.75;
-        exp = 2047;
-    } else if(std::isnan(val)) {
-        // Handle quiet NaN case
-        mant = 0.875;
-        exp = 2047;
-    }
-    // Write exponent
-    data += (UINT64_T(exp))*4503599627370496ul;  // Set bits 52-62: 2^52
-    // Write mantissa
-    mant -= 0.5;  // Subtract hidden bit
-    data += UINT64_T(mant*9007199254740992.);  // Set bits 0-51: (0 <= mant < 0.5)
+ * The IEEE-754 bit pattern of the number is copied into a uint64_t 
+ * variable which is then serialized as such to get rid of byte order
+ * issues.
+ * This is bit-exact, i.e. signed zeros and NaN payloads survive.
+ * Written with DataTypeID::DOUBLE.
+ */
+template<typename Sink>
+void serializeDouble(Sink& os, const DOUBLE_T& val) {
+    UINT64_T data;
+    std::memcpy(&data,&val,8);
     serializeLong(os,data);
 }
 
 /**
  * Deserialize a floating point number of size 8 byte.
  */
-inline DOUBLE_T deserializeDouble(std::istream& is) {
+template<typename Source>
+DOUBLE_T deserializeDouble(Source& is) {
     UINT64_T data = deserializeLong(is);
-    DOUBLE_T val = 0.5;
+    DOUBLE_T val;
+    std::memcpy(&val,&data,8);
+    return(val);
+}
+
+/**
+ * Decode a floating point number of size 8 byte from the layout written
+ * by earlier versions of this library (DataTypeID::DOUBLE_LEGACY).
+ * Same as decodeFloatLegacy with an 11 bit exponent and a 52 bit mantissa.
+ */
+inline DOUBLE_T decodeDoubleLegacy(UINT64_T data) {
+    DOUBLE_T val;
+    UINT64_T exp_bits = (data >> 52) & 2047u;
+    UINT64_T mant_bits = data & UINT64_T(4503599627370495);
+    if ((exp_bits-2u < 2045u) || 
+        (exp_bits == 2047u && mant_bits != 0u && 
+         mant_bits != UINT64_T(2251799813685248) && 
+         mant_bits != UINT64_T(3377699720527872))) {
+        data -= UINT64_T(4503599627370496);  // Subtract one from the exponent: 2^52
+        std::memcpy(&val,&data,8);
+        return(val);
+    }
+    val = 0.5;
     // Get sign
     bool s = data/9223372036854775808ul;
     data %= 9223372036854775808ul;
@@ -446,11 +550,17 @@ inline DOUBLE_T deserializeDouble(std::istream& is) {
     return(val);
 }
 
+template<typename Source>
+DOUBLE_T deserializeDoubleLegacy(Source& is) {
+    return(decodeDoubleLegacy(deserializeLong(is)));
+}
+
 /**
  * Serialize a string where the length is limited to 2^8 chars.
  * The length is stored in front of the string.
  */
-inline void serializeString8(std::ostream& o, const STRING_T& s) {
+template<typename Sink>
+void serializeString8(Sink& o, const STRING_T& s) {
 #ifdef DEBUG
     if(s.size() > 256u) {
         std::cout << "Error (serialize_::SerializeHelper::serializeString8): Not a short string!" << std::endl;
@@ -463,7 +573,8 @@ inline void serializeString8(std::ostream& o, const STRING_T& s) {
     }
 }
 
-inline STRING_T deserializeString8(std::istream& i) {
+template<typename Source>
+STRING_T deserializeString8(Source& i) {
     UINT8_T size = deserializeByte(i);
     if(size > 0) {
         STRING_T result(size,'a');
@@ -478,7 +589,8 @@ inline STRING_T deserializeString8(std::istream& i) {
  * Serialize a string where the length is limited to 2^16 chars.
  * The length is stored in front of the size.
  */
-inline void serializeString16(std::ostream& o, const STRING_T& s) {
+template<typename Sink>
+void serializeString16(Sink& o, const STRING_T& s) {
 #ifdef DEBUG
     if(s.size() > 65536u) {
         std::cout << "Error (serialize_::SerializeHelper::serializeString16): Not a short string!" << std::endl;
@@ -491,7 +603,8 @@ inline void serializeString16(std::ostream& o, const STRING_T& s) {
     }
 }
 
-inline STRING_T deserializeString16(std::istream& i) {
+template<typename Source>
+STRING_T deserializeString16(Source& i) {
     UINT16_T size = deserializeShort(i);
     if(size > 0) {
         STRING_T result(size,'a');
@@ -507,7 +620,8 @@ inline STRING_T deserializeString16(std::istream& i) {
  * Serialize a string where the length is limited to 2^32 chars.
  * The length is stored in front of the size.
  */
-inline void serializeString32(std::ostream& o, const STRING_T& s) {
+template<typename Sink>
+void serializeString32(Sink& o, const STRING_T& s) {
 #ifdef DEBUG
     if(s.size() > 4294967296ul) {
         std::cout << "Error (serialize_::SerializeHelper::serializeString32): Not a short string!" << std::endl;
@@ -520,7 +634,8 @@ inline void serializeString32(std::ostream& o, const STRING_T& s) {
     }
 }
 
-inline STRING_T deserializeString32(std::istream& i) {
+template<typename Source>
+STRING_T deserializeString32(Source& i) {
     UINT32_T size = deserializeInt(i);
     if(size > 0)
     {
@@ -537,14 +652,16 @@ inline STRING_T deserializeString32(std::istream& i) {
  * Serialize a string where the length is limited to 2^64 chars.
  * The length is stored in front of the size.
  */
-inline void serializeString64(std::ostream& o, const STRING_T& s) {
+template<typename Sink>
+void serializeString64(Sink& o, const STRING_T& s) {
     serializeLong(o,s.size());
     if(s.size() > 0) {
         o.write(s.data(),s.size());
     }
 }
 
-inline STRING_T deserializeString64(std::istream& i) {
+template<typename Source>
+STRING_T deserializeString64(Source& i) {
     UINT64_T size = deserializeLong(i);
     if(size > 0) {
         STRING_T result(size,'a');
@@ -560,14 +677,16 @@ inline STRING_T deserializeString64(std::istream& i) {
  * Serialize a string where the length is limited to maximall 2^64 chars.
  * The size of the number representing the length is variable.
  */
-inline void serializeString(std::ostream& o, const STRING_T& s) {
+template<typename Sink>
+void serializeString(Sink& o, const STRING_T& s) {
     serializeIntVar(o,s.size());
     if(s.size() > 0) {
         o.write(s.data(),s.size());
     }
 }
 
-inline STRING_T deserializeString(std::istream& i) {
+template<typename Source>
+STRING_T deserializeString(Source& i) {
     SIZE_T size = deserializeIntVar<SIZE_T>(i);
     if(size > 0) {
         STRING_T result(size,'a');
@@ -587,126 +706,1345 @@ inline SIZE_T getStringByteSize(const STRING_T& s) {
     return bytesize;
 }
 
+/**
+ * Number of elements that are converted at once when an array cannot be
+ * written to or read from the stream as it is in memory.
+ */
+static const SIZE_T ARRAY_BLOCK_SIZE = 512;
+
+/**
+ * Memory for a deserialized array of len numbers.
+ * Uses new[] unless the source is a BufferSource with an arena, see
+ * BufferSource::setArena(). Memory of an arena must not be deleted.
+ * If the elements take wire_size bytes each and follow in the source,
+ * a BufferSource on memory throws buffer_overflow_error before allocating
+ * when they cannot fit into the bytes left.
+ */
+template<typename T, typename Source>
+T* newArray(Source& is, SIZE_T len, SIZE_T wire_size = 0) {
+    return(new T[len]);
+}
+
 template<typename T>
-void serializeByteArray(std::ostream& o, const SIZE_T& len, const T* data) {
+T* newArray(BufferSource& is, SIZE_T len, SIZE_T wire_size = 0) {
+    if (is.current() && (wire_size > 0) && (len > is.remaining()/wire_size)) {
+        throw buffer_overflow_error("BTC::serialize_::newArray", 
+                (len > SIZE_T(-1)/wire_size) ? SIZE_T(-1) : len*wire_size, is.remaining());
+    }
+    if (is.getArena()) {
+        return(is.getArena()->template allocateArray<T>(len));
+    }
+    return(new T[len]);
+}
+
+// The memory of newArray() belongs to an arena.
+template<typename Source>
+bool newArrayIsPooled(Source& is) {
+    return false;
+}
+
+inline bool newArrayIsPooled(BufferSource& is) {
+    return(is.getArena() != 0);
+}
+
+/**
+ * Serialize an array of unsigned integers of type W (the wire type).
+ * If the host is little endian and T has the same size as W, the memory
+ * of the array is identical to the wire format and the whole array is
+ * written with a single call.
+ * Otherwise the elements are converted block-wise into a buffer which
+ * is byte-swapped in one go and then written.
+ * serializeWordArrayData() writes the elements without the length.
+ */
+template<typename W, typename Sink, typename T>
+void serializeWordArrayData(Sink& o, const SIZE_T& len, const T* data) {
+    if (std::numeric_limits<T>::is_integer && sizeof(T) == sizeof(W) && 
+            byte_order.isLittleEndian()) {
+        if(len > 0) {
+            o.write(reinterpret_cast<const char*>(data),len*sizeof(W));
+        }
+        return;
+    }
+    W buffer[ARRAY_BLOCK_SIZE];
+    for(SIZE_T i=0; i<len; i+=ARRAY_BLOCK_SIZE) {
+        SIZE_T n = std::min(ARRAY_BLOCK_SIZE,len-i);
+        for(SIZE_T j=0; j<n; ++j) {
+            buffer[j] = W(data[i+j]);
+        }
+        byte_order.toLittleEndian(buffer,n);
+        o.write(reinterpret_cast<const char*>(buffer),n*sizeof(W));
+    }
+}
+
+template<typename W, typename Sink, typename T>
+void serializeWordArray(Sink& o, const SIZE_T& len, const T* data) {
     serializeIntVar(o,len);
-    for(SIZE_T i=0; i<len; ++i) {
-        serializeByte(o,data[i]);
+    serializeWordArrayData<W>(o,len,data);
+}
+
+// Reads len elements into data (the length is not read).
+template<typename W, typename T, typename Source>
+void deserializeWordArrayData(Source& is, const SIZE_T& len, T* data) {
+    if (std::numeric_limits<T>::is_integer && sizeof(T) == sizeof(W) && 
+            byte_order.isLittleEndian()) {
+        if(len > 0) {
+            is.read(reinterpret_cast<char*>(data),len*sizeof(W));
+        }
+        return;
+    }
+    W buffer[ARRAY_BLOCK_SIZE];
+    for(SIZE_T i=0; i<len; i+=ARRAY_BLOCK_SIZE) {
+        SIZE_T n = std::min(ARRAY_BLOCK_SIZE,len-i);
+        is.read(reinterpret_cast<char*>(buffer),n*sizeof(W));
+        byte_order.toHostEndian(buffer,n);
+        for(SIZE_T j=0; j<n; ++j) {
+            data[i+j] = buffer[j];
+        }
     }
 }
 
-template<typename T>
-T* deserializeByteArray(std::istream& is, SIZE_T& len) {
+template<typename W, typename T, typename Source>
+T* deserializeWordArray(Source& is, SIZE_T& len) {
     len = deserializeIntVar<SIZE_T>(is);
-    T* data = new T[len];
-    for(SIZE_T i=0; i<len; ++i) {
-        data[i] = deserializeByte(is);
-    }
+    T* data = newArray<T>(is,len,sizeof(W));
+    deserializeWordArrayData<W>(is,len,data);
     return(data);
 }
 
-template<typename T>
-void serializeShortArray(std::ostream& o, const SIZE_T& len, const T* data) {
+template<typename Sink, typename T>
+void serializeByteArray(Sink& o, const SIZE_T& len, const T* data) {
+    serializeWordArray<UINT8_T>(o,len,data);
+}
+
+template<typename T, typename Source>
+T* deserializeByteArray(Source& is, SIZE_T& len) {
+    return(deserializeWordArray<UINT8_T,T>(is,len));
+}
+
+template<typename Sink, typename T>
+void serializeShortArray(Sink& o, const SIZE_T& len, const T* data) {
+    serializeWordArray<UINT16_T>(o,len,data);
+}
+
+template<typename T, typename Source>
+T* deserializeShortArray(Source& is, SIZE_T& len) {
+    return(deserializeWordArray<UINT16_T,T>(is,len));
+}
+
+template<typename Sink, typename T>
+void serializeIntArray(Sink& o, const SIZE_T& len, const T* data) {
+    serializeWordArray<UINT32_T>(o,len,data);
+}
+
+template<typename T, typename Source>
+T* deserializeIntArray(Source& is, SIZE_T& len) {
+    return(deserializeWordArray<UINT32_T,T>(is,len));
+}
+
+template<typename Sink, typename T>
+void serializeLongArray(Sink& o, const SIZE_T& len, const T* data) {
+    serializeWordArray<UINT64_T>(o,len,data);
+}
+
+template<typename T, typename Source>
+T* deserializeLongArray(Source& is, SIZE_T& len) {
+    return(deserializeWordArray<UINT64_T,T>(is,len));
+}
+
+/**
+ * Serialize an array of floating point numbers by their bit pattern.
+ * W is the unsigned integer type of the same size as F.
+ * On little-endian hosts the memory of the array is the wire format.
+ * serializeBitArrayData() writes the elements without the length.
+ */
+template<typename W, typename Sink, typename F>
+void serializeBitArrayData(Sink& o, const SIZE_T& len, const F* data) {
+    if (byte_order.isLittleEndian()) {
+        if(len > 0) {
+            o.write(reinterpret_cast<const char*>(data),len*sizeof(W));
+        }
+        return;
+    }
+    W buffer[ARRAY_BLOCK_SIZE];
+    for(SIZE_T i=0; i<len; i+=ARRAY_BLOCK_SIZE) {
+        SIZE_T n = std::min(ARRAY_BLOCK_SIZE,len-i);
+        std::memcpy(buffer,data+i,n*sizeof(W));
+        byte_order.toLittleEndian(buffer,n);
+        o.write(reinterpret_cast<const char*>(buffer),n*sizeof(W));
+    }
+}
+
+template<typename W, typename Sink, typename F>
+void serializeBitArray(Sink& o, const SIZE_T& len, const F* data) {
     serializeIntVar(o,len);
-    for(SIZE_T i=0; i<len; ++i) {
-        serializeShort(o,data[i]);
+    serializeBitArrayData<W>(o,len,data);
+}
+
+// Reads len elements into data (the length is not read).
+template<typename W, typename F, typename Source>
+void deserializeBitArrayData(Source& is, const SIZE_T& len, F* data) {
+    if (byte_order.isLittleEndian()) {
+        if(len > 0) {
+            is.read(reinterpret_cast<char*>(data),len*sizeof(W));
+        }
+        return;
+    }
+    W buffer[ARRAY_BLOCK_SIZE];
+    for(SIZE_T i=0; i<len; i+=ARRAY_BLOCK_SIZE) {
+        SIZE_T n = std::min(ARRAY_BLOCK_SIZE,len-i);
+        is.read(reinterpret_cast<char*>(buffer),n*sizeof(W));
+        byte_order.toHostEndian(buffer,n);
+        std::memcpy(data+i,buffer,n*sizeof(W));
     }
 }
 
-template<typename T>
-T* deserializeShortArray(std::istream& is, SIZE_T& len) {
+template<typename W, typename F, typename Source>
+F* deserializeBitArray(Source& is, SIZE_T& len) {
     len = deserializeIntVar<SIZE_T>(is);
-    T* data = new T[len];
-    for(SIZE_T i=0; i<len; ++i) {
-        data[i] = deserializeShort(is);
-    }
+    F* data = newArray<F>(is,len,sizeof(W));
+    deserializeBitArrayData<W>(is,len,data);
     return(data);
 }
 
-template<typename T>
-void serializeIntArray(std::ostream& o, const SIZE_T& len, const T* data) {
-    serializeIntVar(o,len);
-    for(SIZE_T i=0; i<len; ++i) {
-        serializeInt(o,data[i]);
+template<typename Sink>
+void serializeFloatArray(Sink& o, const SIZE_T& len, const FLOAT_T* data) {
+    serializeBitArray<UINT32_T>(o,len,data);
+}
+
+template<typename Source>
+FLOAT_T* deserializeFloatArray(Source& is, SIZE_T& len) {
+    return(deserializeBitArray<UINT32_T,FLOAT_T>(is,len));
+}
+
+template<typename Sink>
+void serializeDoubleArray(Sink& o, const SIZE_T& len, const DOUBLE_T* data) {
+    serializeBitArray<UINT64_T>(o,len,data);
+}
+
+template<typename Source>
+DOUBLE_T* deserializeDoubleArray(Source& is, SIZE_T& len) {
+    return(deserializeBitArray<UINT64_T,DOUBLE_T>(is,len));
+}
+
+/**
+ * Deserialize an array of floating point numbers in the legacy layout.
+ * Each block is first converted with the branch-free exponent correction
+ * that applies to normal numbers (a loop the compiler can vectorize).
+ * Only blocks that contain special values or denormals take the
+ * numerical decode for those elements.
+ */
+template<typename Source>
+FLOAT_T* deserializeFloatArrayLegacy(Source& is, SIZE_T& len) {
+    len = deserializeIntVar<SIZE_T>(is);
+    FLOAT_T* data = newArray<FLOAT_T>(is,len,sizeof(UINT32_T));
+    UINT32_T buffer[ARRAY_BLOCK_SIZE];
+    UINT32_T converted[ARRAY_BLOCK_SIZE];
+    for(SIZE_T i=0; i<len; i+=ARRAY_BLOCK_SIZE) {
+        SIZE_T n = std::min(ARRAY_BLOCK_SIZE,len-i);
+        is.read(reinterpret_cast<char*>(buffer),n*sizeof(UINT32_T));
+        byte_order.toHostEndian(buffer,n);
+        UINT32_T irregular = 0;
+        for(SIZE_T j=0; j<n; ++j) {
+            UINT32_T exp_bits = (buffer[j] >> 23) & 255u;
+            UINT32_T regular = (exp_bits-2u < 253u);
+            converted[j] = buffer[j] - regular*8388608u;
+            irregular |= regular^1u;
+        }
+        std::memcpy(data+i,converted,n*sizeof(UINT32_T));
+        if(irregular) {
+            for(SIZE_T j=0; j<n; ++j) {
+                if(((buffer[j] >> 23) & 255u)-2u >= 253u) {
+                    data[i+j] = decodeFloatLegacy(buffer[j]);
+                }
+            }
+        }
     }
+    return(data);
 }
 
-template<typename T>
-T* deserializeIntArray(std::istream& is, SIZE_T& len) {
+template<typename Source>
+DOUBLE_T* deserializeDoubleArrayLegacy(Source& is, SIZE_T& len) {
     len = deserializeIntVar<SIZE_T>(is);
-    T* data = new T[len];
-    for(SIZE_T i=0; i<len; ++i) {
-        data[i] = deserializeInt(is);
+    DOUBLE_T* data = newArray<DOUBLE_T>(is,len,sizeof(UINT64_T));
+    UINT64_T buffer[ARRAY_BLOCK_SIZE];
+    UINT64_T converted[ARRAY_BLOCK_SIZE];
+    for(SIZE_T i=0; i<len; i+=ARRAY_BLOCK_SIZE) {
+        SIZE_T n = std::min(ARRAY_BLOCK_SIZE,len-i);
+        is.read(reinterpret_cast<char*>(buffer),n*sizeof(UINT64_T));
+        byte_order.toHostEndian(buffer,n);
+        UINT64_T irregular = 0;
+        for(SIZE_T j=0; j<n; ++j) {
+            UINT64_T exp_bits = (buffer[j] >> 52) & 2047u;
+            UINT64_T regular = (exp_bits-2u < 2045u);
+            converted[j] = buffer[j] - regular*UINT64_T(4503599627370496);
+            irregular |= regular^1u;
+        }
+        std::memcpy(data+i,converted,n*sizeof(UINT64_T));
+        if(irregular) {
+            for(SIZE_T j=0; j<n; ++j) {
+                if(((buffer[j] >> 52) & 2047u)-2u >= 2045u) {
+                    data[i+j] = decodeDoubleLegacy(buffer[j]);
+                }
+            }
+        }
     }
     return(data);
 }
 
-template<typename T>
-void serializeLongArray(std::ostream& o, const SIZE_T& len, const T* data) {
+template<typename Sink>
+void serializeStringArray(Sink& o, const SIZE_T& len, const STRING_T* data) {
     serializeIntVar(o,len);
     for(SIZE_T i=0; i<len; ++i) {
-        serializeLong(o,data[i]);
+        serializeString(o,data[i]);
     }
 }
 
-template<typename T>
-T* deserializeLongArray(std::istream& is, SIZE_T& len) {
+template<typename Source>
+STRING_T* deserializeStringArray(Source& is, SIZE_T& len) {
     len = deserializeIntVar<SIZE_T>(is);
-    T* data = new T[len];
+    STRING_T* data = new STRING_T[len];
     for(SIZE_T i=0; i<len; ++i) {
-        data[i] = deserializeLong(is);
+        data[i] = deserializeString(is);
     }
     return(data);
 }
 
-inline void serializeFloatArray(std::ostream& o, const SIZE_T& len, const FLOAT_T* data) {
-    serializeIntVar(o,len);
+/**
+ * Varint arrays (see DataTypeID::DELTA_UINT32_ARR): the length, the byte
+ * size of the varints and the varints (7 bits per byte, least significant
+ * first, the high bit marks a following byte). W is the integer type of
+ * the array (UINT32_T or UINT64_T), the arithmetic wraps around in W.
+ */
+template<typename W>
+W zigzagEncode(W value) {
+    return(W(value << 1) ^ W(W(0)-(value >> (8*sizeof(W)-1))));
+}
+
+template<typename W>
+W zigzagDecode(W code) {
+    return(W(code >> 1) ^ W(W(0)-(code & 1u)));
+}
+
+template<typename W>
+SIZE_T getVarintByteSize(W code) {
+    SIZE_T bytesize = 1;
+    while(code >= 128u) {
+        code >>= 7;
+        ++bytesize;
+    }
+    return bytesize;
+}
+
+// Code of element i, prev is element i-1 (0 for the first one).
+template<typename W, typename T>
+W varintCode(const T* data, SIZE_T i, bool delta) {
+    W value = W(data[i]);
+    return(zigzagEncode<W>(delta ? W(value-(i > 0 ? W(data[i-1]) : W(0))) : value));
+}
+
+template<typename W, typename T>
+SIZE_T getVarintArrayDataByteSize(const SIZE_T& len, const T* data, bool delta) {
+    SIZE_T bytesize = 0;
     for(SIZE_T i=0; i<len; ++i) {
-        serializeFloat(o,data[i]);
+        bytesize += getVarintByteSize(varintCode<W>(data,i,delta));
+    }
+    return bytesize;
+}
+
+template<typename W, typename T>
+SIZE_T getVarintArrayByteSize(const SIZE_T& len, const T* data, bool delta) {
+    SIZE_T bytesize = getVarintArrayDataByteSize<W>(len,data,delta);
+    return(getIntVarByteSize(len) + getIntVarByteSize(bytesize) + bytesize);
+}
+
+// The codes are encoded block-wise into a buffer on the stack.
+template<typename W, typename Sink, typename T>
+void serializeVarintArray(Sink& o, const SIZE_T& len, const T* data, bool delta) {
+    serializeIntVar(o,len);
+    serializeIntVar(o,getVarintArrayDataByteSize<W>(len,data,delta));
+    char buffer[ARRAY_BLOCK_SIZE*(8*sizeof(W)+6)/7];
+    for(SIZE_T i=0; i<len; i+=ARRAY_BLOCK_SIZE) {
+        SIZE_T n = std::min(ARRAY_BLOCK_SIZE,len-i);
+        SIZE_T pos = 0;
+        for(SIZE_T j=0; j<n; ++j) {
+            W code = varintCode<W>(data,i+j,delta);
+            while(code >= 128u) {
+                buffer[pos++] = char((code & 127u) | 128u);
+                code >>= 7;
+            }
+            buffer[pos++] = char(code);
+        }
+        o.write(buffer,pos);
+    }
+}
+
+/**
+ * Vector kernels of the varint decoders (SSE2). decodeVarintRunSimd()
+ * decodes 16 one-byte or 8 two-byte varints at p into codes if the next
+ * 16 bytes hold exactly these and returns their number, 0 otherwise. 
+ * decodeVarintCodesSimd() undoes the zigzag and the prefix sum of the 
+ * first codes into out (W in host order) and returns their number, the
+ * scalar loops do the rest.
+ */
+template<typename W>
+SIZE_T decodeVarintRunSimd(const unsigned char* p, W* codes) {
+    return 0;
+}
+
+template<typename W>
+SIZE_T decodeVarintCodesSimd(const W* codes, SIZE_T n, bool delta, W prev, char* out) {
+    return 0;
+}
+
+#if defined(__SSE2__)
+// The codes of a run as 16 bit lanes (high only for one-byte varints).
+inline SIZE_T loadVarintRun(const unsigned char* p, __m128i& low, __m128i& high) {
+    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    const __m128i zero = _mm_setzero_si128();
+    int mask = _mm_movemask_epi8(bytes);
+    if(mask == 0) {
+        low = _mm_unpacklo_epi8(bytes,zero);
+        high = _mm_unpackhi_epi8(bytes,zero);
+        return 16;
+    }
+    if(mask == 0x5555) {
+        // each word is b0 | b1 << 8, the code (b0 & 127) | b1 << 7
+        low = _mm_or_si128(_mm_and_si128(bytes,_mm_set1_epi16(127)),
+                _mm_and_si128(_mm_srli_epi16(bytes,1),_mm_set1_epi16(0x7F80)));
+        return 8;
+    }
+    return 0;
+}
+
+template<>
+inline SIZE_T decodeVarintRunSimd<UINT32_T>(const unsigned char* p, UINT32_T* codes) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i low, high;
+    SIZE_T count = loadVarintRun(p,low,high);
+    __m128i* dst = reinterpret_cast<__m128i*>(codes);
+    if(count > 0) {
+        _mm_storeu_si128(dst,_mm_unpacklo_epi16(low,zero));
+        _mm_storeu_si128(dst+1,_mm_unpackhi_epi16(low,zero));
+    }
+    if(count == 16) {
+        _mm_storeu_si128(dst+2,_mm_unpacklo_epi16(high,zero));
+        _mm_storeu_si128(dst+3,_mm_unpackhi_epi16(high,zero));
+    }
+    return count;
+}
+
+// Widens 8 codes of 16 bits to 64 bits.
+inline void storeVarintCodes64(__m128i codes16, __m128i* dst) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i low = _mm_unpacklo_epi16(codes16,zero);
+    __m128i high = _mm_unpackhi_epi16(codes16,zero);
+    _mm_storeu_si128(dst,_mm_unpacklo_epi32(low,zero));
+    _mm_storeu_si128(dst+1,_mm_unpackhi_epi32(low,zero));
+    _mm_storeu_si128(dst+2,_mm_unpacklo_epi32(high,zero));
+    _mm_storeu_si128(dst+3,_mm_unpackhi_epi32(high,zero));
+}
+
+template<>
+inline SIZE_T decodeVarintRunSimd<UINT64_T>(const unsigned char* p, UINT64_T* codes) {
+    __m128i low, high;
+    SIZE_T count = loadVarintRun(p,low,high);
+    __m128i* dst = reinterpret_cast<__m128i*>(codes);
+    if(count > 0) {
+        storeVarintCodes64(low,dst);
     }
+    if(count == 16) {
+        storeVarintCodes64(high,dst+4);
+    }
+    return count;
 }
 
-inline FLOAT_T* deserializeFloatArray(std::istream& is, SIZE_T& len) {
+// The prefix sum adds the lanes shifted by one and two lanes and the 
+// sum of the previous vector.
+template<>
+inline SIZE_T decodeVarintCodesSimd<UINT32_T>(const UINT32_T* codes, SIZE_T n, bool delta, 
+        UINT32_T prev, char* out) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi32(1);
+    __m128i sum = _mm_set1_epi32(int(prev));
+    __m128i* dst = reinterpret_cast<__m128i*>(out);
+    SIZE_T i = 0;
+    for(; i+4 <= n; i+=4) {
+        __m128i code = _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes+i));
+        __m128i value = _mm_xor_si128(_mm_srli_epi32(code,1),_mm_sub_epi32(zero,_mm_and_si128(code,one)));
+        if(delta) {
+            value = _mm_add_epi32(value,_mm_slli_si128(value,4));
+            value = _mm_add_epi32(value,_mm_slli_si128(value,8));
+            value = _mm_add_epi32(value,sum);
+            sum = _mm_shuffle_epi32(value,0xFF);
+        }
+        _mm_storeu_si128(dst++,value);
+    }
+    return i;
+}
+
+template<>
+inline SIZE_T decodeVarintCodesSimd<UINT64_T>(const UINT64_T* codes, SIZE_T n, bool delta, 
+        UINT64_T prev, char* out) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set_epi32(0,1,0,1);
+    __m128i sum = _mm_set_epi32(int(prev >> 32),int(prev),int(prev >> 32),int(prev));
+    __m128i* dst = reinterpret_cast<__m128i*>(out);
+    SIZE_T i = 0;
+    for(; i+2 <= n; i+=2) {
+        __m128i code = _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes+i));
+        __m128i value = _mm_xor_si128(_mm_srli_epi64(code,1),_mm_sub_epi64(zero,_mm_and_si128(code,one)));
+        if(delta) {
+            value = _mm_add_epi64(value,_mm_slli_si128(value,8));
+            value = _mm_add_epi64(value,sum);
+            sum = _mm_unpackhi_epi64(value,value);
+        }
+        _mm_storeu_si128(dst++,value);
+    }
+    return i;
+}
+#endif
+
+/**
+ * Decodes n varints from [pos,end) into codes and advances pos.
+ * Runs of one or two byte varints are decoded 16 bytes at a time with 
+ * SSE2, without it runs of 8 one-byte varints (small deltas) are found
+ * with one 64 bit test and copied without the bit loop.
+ * Throws buffer_overflow_error if the data ends early and format_error
+ * if a varint is longer than W.
+ */
+template<typename W>
+void decodeVarints(const char*& pos, const char* end, SIZE_T n, W* codes) {
+    const UINT64_T HIGH_BITS = UINT64_T(0x8080808080808080);
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(pos);
+    const unsigned char* last = reinterpret_cast<const unsigned char*>(end);
+    SIZE_T k = 0;
+    while(k < n) {
+        // only tried while the varints are short
+        if((n-k >= 16) && (last-p >= 16) && ((k == 0) || (codes[k-1] < 16384u))) {
+            SIZE_T count = decodeVarintRunSimd<W>(p,codes+k);
+            if(count > 0) {
+                p += 16;
+                k += count;
+                continue;
+            }
+        }
+        if((n-k >= 8) && (last-p >= 8) && ((k == 0) || (codes[k-1] < 128u))) {
+            UINT64_T word;
+            std::memcpy(&word,p,8);
+            if((word & HIGH_BITS) == 0) {
+                for(SIZE_T j=0; j<8; ++j) {
+                    codes[k+j] = W(p[j]);
+                }
+                p += 8;
+                k += 8;
+                continue;
+            }
+        }
+        // one and two bytes without the loop
+        if((p != last) && (p[0] < 128u)) {
+            codes[k++] = W(p[0]);
+            p += 1;
+            continue;
+        }
+        if((last-p >= 2) && (p[1] < 128u)) {
+            codes[k++] = W(p[0] & 127u) | W(W(p[1]) << 7);
+            p += 2;
+            continue;
+        }
+        W code = 0;
+        for(unsigned shift=0; ; shift+=7) {
+            if(p == last) {
+                throw buffer_overflow_error("BTC::serialize_::decodeVarints", 1, 0);
+            }
+            if(shift >= 8*sizeof(W)) {
+                throw format_error("BTC::serialize_::decodeVarints", "Varint too long");
+            }
+            unsigned char byte = *p++;
+            code |= W(byte & 127u) << shift;
+            if(byte < 128u) {
+                break;
+            }
+        }
+        codes[k++] = code;
+    }
+    pos = reinterpret_cast<const char*>(p);
+}
+
+// Turns n codes into the elements, prev is the element before them 
+// (updated). data may be codes.
+template<typename W, typename T>
+void decodeVarintCodes(const W* codes, SIZE_T n, bool delta, W& prev, T* data) {
+    SIZE_T done = 0;
+    if(std::numeric_limits<T>::is_integer && (sizeof(T) == sizeof(W))) {
+        done = decodeVarintCodesSimd<W>(codes,n,delta,prev,reinterpret_cast<char*>(data));
+    }
+    if(!delta) {
+        for(SIZE_T j=done; j<n; ++j) {
+            data[j] = T(zigzagDecode<W>(codes[j]));
+        }
+        return;
+    }
+    // prefix sum in a local, prev may alias the data
+    W sum = (done > 0) ? W(data[done-1]) : prev;
+    for(SIZE_T j=done; j<n; ++j) {
+        sum += zigzagDecode<W>(codes[j]);
+        data[j] = T(sum);
+    }
+    prev = sum;
+}
+
+template<typename W, typename T>
+void decodeVarintArrayData(const char* pos, const char* end, SIZE_T len, bool delta, T* data) {
+    W codes[ARRAY_BLOCK_SIZE];
+    W prev = 0;
+    for(SIZE_T i=0; i<len; i+=ARRAY_BLOCK_SIZE) {
+        SIZE_T n = std::min(ARRAY_BLOCK_SIZE,len-i);
+        decodeVarints<W>(pos,end,n,codes);
+        decodeVarintCodes<W>(codes,n,delta,prev,data+i);
+    }
+}
+
+// Bytes of an encoded array (varint or bit-packed), read from a stream
+// into buffer.
+template<typename Source>
+const char* readPayloadBytes(Source& is, SIZE_T bytesize, std::vector<char>& buffer) {
+    buffer.resize(bytesize);
+    if(bytesize > 0) {
+        is.read(&buffer[0],bytesize);
+    }
+    return(bytesize > 0 ? &buffer[0] : 0);
+}
+
+// Read in place from memory.
+inline const char* readPayloadBytes(BufferSource& is, SIZE_T bytesize, std::vector<char>& buffer) {
+    if(!is.current()) {
+        buffer.resize(bytesize);
+        if(bytesize > 0) {
+            is.read(&buffer[0],bytesize);
+        }
+        return(bytesize > 0 ? &buffer[0] : 0);
+    }
+    const char* data = is.current();
+    is.skip(bytesize);
+    return data;
+}
+
+template<typename W, typename T, typename Source>
+T* deserializeVarintArray(Source& is, SIZE_T& len, bool delta) {
     len = deserializeIntVar<SIZE_T>(is);
-    FLOAT_T* data = new FLOAT_T[len];
-    for(SIZE_T i=0; i<len; ++i) {
-        data[i] = deserializeFloat(is);
+    SIZE_T bytesize = deserializeIntVar<SIZE_T>(is);
+    if(len > bytesize) {
+        throw buffer_overflow_error("BTC::serialize_::deserializeVarintArray", len, bytesize);
+    }
+    std::vector<char> buffer;
+    const char* bytes = readPayloadBytes(is,bytesize,buffer);
+    T* data = newArray<T>(is,len);
+    try {
+        decodeVarintArrayData<W>(bytes,bytes+bytesize,len,delta,data);
+    } catch(...) {
+        if(!newArrayIsPooled(is)) {
+            delete[] data;
+        }
+        throw;
     }
     return(data);
 }
 
-inline void serializeDoubleArray(std::ostream& o, const SIZE_T& len, const DOUBLE_T* data) {
+/**
+ * Bit-packed arrays (see DataTypeID::BITPACK_UINT32_ARR): the length, the
+ * byte size of the blocks and the blocks of BITPACK_BLOCK_SIZE elements
+ * (the last one may be shorter). A block is the smallest element (W,
+ * little endian), the bit width b (one byte) and the elements minus the
+ * smallest one with b bits each (little endian bit order, padded to a 
+ * full byte). W is UINT32_T or UINT64_T.
+ */
+static const SIZE_T BITPACK_BLOCK_SIZE = 128;
+
+template<typename W>
+unsigned getBitWidth(W value) {
+    unsigned bits = 0;
+    while(value != 0) {
+        value >>= 1;
+        ++bits;
+    }
+    return bits;
+}
+
+// Smallest element and bit width of n elements.
+template<typename W, typename T>
+void getBitPackedFrame(const T* data, SIZE_T n, W& base, unsigned& bits) {
+    W low = W(data[0]);
+    W high = low;
+    for(SIZE_T i=1; i<n; ++i) {
+        W value = W(data[i]);
+        low = std::min(low,value);
+        high = std::max(high,value);
+    }
+    base = low;
+    bits = getBitWidth<W>(W(high-low));
+}
+
+inline SIZE_T getBitPackedBlockByteSize(SIZE_T n, unsigned bits, SIZE_T word_size) {
+    return(word_size + 1 + (n*bits+7)/8);
+}
+
+template<typename W, typename T>
+SIZE_T getBitPackedArrayDataByteSize(const SIZE_T& len, const T* data) {
+    SIZE_T bytesize = 0;
+    for(SIZE_T i=0; i<len; i+=BITPACK_BLOCK_SIZE) {
+        SIZE_T n = std::min(BITPACK_BLOCK_SIZE,len-i);
+        W base;
+        unsigned bits;
+        getBitPackedFrame<W>(data+i,n,base,bits);
+        bytesize += getBitPackedBlockByteSize(n,bits,sizeof(W));
+    }
+    return bytesize;
+}
+
+template<typename W, typename T>
+SIZE_T getBitPackedArrayByteSize(const SIZE_T& len, const T* data) {
+    SIZE_T bytesize = getBitPackedArrayDataByteSize<W>(len,data);
+    return(getIntVarByteSize(len) + getIntVarByteSize(bytesize) + bytesize);
+}
+
+// Packs one block into buffer, returns the number of bytes.
+// Elements of more than 32 bits are packed in two parts.
+template<typename W, typename T>
+SIZE_T packBlock(const T* data, SIZE_T n, char* buffer) {
+    W base;
+    unsigned bits;
+    getBitPackedFrame<W>(data,n,base,bits);
+    BufferSink header(buffer,sizeof(W)+1);
+    if(sizeof(W) == 8) {
+        serializeLong(header,UINT64_T(base));
+    } else {
+        serializeInt(header,UINT32_T(base));
+    }
+    serializeByte(header,UINT8_T(bits));
+    unsigned char* out = reinterpret_cast<unsigned char*>(buffer+sizeof(W)+1);
+    UINT64_T acc = 0;
+    unsigned filled = 0;
+    for(SIZE_T i=0; i<n; ++i) {
+        W value = W(W(data[i])-base);
+        for(unsigned done=0; done<bits; done+=32) {
+            unsigned part = std::min(bits-done,32u);
+            acc |= (UINT64_T(value >> done) & ((UINT64_T(1) << part)-1)) << filled;
+            filled += part;
+            while(filled >= 8) {
+                *out++ = static_cast<unsigned char>(acc);
+                acc >>= 8;
+                filled -= 8;
+            }
+        }
+    }
+    if(filled > 0) {
+        *out++ = static_cast<unsigned char>(acc);
+    }
+    return(reinterpret_cast<char*>(out)-buffer);
+}
+
+template<typename W, typename Sink, typename T>
+void serializeBitPackedArray(Sink& o, const SIZE_T& len, const T* data) {
     serializeIntVar(o,len);
-    for(SIZE_T i=0; i<len; ++i) {
-        serializeDouble(o,data[i]);
+    serializeIntVar(o,getBitPackedArrayDataByteSize<W>(len,data));
+    char buffer[sizeof(W)+1+BITPACK_BLOCK_SIZE*sizeof(W)];
+    for(SIZE_T i=0; i<len; i+=BITPACK_BLOCK_SIZE) {
+        SIZE_T n = std::min(BITPACK_BLOCK_SIZE,len-i);
+        o.write(buffer,packBlock<W>(data+i,n,buffer));
+    }
+}
+
+/**
+ * Vector kernels of unpackBlock(): unpack the first elements of a block
+ * (packed holds available bytes up to the end of the data) into out as
+ * little endian W with the base added and return their number, the
+ * scalar loops do the rest. With SSE2 the byte aligned widths 8, 16 and
+ * 32 of UINT32_T are only widened. AVX2 gathers the word of every other
+ * element and shifts each lane by its own bit offset (widths up to 25 
+ * bits for UINT32_T, 56 bits for UINT64_T).
+ */
+template<typename W>
+SIZE_T unpackBlockSimd(const unsigned char* packed, SIZE_T available, SIZE_T n, 
+        unsigned bits, W base, char* out) {
+    return 0;
+}
+
+#if defined(__SSE2__)
+inline SIZE_T unpackAlignedSimd(const unsigned char* packed, SIZE_T n, 
+        unsigned bits, UINT32_T base, char* out) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i offset = _mm_set1_epi32(int(base));
+    __m128i* dst = reinterpret_cast<__m128i*>(out);
+    const __m128i* src = reinterpret_cast<const __m128i*>(packed);
+    SIZE_T i = 0;
+    if(bits == 8) {
+        for(; i+16 <= n; i+=16) {
+            __m128i bytes = _mm_loadu_si128(src++);
+            __m128i low = _mm_unpacklo_epi8(bytes,zero);
+            __m128i high = _mm_unpackhi_epi8(bytes,zero);
+            _mm_storeu_si128(dst++,_mm_add_epi32(_mm_unpacklo_epi16(low,zero),offset));
+            _mm_storeu_si128(dst++,_mm_add_epi32(_mm_unpackhi_epi16(low,zero),offset));
+            _mm_storeu_si128(dst++,_mm_add_epi32(_mm_unpacklo_epi16(high,zero),offset));
+            _mm_storeu_si128(dst++,_mm_add_epi32(_mm_unpackhi_epi16(high,zero),offset));
+        }
+    } else if(bits == 16) {
+        for(; i+8 <= n; i+=8) {
+            __m128i words = _mm_loadu_si128(src++);
+            _mm_storeu_si128(dst++,_mm_add_epi32(_mm_unpacklo_epi16(words,zero),offset));
+            _mm_storeu_si128(dst++,_mm_add_epi32(_mm_unpackhi_epi16(words,zero),offset));
+        }
+    } else if(bits == 32) {
+        for(; i+4 <= n; i+=4) {
+            _mm_storeu_si128(dst++,_mm_add_epi32(_mm_loadu_si128(src++),offset));
+        }
     }
+    return i;
 }
 
-inline DOUBLE_T* deserializeDoubleArray(std::istream& is, SIZE_T& len) {
+template<>
+inline SIZE_T unpackBlockSimd<UINT32_T>(const unsigned char* packed, SIZE_T available, SIZE_T n, 
+        unsigned bits, UINT32_T base, char* out) {
+    if(bits == 8 || bits == 16 || bits == 32) {
+        return unpackAlignedSimd(packed,n,bits,base,out);
+    }
+#if defined(__AVX2__)
+    if(bits == 0 || bits > 25) {
+        return 0;
+    }
+    const __m256i mask = _mm256_set1_epi32(int((1u << bits)-1));
+    const __m256i offset = _mm256_set1_epi32(int(base));
+    const __m256i step = _mm256_set1_epi32(int(8*bits));
+    const __m256i seven = _mm256_set1_epi32(7);
+    __m256i bit = _mm256_mullo_epi32(_mm256_setr_epi32(0,1,2,3,4,5,6,7),_mm256_set1_epi32(int(bits)));
+    SIZE_T i = 0;
+    // the 4 bytes of the last element of a group lie within the data
+    for(; (i+8 <= n) && (((i+7)*bits)/8+4 <= available); i+=8) {
+        __m256i word = _mm256_i32gather_epi32(reinterpret_cast<const int*>(packed),
+                _mm256_srli_epi32(bit,3),1);
+        word = _mm256_and_si256(_mm256_srlv_epi32(word,_mm256_and_si256(bit,seven)),mask);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out+4*i),_mm256_add_epi32(word,offset));
+        bit = _mm256_add_epi32(bit,step);
+    }
+    return i;
+#else
+    return 0;
+#endif
+}
+#endif
+
+#if defined(__AVX2__)
+// Element type of the 64 bit gather (long long is an extension in C++98).
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wlong-long"
+typedef long long GatherWord;
+#pragma GCC diagnostic pop
+
+template<>
+inline SIZE_T unpackBlockSimd<UINT64_T>(const unsigned char* packed, SIZE_T available, SIZE_T n, 
+        unsigned bits, UINT64_T base, char* out) {
+    if(bits == 0 || bits > 56) {
+        return 0;
+    }
+    const __m256i mask = _mm256_set1_epi64x(~UINT64_T(0) >> (64-bits));
+    const __m256i offset = _mm256_set1_epi64x(base);
+    const __m128i step = _mm_set1_epi32(int(4*bits));
+    const __m128i seven = _mm_set1_epi32(7);
+    __m128i bit = _mm_setr_epi32(0,int(bits),int(2*bits),int(3*bits));
+    SIZE_T i = 0;
+    for(; (i+4 <= n) && (((i+3)*bits)/8+8 <= available); i+=4) {
+        __m256i word = _mm256_i32gather_epi64(reinterpret_cast<const GatherWord*>(packed),
+                _mm_srli_epi32(bit,3),1);
+        __m256i shift = _mm256_cvtepu32_epi64(_mm_and_si128(bit,seven));
+        word = _mm256_and_si256(_mm256_srlv_epi64(word,shift),mask);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out+8*i),_mm256_add_epi64(word,offset));
+        bit = _mm_add_epi32(bit,step);
+    }
+    return i;
+}
+#endif
+
+/**
+ * Unpacks one block of n elements from [pos,end) into data and advances
+ * pos. Element i is read with one unaligned 64 bit load at bit i*b, so
+ * the loop has no branches. Widths above 56 bits and the elements at the
+ * end of the data (where 8 bytes cannot be loaded) are read byte by byte.
+ * Integer elements of the size of W first go through unpackBlockSimd().
+ * Throws buffer_overflow_error if the data ends early and format_error
+ * if the width is larger than W.
+ */
+template<typename W, typename T>
+void unpackBlock(const char*& pos, const char* end, SIZE_T n, T* data) {
+    if(SIZE_T(end-pos) < sizeof(W)+1) {
+        throw buffer_overflow_error("BTC::serialize_::unpackBlock", sizeof(W)+1, end-pos);
+    }
+    BufferSource header(pos,sizeof(W)+1);
+    W base = (sizeof(W) == 8) ? W(deserializeLong(header)) : W(deserializeInt(header));
+    unsigned bits = deserializeByte(header);
+    if(bits > 8*sizeof(W)) {
+        throw format_error("BTC::serialize_::unpackBlock", "Bit width too large");
+    }
+    const unsigned char* packed = reinterpret_cast<const unsigned char*>(pos+sizeof(W)+1);
+    SIZE_T bytesize = (n*bits+7)/8;
+    if(bytesize > SIZE_T(end-pos)-sizeof(W)-1) {
+        throw buffer_overflow_error("BTC::serialize_::unpackBlock", bytesize, end-pos-sizeof(W)-1);
+    }
+    pos += sizeof(W)+1+bytesize;
+    SIZE_T available = reinterpret_cast<const unsigned char*>(end)-packed;
+    SIZE_T done = 0;
+    if(std::numeric_limits<T>::is_integer && (sizeof(T) == sizeof(W)) && 
+            byte_order.isLittleEndian()) {
+        done = unpackBlockSimd<W>(packed,available,n,bits,base,reinterpret_cast<char*>(data));
+    }
+    SIZE_T fast = 0;
+    if(bits <= 56 && available >= 8) {
+        // elements whose 8 bytes lie within the data
+        fast = std::min(n,((available-8)*8)/std::max(bits,1u)+1);
+        if(bits == 0) {
+            fast = n;
+        }
+        const UINT64_T mask = (bits == 0) ? 0 : (~UINT64_T(0) >> (64-bits));
+        if(byte_order.isLittleEndian()) {
+            for(SIZE_T i=done; i<fast; ++i) {
+                SIZE_T bit = i*bits;
+                UINT64_T word;
+                std::memcpy(&word,packed+bit/8,8);
+                data[i] = T(W(base + W((word >> (bit%8)) & mask)));
+            }
+        } else {
+            for(SIZE_T i=done; i<fast; ++i) {
+                SIZE_T bit = i*bits;
+                UINT64_T word;
+                std::memcpy(&word,packed+bit/8,8);
+                byte_order.toHostEndian(&word,1);
+                data[i] = T(W(base + W((word >> (bit%8)) & mask)));
+            }
+        }
+    }
+    for(SIZE_T i=std::max(fast,done); i<n; ++i) {
+        W value = 0;
+        for(unsigned k=0; k<bits; ) {
+            SIZE_T bit = i*bits+k;
+            unsigned part = std::min(8-unsigned(bit%8),bits-k);
+            value |= W(W((packed[bit/8] >> (bit%8)) & ((1u << part)-1)) << k);
+            k += part;
+        }
+        data[i] = T(W(base+value));
+    }
+}
+
+template<typename W, typename T>
+void unpackBitPackedArrayData(const char* pos, const char* end, SIZE_T len, T* data) {
+    for(SIZE_T i=0; i<len; i+=BITPACK_BLOCK_SIZE) {
+        unpackBlock<W>(pos,end,std::min(BITPACK_BLOCK_SIZE,len-i),data+i);
+    }
+}
+
+template<typename W, typename T, typename Source>
+T* deserializeBitPackedArray(Source& is, SIZE_T& len) {
     len = deserializeIntVar<SIZE_T>(is);
-    DOUBLE_T* data = new DOUBLE_T[len];
-    for(SIZE_T i=0; i<len; ++i) {
-        data[i] = deserializeDouble(is);
+    SIZE_T bytesize = deserializeIntVar<SIZE_T>(is);
+    // every block has at least its header
+    if((len+BITPACK_BLOCK_SIZE-1)/BITPACK_BLOCK_SIZE > bytesize/(sizeof(W)+1)) {
+        throw buffer_overflow_error("BTC::serialize_::deserializeBitPackedArray", len, bytesize);
+    }
+    std::vector<char> buffer;
+    const char* bytes = readPayloadBytes(is,bytesize,buffer);
+    T* data = newArray<T>(is,len);
+    try {
+        unpackBitPackedArrayData<W>(bytes,bytes+bytesize,len,data);
+    } catch(...) {
+        if(!newArrayIsPooled(is)) {
+            delete[] data;
+        }
+        throw;
     }
     return(data);
 }
 
-inline void serializeStringArray(std::ostream& o, const SIZE_T& len, const STRING_T* data) {
+/**
+ * XOR arrays (see DataTypeID::XOR_DOUBLE_ARR): the length, the byte size
+ * of the bit stream and the bit stream (least significant bit first).
+ * The first element is stored with all bits, every other one by the XOR
+ * with its predecessor: 0 if it is zero, otherwise 1 and either 0 and the
+ * meaningful bits if they lie within the window of the last XOR written
+ * in full, or 1, the number of leading zeros (5 bits), the number of 
+ * meaningful bits minus one (5 bits for floats, 6 for doubles) and the
+ * meaningful bits. The bit patterns are compared, so this is lossless.
+ */
+
+// Unsigned integer type with the bits of a float type.
+template<typename F> struct BitType {};
+template<> struct BitType<FLOAT_T> { typedef UINT32_T type; };
+template<> struct BitType<DOUBLE_T> { typedef UINT64_T type; };
+
+// Zero bits above the highest and below the lowest set bit of a nonzero
+// value (binary search).
+template<typename W>
+unsigned countLeadingZeros(W value) {
+    unsigned count = 0;
+    for(unsigned shift=4*sizeof(W); shift>0; shift/=2) {
+        if((value >> (8*sizeof(W)-shift)) == 0) {
+            value = W(value << shift);
+            count += shift;
+        }
+    }
+    return count;
+}
+
+template<typename W>
+unsigned countTrailingZeros(W value) {
+    unsigned count = 0;
+    for(unsigned shift=4*sizeof(W); shift>0; shift/=2) {
+        if(W(value << (8*sizeof(W)-shift)) == 0) {
+            value = W(value >> shift);
+            count += shift;
+        }
+    }
+    return count;
+}
+
+/**
+ * Encodes the elements of an XOR array one by one (so an array can be
+ * written in parts, see BTagWriter). The bytes are collected in a small
+ * buffer and written to the sink when it is full and by finish().
+ */
+template<typename F>
+class XorEncoder {
+
+    typedef typename BitType<F>::type W;
+    static const unsigned BITS = 8*sizeof(W);
+    static const unsigned LENGTH_BITS = (sizeof(W) == 8) ? 6 : 5;
+
+    W prev;
+    unsigned lead;
+    unsigned trail;
+    bool first;
+    UINT64_T acc;
+    unsigned filled;
+    char buffer[256];
+    SIZE_T pos;
+    UINT64_T bytes;
+
+    // n <= 32
+    template<typename Sink>
+    void put(Sink& o, UINT64_T value, unsigned n) {
+        acc |= (value & ((UINT64_T(1) << n)-1)) << filled;
+        filled += n;
+        while(filled >= 8) {
+            buffer[pos++] = char(acc & 255u);
+            acc >>= 8;
+            filled -= 8;
+            if(pos == sizeof(buffer)) {
+                o.write(buffer,pos);
+                bytes += pos;
+                pos = 0;
+            }
+        }
+    }
+
+    template<typename Sink>
+    void putWord(Sink& o, W value, unsigned n) {
+        if(n > 32) {
+            put(o,UINT64_T(value),32);
+            put(o,UINT64_T(value) >> 32,n-32);
+        } else {
+            put(o,UINT64_T(value),n);
+        }
+    }
+
+  public:
+    XorEncoder() {
+        reset();
+    }
+
+    // Starts a new array.
+    void reset() {
+        prev = 0;
+        lead = BITS;
+        trail = 0;
+        first = true;
+        acc = 0;
+        filled = 0;
+        pos = 0;
+        bytes = 0;
+    }
+
+    template<typename Sink>
+    void encode(Sink& o, const F& value) {
+        W bits;
+        std::memcpy(&bits,&value,sizeof(W));
+        W x = W(bits ^ prev);
+        prev = bits;
+        if(first) {
+            first = false;
+            putWord(o,bits,BITS);
+            return;
+        }
+        if(x == 0) {
+            put(o,0,1);
+            return;
+        }
+        unsigned l = std::min(countLeadingZeros<W>(x),31u);
+        unsigned t = countTrailingZeros<W>(x);
+        if(l >= lead && t >= trail) {
+            put(o,1,2);
+            putWord(o,W(x >> trail),BITS-lead-trail);
+            return;
+        }
+        lead = l;
+        trail = t;
+        put(o,3,2);
+        put(o,lead,5);
+        put(o,BITS-lead-trail-1,LENGTH_BITS);
+        putWord(o,W(x >> trail),BITS-lead-trail);
+    }
+
+    // Writes the last bits (padded to a full byte).
+    template<typename Sink>
+    void finish(Sink& o) {
+        if(filled > 0) {
+            put(o,0,8-filled);
+        }
+        if(pos > 0) {
+            o.write(buffer,pos);
+            bytes += pos;
+            pos = 0;
+        }
+    }
+
+    // Bytes written by finish() so far.
+    UINT64_T getByteCount() const {
+        return bytes;
+    }
+};
+
+// Sink that only counts (see getXorArrayDataByteSize()).
+class DiscardSink {
+  public:
+    void write(const char* data, SIZE_T n) {}
+};
+
+template<typename F>
+SIZE_T getXorArrayDataByteSize(const SIZE_T& len, const F* data) {
+    DiscardSink sink;
+    XorEncoder<F> encoder;
+    for(SIZE_T i=0; i<len; ++i) {
+        encoder.encode(sink,data[i]);
+    }
+    encoder.finish(sink);
+    return SIZE_T(encoder.getByteCount());
+}
+
+template<typename F>
+SIZE_T getXorArrayByteSize(const SIZE_T& len, const F* data) {
+    SIZE_T bytesize = getXorArrayDataByteSize(len,data);
+    return(getIntVarByteSize(len) + getIntVarByteSize(bytesize) + bytesize);
+}
+
+template<typename Sink, typename F>
+void serializeXorArray(Sink& o, const SIZE_T& len, const F* data) {
     serializeIntVar(o,len);
+    serializeIntVar(o,getXorArrayDataByteSize(len,data));
+    XorEncoder<F> encoder;
     for(SIZE_T i=0; i<len; ++i) {
-        serializeString(o,data[i]);
+        encoder.encode(o,data[i]);
     }
+    encoder.finish(o);
 }
 
-inline STRING_T* deserializeStringArray(std::istream& is, SIZE_T& len) {
+/**
+ * Decodes the elements of an XOR array from [data,data+size) one by one.
+ * The bits are taken from a 64 bit buffer that is refilled 4 bytes at a
+ * time.
+ * Throws buffer_overflow_error if the data ends early and format_error
+ * if the bits do not form a valid element.
+ */
+template<typename F>
+class XorDecoder {
+
+    typedef typename BitType<F>::type W;
+    static const unsigned BITS = 8*sizeof(W);
+    static const unsigned LENGTH_BITS = (sizeof(W) == 8) ? 6 : 5;
+
+    const unsigned char* pos;
+    const unsigned char* end;
+    UINT64_T acc;
+    unsigned avail;
+    W prev;
+    unsigned lead;
+    unsigned trail;
+    bool first;
+
+    // n <= 32
+    UINT64_T get(unsigned n) {
+        while(avail < n) {
+            if(end-pos >= 4) {
+                UINT32_T word;
+                std::memcpy(&word,pos,4);
+                byte_order.toHostEndian(&word,1);
+                acc |= UINT64_T(word) << avail;
+                avail += 32;
+                pos += 4;
+            } else if(pos != end) {
+                acc |= UINT64_T(*pos++) << avail;
+                avail += 8;
+            } else {
+                throw buffer_overflow_error("BTC::serialize_::XorDecoder::next", 1, 0);
+            }
+        }
+        UINT64_T value = acc & ((UINT64_T(1) << n)-1);
+        acc >>= n;
+        avail -= n;
+        return value;
+    }
+
+    W getWord(unsigned n) {
+        if(n > 32) {
+            UINT64_T low = get(32);
+            return W(low | (get(n-32) << 32));
+        }
+        return W(get(n));
+    }
+
+  public:
+    XorDecoder(const char* data, SIZE_T size)
+            : pos(reinterpret_cast<const unsigned char*>(data)), 
+              end(reinterpret_cast<const unsigned char*>(data)+size),
+              acc(0), avail(0), prev(0), lead(BITS), trail(0), first(true) {
+    }
+
+    F next() {
+        if(first) {
+            first = false;
+            prev = getWord(BITS);
+        } else if(get(1) != 0) {
+            if(get(1) != 0) {
+                lead = unsigned(get(5));
+                unsigned meaningful = unsigned(get(LENGTH_BITS))+1;
+                if(lead+meaningful > BITS) {
+                    throw format_error("BTC::serialize_::XorDecoder::next", "Invalid XOR window");
+                }
+                trail = BITS-lead-meaningful;
+            } else if(lead == BITS) {
+                throw format_error("BTC::serialize_::XorDecoder::next", "No XOR window");
+            }
+            prev ^= W(getWord(BITS-lead-trail) << trail);
+        }
+        F value;
+        std::memcpy(&value,&prev,sizeof(W));
+        return value;
+    }
+};
+
+template<typename F, typename Source>
+F* deserializeXorArray(Source& is, SIZE_T& len) {
     len = deserializeIntVar<SIZE_T>(is);
-    STRING_T* data = new STRING_T[len];
-    for(SIZE_T i=0; i<len; ++i) {
-        data[i] = deserializeString(is);
+    SIZE_T bytesize = deserializeIntVar<SIZE_T>(is);
+    // at least one bit per element
+    if(len > 8*bytesize) {
+        throw buffer_overflow_error("BTC::serialize_::deserializeXorArray", len, 8*bytesize);
+    }
+    std::vector<char> buffer;
+    const char* bytes = readPayloadBytes(is,bytesize,buffer);
+    F* data = newArray<F>(is,len);
+    try {
+        XorDecoder<F> decoder(bytes,bytesize);
+        for(SIZE_T i=0; i<len; ++i) {
+            data[i] = decoder.next();
+        }
+    } catch(...) {
+        if(!newArrayIsPooled(is)) {
+            delete[] data;
+        }
+        throw;
     }
     return(data);
 }
 
+/**
+ * Size in bytes of a number type or of one element of a number array type.
+ * 0 for all other types.
+ */
+inline SIZE_T getElementByteSize(UINT8_T type_id) {
+    switch(type_id) {
+        case DataTypeID::UINT8:
+        case DataTypeID::UINT8_ARR:
+        case DataTypeID::CHUNKED_UINT8_ARR:
+            return 1;
+        case DataTypeID::UINT16:
+        case DataTypeID::UINT16_ARR:
+        case DataTypeID::CHUNKED_UINT16_ARR:
+            return 2;
+        case DataTypeID::UINT32:
+        case DataTypeID::UINT32_ARR:
+        case DataTypeID::CHUNKED_UINT32_ARR:
+        case DataTypeID::FLOAT:
+        case DataTypeID::FLOAT_ARR:
+        case DataTypeID::CHUNKED_FLOAT_ARR:
+        case DataTypeID::FLOAT_LEGACY:
+        case DataTypeID::FLOAT_ARR_LEGACY:
+            return 4;
+        case DataTypeID::UINT64:
+        case DataTypeID::UINT64_ARR:
+        case DataTypeID::CHUNKED_UINT64_ARR:
+        case DataTypeID::DOUBLE:
+        case DataTypeID::DOUBLE_ARR:
+        case DataTypeID::CHUNKED_DOUBLE_ARR:
+        case DataTypeID::DOUBLE_LEGACY:
+        case DataTypeID::DOUBLE_ARR_LEGACY:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Skip the payload of a tag of the given type, i.e. everything behind
+ * the type ID. Types with a byte size (see hasByteSize()) are skipped at
+ * once, legacy compounds and string arrays element by element.
+ * Source needs a skip(n) method (see BufferSource).
+ * Throws unknown_type_error for an unknown type.
+ */
+template<typename Source>
+void skipTagPayload(Source& is, UINT8_T type_id) {
+    if(hasByteSize(type_id)) {
+        is.skip(deserializeIntVar<SIZE_T>(is));
+    } else if(isValue(type_id) && (type_id != DataTypeID::STRING)) {
+        SIZE_T size = getElementByteSize(type_id);
+        if(size == 0) {
+            throw unknown_type_error("BTC::serialize_::skipTagPayload", type_id);
+        }
+        is.skip(size);
+    } else if(type_id == DataTypeID::STRING) {
+        is.skip(deserializeIntVar<SIZE_T>(is));
+    } else if(type_id == DataTypeID::STRING_ARR_LEGACY) {
+        SIZE_T len = deserializeIntVar<SIZE_T>(is);
+        for(SIZE_T i=0; i<len; ++i) {
+            is.skip(deserializeIntVar<SIZE_T>(is));
+        }
+    } else if(type_id == DataTypeID::COMPOUND_LEGACY) {
+        UINT64_T len = deserializeIntVar<UINT64_T>(is);
+        for(UINT64_T i=0; i<len; ++i) {
+            is.skip(deserializeByte(is));
+            skipTagPayload(is,deserializeByte(is));
+        }
+    } else if(isVarintArray(type_id) || isBitPackedArray(type_id) || isXorArray(type_id)) {
+        deserializeIntVar<SIZE_T>(is);
+        is.skip(deserializeIntVar<SIZE_T>(is));
+    } else {
+        SIZE_T size = getElementByteSize(type_id);
+        if(size == 0) {
+            throw unknown_type_error("BTC::serialize_::skipTagPayload", type_id);
+        }
+        // the byte size would overflow, skip() checks everything else
+        SIZE_T len = deserializeIntVar<SIZE_T>(is);
+        if(len > SIZE_T(-1)/size) {
+            throw buffer_overflow_error("BTC::serialize_::skipTagPayload", SIZE_T(-1), 0);
+        }
+        is.skip(len*size);
+    }
+}
+
 }}
 
 #endif
@@ -0,0 +1,77 @@
+#ifndef BTC_SERIALIZE_MAPPED_FILE_H
+#define BTC_SERIALIZE_MAPPED_FILE_H
+
+// Only available on POSIX systems.
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "data_type.h"
+#include "exception.h"
+
+namespace BTC {
+namespace serialize_ {
+
+/**
+ * Read-only memory mapping of a whole file.
+ * Meant to be used with BTagCompoundView, which then reads the file
+ * without copying it; the pages are loaded by the system on access.
+ * Throws io_error if the file cannot be opened or mapped.
+ */
+class MappedFile {
+
+    const char* addr;
+    SIZE_T len;
+
+    MappedFile(const MappedFile& file);
+    MappedFile& operator=(const MappedFile& file);
+
+  public:
+    explicit MappedFile(const std::string& path) : addr(0), len(0) {
+        int fd = ::open(path.c_str(),O_RDONLY);
+        if (fd < 0) {
+            throw io_error("BTC::serialize_::MappedFile::MappedFile", path);
+        }
+        struct stat info;
+        if (::fstat(fd,&info) != 0) {
+            ::close(fd);
+            throw io_error("BTC::serialize_::MappedFile::MappedFile", path);
+        }
+        len = SIZE_T(info.st_size);
+        if (len > 0) {
+            void* memory = ::mmap(0,len,PROT_READ,MAP_SHARED,fd,0);
+            if (memory == MAP_FAILED) {
+                ::close(fd);
+                throw io_error("BTC::serialize_::MappedFile::MappedFile", path);
+            }
+            addr = static_cast<const char*>(memory);
+        }
+        // The mapping stays valid without the descriptor
+        ::close(fd);
+    }
+
+    ~MappedFile() {
+        if (addr) {
+            ::munmap(const_cast<char*>(addr),len);
+        }
+    }
+
+    const char* data() const {
+        return addr;
+    }
+
+    SIZE_T size() const {
+        return len;
+    }
+};
+
+}}
+
+#endif
+
+#endif
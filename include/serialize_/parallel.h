@@ -0,0 +1,204 @@
+#ifndef BTC_SERIALIZE_PARALLEL_H
+#define BTC_SERIALIZE_PARALLEL_H
+
+// Needs C++11 threads (link with -pthread).
+#ifdef ASSERT_C11
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "btc.h"
+#include "record_log.h"
+#include "mapped_file.h"
+#include "buffer.h"
+#include "data_type.h"
+#include "exception.h"
+
+namespace BTC {
+namespace serialize_ {
+
+/**
+ * Decodes the records of a record log with nthreads worker threads and
+ * calls callback(k, record) for every record k.
+ * The workers take batches of consecutive records from a shared counter
+ * and decode each one into a BTagCompound of their own that is reused.
+ * Unordered: the callback is called by the workers as soon as a record
+ * is decoded, so it has to be thread-safe.
+ * Ordered: the callback is called in the order of the records and never
+ * concurrently. A worker keeps its decoded batch until it is its turn,
+ * so at most nthreads batches are held in memory.
+ * The record is only valid during the call.
+ * The first exception of a worker (or the callback) stops all workers
+ * and is rethrown.
+ * A batch_size of 0 is taken as 1.
+ */
+template<typename Callback>
+void parallelDecode(const RecordLogReader& reader, unsigned nthreads, Callback callback,
+        bool ordered = false, SIZE_T batch_size = 64) {
+    batch_size = std::max(SIZE_T(1),batch_size);
+    const SIZE_T count = reader.size();
+    const SIZE_T batches = (count+batch_size-1)/batch_size;
+    nthreads = std::max(1u,nthreads);
+    std::atomic<SIZE_T> next_batch(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable turn;
+    SIZE_T delivered = 0;
+
+    auto fail = [&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error) {
+            error = std::current_exception();
+        }
+        failed = true;
+        turn.notify_all();
+    };
+
+    auto work = [&]() {
+        std::vector<BTagCompound> records(ordered ? batch_size : 1);
+        try {
+            for (;;) {
+                SIZE_T batch = next_batch++;
+                if ((batch >= batches) || failed) {
+                    return;
+                }
+                SIZE_T first = batch*batch_size;
+                SIZE_T last = std::min(count,first+batch_size);
+                if (!ordered) {
+                    for (SIZE_T k=first; (k<last) && !failed; ++k) {
+                        reader.read(k,records[0]);
+                        callback(k,records[0]);
+                    }
+                    continue;
+                }
+                for (SIZE_T k=first; k<last; ++k) {
+                    reader.read(k,records[k-first]);
+                }
+                std::unique_lock<std::mutex> lock(mutex);
+                turn.wait(lock,[&]() { return (delivered == batch) || failed; });
+                if (failed) {
+                    return;
+                }
+                lock.unlock();
+                for (SIZE_T k=first; k<last; ++k) {
+                    callback(k,records[k-first]);
+                }
+                lock.lock();
+                ++delivered;
+                turn.notify_all();
+            }
+        } catch (...) {
+            fail();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i=1; i<nthreads; ++i) {
+        threads.push_back(std::thread(work));
+    }
+    work();
+    for (SIZE_T i=0; i<threads.size(); ++i) {
+        threads[i].join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+// Maps the file and decodes it, see above.
+template<typename Callback>
+void parallelDecode(const std::string& path, unsigned nthreads, Callback callback,
+        bool ordered = false, SIZE_T batch_size = 64) {
+    MappedFile file(path);
+    RecordLogReader reader(file.data(),file.size());
+    parallelDecode(reader,nthreads,callback,ordered,batch_size);
+}
+#endif
+
+/**
+ * Serializes the compound into data (at least getByteSize() bytes) with
+ * nthreads threads, the output is the same as that of serialize().
+ * The layout is computed once from the byte sizes: small entries are
+ * written right away, entries of at least min_size bytes (e.g. large
+ * arrays) are left out and then encoded by the threads concurrently into
+ * their own part of data, the largest ones first. Large nested compounds
+ * are split up the same way. A single entry is encoded by one thread.
+ * The compound must not be changed meanwhile.
+ * Throws buffer_overflow_error if len is too small.
+ * Returns the number of bytes written.
+ */
+inline SIZE_T parallelSerialize(const BTagCompound& compound, char* data, SIZE_T len,
+        unsigned nthreads, SIZE_T min_size = 1 << 20) {
+    std::vector<SIZE_T> sizes;
+    SIZE_T bytesize = compound.getByteSizes(sizes);
+    if (bytesize > len) {
+        throw buffer_overflow_error("BTC::serialize_::parallelSerialize", bytesize, len);
+    }
+    std::vector<BTagCompound::DeferredEntry> deferred;
+    {
+        BufferSink sink(data,bytesize);
+        SIZE_T next = 0;
+        compound.serializeSkeleton(sink,std::max(SIZE_T(1),min_size),deferred,sizes,next);
+    }
+    std::sort(deferred.begin(),deferred.end(),
+            [](const BTagCompound::DeferredEntry& a, const BTagCompound::DeferredEntry& b) {
+        return a.size > b.size;
+    });
+    nthreads = unsigned(std::min(SIZE_T(std::max(1u,nthreads)),deferred.size()));
+    std::atomic<SIZE_T> next(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr error;
+    std::mutex mutex;
+
+    auto work = [&]() {
+        try {
+            for (SIZE_T k=next++; (k < deferred.size()) && !failed; k=next++) {
+                BufferSink sink(data+deferred[k].offset,deferred[k].size);
+                deferred[k].entry->serialize(sink);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+            failed = true;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i=1; i<nthreads; ++i) {
+        threads.push_back(std::thread(work));
+    }
+    work();
+    for (SIZE_T i=0; i<threads.size(); ++i) {
+        threads[i].join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return bytesize;
+}
+
+// Serializes into the vector, see above and BTagCompound::serializeTo().
+inline SIZE_T parallelSerialize(const BTagCompound& compound, std::vector<char>& buffer,
+        unsigned nthreads, SIZE_T min_size = 1 << 20) {
+    buffer.resize(compound.getByteSize());
+    if (buffer.empty()) {
+        return 0;
+    }
+    return parallelSerialize(compound,&buffer[0],buffer.size(),nthreads,min_size);
+}
+
+}}
+
+#endif
+
+#endif
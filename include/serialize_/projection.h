@@ -0,0 +1,123 @@
+#ifndef BTC_SERIALIZE_PROJECTION_H
+#define BTC_SERIALIZE_PROJECTION_H
+
+#include <cstring>
+#include <vector>
+#ifdef ASSERT_C11
+#include <initializer_list>
+#endif
+
+#include "data_type.h"
+
+namespace BTC {
+namespace serialize_ {
+
+/**
+ * Set of tag paths that are deserialized by
+ * BTagCompound::deserialize(is, projection), all other entries are skipped.
+ * A path names nested compounds separated by dots, e.g. "inner.values".
+ * An entry is read completely if its path is in the projection; a
+ * compound that is only a prefix of paths is read with just the entries
+ * below it that are in the projection.
+ * Tags that contain a dot cannot be selected in nested compounds.
+ * The paths are stored as a tree, node ROOT stands for the compound that
+ * is deserialized.
+ */
+class Projection {
+
+    struct Child {
+        STRING_T tag;
+        SIZE_T node;
+    };
+
+    struct Node {
+        std::vector<Child> children;
+        bool complete;
+    };
+
+    std::vector<Node> nodes;
+
+    SIZE_T addChild(SIZE_T node, const char* tag, SIZE_T len) {
+        SIZE_T child = find(node,tag,len);
+        if (child != npos) {
+            return child;
+        }
+        Child entry;
+        entry.tag.assign(tag,len);
+        entry.node = nodes.size();
+        nodes[node].children.push_back(entry);
+        Node empty;
+        empty.complete = false;
+        nodes.push_back(empty);
+        return entry.node;
+    }
+
+  public:
+    static const SIZE_T ROOT = 0;
+    static const SIZE_T npos = SIZE_T(-1);
+
+    // Empty projection, selects no entry.
+    Projection() : nodes(1) {
+        nodes[ROOT].complete = false;
+    }
+
+    explicit Projection(const STRING_T& path) : nodes(1) {
+        nodes[ROOT].complete = false;
+        add(path);
+    }
+
+    Projection(const STRING_T* paths, SIZE_T len) : nodes(1) {
+        nodes[ROOT].complete = false;
+        for (SIZE_T i=0; i<len; ++i) {
+            add(paths[i]);
+        }
+    }
+
+#ifdef ASSERT_C11
+    Projection(std::initializer_list<STRING_T> paths) : nodes(1) {
+        nodes[ROOT].complete = false;
+        for (const STRING_T& path : paths) {
+            add(path);
+        }
+    }
+#endif
+
+    Projection& add(const STRING_T& path) {
+        SIZE_T node = ROOT;
+        SIZE_T begin = 0;
+        for (;;) {
+            SIZE_T end = path.find('.',begin);
+            if (end == STRING_T::npos) {
+                end = path.size();
+            }
+            node = addChild(node,path.data()+begin,end-begin);
+            if (end == path.size()) {
+                break;
+            }
+            begin = end+1;
+        }
+        nodes[node].complete = true;
+        return *this;
+    }
+
+    // Node of the tag below node, npos if it is not selected.
+    SIZE_T find(SIZE_T node, const char* tag, SIZE_T len) const {
+        const std::vector<Child>& children = nodes[node].children;
+        for (SIZE_T i=0; i<children.size(); ++i) {
+            if ((children[i].tag.size() == len) &&
+                    (std::memcmp(children[i].tag.data(),tag,len) == 0)) {
+                return children[i].node;
+            }
+        }
+        return npos;
+    }
+
+    // The whole entry of the node is selected.
+    bool isComplete(SIZE_T node) const {
+        return nodes[node].complete;
+    }
+};
+
+}}
+
+#endif
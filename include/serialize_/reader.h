@@ -0,0 +1,331 @@
+#ifndef BTC_SERIALIZE_READER_H
+#define BTC_SERIALIZE_READER_H
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <vector>
+
+#include "buffer.h"
+#include "function.h"
+#include "data_type.h"
+#include "exception.h"
+
+namespace BTC {
+namespace serialize_ {
+
+/**
+ * Receives the events of a BTagReader.
+ * All methods do nothing by default, a handler overrides the ones it
+ * needs. Pointers passed to a method are only valid during the call.
+ * The events of a compound are
+ *   beginCompound(size), size times [key(...) value], endCompound()
+ * where value is a single value event, an array (beginArray(),
+ * chunks or one stringValue() per string, endArray()) or a compound.
+ * Numbers in a legacy layout are converted, their key() still reports
+ * the type ID as written.
+ */
+class BTagHandler {
+
+  public:
+    virtual ~BTagHandler() {}
+
+    virtual void beginCompound(UINT64_T size) {}
+    virtual void endCompound() {}
+    virtual void key(const char* tag, SIZE_T len, UINT8_T type_id) {}
+
+    virtual void byteValue(UINT8_T value) {}
+    virtual void shortValue(UINT16_T value) {}
+    virtual void intValue(UINT32_T value) {}
+    virtual void longValue(UINT64_T value) {}
+    virtual void floatValue(FLOAT_T value) {}
+    virtual void doubleValue(DOUBLE_T value) {}
+    virtual void stringValue(const char* data, SIZE_T len) {}
+
+    // Number arrays are passed in chunks of at most ARRAY_BLOCK_SIZE
+    // elements.
+    virtual void beginArray(UINT8_T type_id, SIZE_T len) {}
+    virtual void endArray() {}
+    virtual void byteChunk(const UINT8_T* data, SIZE_T n) {}
+    virtual void shortChunk(const UINT16_T* data, SIZE_T n) {}
+    virtual void intChunk(const UINT32_T* data, SIZE_T n) {}
+    virtual void longChunk(const UINT64_T* data, SIZE_T n) {}
+    virtual void floatChunk(const FLOAT_T* data, SIZE_T n) {}
+    virtual void doubleChunk(const DOUBLE_T* data, SIZE_T n) {}
+};
+
+/**
+ * Reads a serialized BTagCompound as a sequence of events (see
+ * BTagHandler) without building any tags.
+ * Uses the decoders of function.h on any source (BufferSource or
+ * std::istream). Besides the stack of nested compounds, memory is only
+ * needed for one array chunk and for the longest string (or the payload
+ * of a varint, bit-packed or XOR array), so the size of the data does not
+ * matter.
+ * Throws unknown_type_error for an unknown type.
+ */
+class BTagReader {
+
+    std::vector<char> text;
+
+    template<typename Source>
+    void readString(Source& is, BTagHandler& handler) {
+        SIZE_T len = deserializeIntVar<SIZE_T>(is);
+        if (text.size() < len) {
+            text.resize(len);
+        }
+        if (len > 0) {
+            is.read(&text[0],len);
+        }
+        handler.stringValue(len > 0 ? &text[0] : "",len);
+    }
+
+    // W is the wire type of the elements.
+    template<typename W, typename Source, typename Chunk>
+    void readWords(Source& is, SIZE_T len, BTagHandler& handler, Chunk chunk) {
+        W buffer[ARRAY_BLOCK_SIZE];
+        for (SIZE_T i=0; i<len; i+=ARRAY_BLOCK_SIZE) {
+            SIZE_T n = std::min(ARRAY_BLOCK_SIZE,len-i);
+            is.read(reinterpret_cast<char*>(buffer),n*sizeof(W));
+            byte_order.toHostEndian(buffer,n);
+            (handler.*chunk)(buffer,n);
+        }
+    }
+
+    // F is the host type of the floats, W the wire type.
+    template<typename F, typename W, typename Source, typename Chunk>
+    void readFloats(Source& is, SIZE_T len, BTagHandler& handler, Chunk chunk, bool legacy) {
+        W buffer[ARRAY_BLOCK_SIZE];
+        F values[ARRAY_BLOCK_SIZE];
+        for (SIZE_T i=0; i<len; i+=ARRAY_BLOCK_SIZE) {
+            SIZE_T n = std::min(ARRAY_BLOCK_SIZE,len-i);
+            is.read(reinterpret_cast<char*>(buffer),n*sizeof(W));
+            byte_order.toHostEndian(buffer,n);
+            if (legacy) {
+                for (SIZE_T j=0; j<n; ++j) {
+                    values[j] = decodeLegacy(buffer[j]);
+                }
+            } else {
+                std::memcpy(values,buffer,n*sizeof(W));
+            }
+            (handler.*chunk)(values,n);
+        }
+    }
+
+    static FLOAT_T decodeLegacy(UINT32_T data) {
+        return decodeFloatLegacy(data);
+    }
+
+    static DOUBLE_T decodeLegacy(UINT64_T data) {
+        return decodeDoubleLegacy(data);
+    }
+
+    template<typename Source>
+    void readArray(Source& is, UINT8_T type_id, BTagHandler& handler) {
+        if (isChunkedArray(type_id)) {
+            readChunkedArray(is,type_id,handler);
+            return;
+        }
+        if (isVarintArray(type_id)) {
+            if ((type_id == DataTypeID::DELTA_UINT64_ARR) || (type_id == DataTypeID::ZIGZAG_UINT64_ARR)) {
+                readVarints<UINT64_T>(is,type_id,handler,&BTagHandler::longChunk);
+            } else {
+                readVarints<UINT32_T>(is,type_id,handler,&BTagHandler::intChunk);
+            }
+            return;
+        }
+        if (type_id == DataTypeID::XOR_FLOAT_ARR) {
+            readXor<FLOAT_T>(is,type_id,handler,&BTagHandler::floatChunk);
+            return;
+        }
+        if (type_id == DataTypeID::XOR_DOUBLE_ARR) {
+            readXor<DOUBLE_T>(is,type_id,handler,&BTagHandler::doubleChunk);
+            return;
+        }
+        if (type_id == DataTypeID::BITPACK_UINT32_ARR) {
+            readBitPacked<UINT32_T>(is,type_id,handler,&BTagHandler::intChunk);
+            return;
+        }
+        if (type_id == DataTypeID::BITPACK_UINT64_ARR) {
+            readBitPacked<UINT64_T>(is,type_id,handler,&BTagHandler::longChunk);
+            return;
+        }
+        SIZE_T len = deserializeIntVar<SIZE_T>(is);
+        handler.beginArray(type_id,len);
+        readElements(is,type_id,len,handler);
+        handler.endArray();
+    }
+
+    // Varint arrays are decoded block by block, only the varints are 
+    // held in memory.
+    template<typename W, typename Source, typename Chunk>
+    void readVarints(Source& is, UINT8_T type_id, BTagHandler& handler, Chunk chunk) {
+        bool delta = (type_id == DataTypeID::DELTA_UINT32_ARR) || (type_id == DataTypeID::DELTA_UINT64_ARR);
+        SIZE_T len = deserializeIntVar<SIZE_T>(is);
+        SIZE_T bytesize = deserializeIntVar<SIZE_T>(is);
+        const char* pos = readPayloadBytes(is,bytesize,text);
+        const char* end = pos+bytesize;
+        handler.beginArray(type_id,len);
+        W buffer[ARRAY_BLOCK_SIZE];
+        W prev = 0;
+        for (SIZE_T i=0; i<len; i+=ARRAY_BLOCK_SIZE) {
+            SIZE_T n = std::min(ARRAY_BLOCK_SIZE,len-i);
+            decodeVarints<W>(pos,end,n,buffer);
+            decodeVarintCodes<W>(buffer,n,delta,prev,buffer);
+            (handler.*chunk)(buffer,n);
+        }
+        handler.endArray();
+    }
+
+    // Bit-packed arrays are passed block by block.
+    template<typename W, typename Source, typename Chunk>
+    void readBitPacked(Source& is, UINT8_T type_id, BTagHandler& handler, Chunk chunk) {
+        SIZE_T len = deserializeIntVar<SIZE_T>(is);
+        SIZE_T bytesize = deserializeIntVar<SIZE_T>(is);
+        const char* pos = readPayloadBytes(is,bytesize,text);
+        const char* end = pos+bytesize;
+        handler.beginArray(type_id,len);
+        W buffer[BITPACK_BLOCK_SIZE];
+        for (SIZE_T i=0; i<len; i+=BITPACK_BLOCK_SIZE) {
+            SIZE_T n = std::min(BITPACK_BLOCK_SIZE,len-i);
+            unpackBlock<W>(pos,end,n,buffer);
+            (handler.*chunk)(buffer,n);
+        }
+        handler.endArray();
+    }
+
+    template<typename F, typename Source, typename Chunk>
+    void readXor(Source& is, UINT8_T type_id, BTagHandler& handler, Chunk chunk) {
+        SIZE_T len = deserializeIntVar<SIZE_T>(is);
+        SIZE_T bytesize = deserializeIntVar<SIZE_T>(is);
+        XorDecoder<F> decoder(readPayloadBytes(is,bytesize,text),bytesize);
+        handler.beginArray(type_id,len);
+        F buffer[ARRAY_BLOCK_SIZE];
+        for (SIZE_T i=0; i<len; i+=ARRAY_BLOCK_SIZE) {
+            SIZE_T n = std::min(ARRAY_BLOCK_SIZE,len-i);
+            for (SIZE_T j=0; j<n; ++j) {
+                buffer[j] = decoder.next();
+            }
+            (handler.*chunk)(buffer,n);
+        }
+        handler.endArray();
+    }
+
+    // The chunks are passed on one after the other.
+    template<typename Source>
+    void readChunkedArray(Source& is, UINT8_T type_id, BTagHandler& handler) {
+        UINT8_T array_type = deserializeByte(is);
+        if (getChunkedTypeID(array_type) != type_id) {
+            throw unknown_type_error("BTC::serialize_::BTagReader::read", array_type);
+        }
+        SIZE_T len = deserializeIntVar<SIZE_T>(is);
+        SIZE_T chunk_len = deserializeIntVar<SIZE_T>(is);
+        handler.beginArray(type_id,len);
+        SIZE_T count = (chunk_len == 0) ? 0 : (len+chunk_len-1)/chunk_len;
+        // Offset table (read, a std::istream cannot skip)
+        for (SIZE_T i=0; i<count; ++i) {
+            deserializeLong(is);
+        }
+        for (SIZE_T i=0; i<count; ++i) {
+            readElements(is,array_type,deserializeIntVar<SIZE_T>(is),handler);
+        }
+        handler.endArray();
+    }
+
+    template<typename Source>
+    void readElements(Source& is, UINT8_T type_id, SIZE_T len, BTagHandler& handler) {
+        switch (type_id) {
+            case DataTypeID::STRING_ARR:
+            case DataTypeID::STRING_ARR_LEGACY:
+                for (SIZE_T i=0; i<len; ++i) {
+                    readString(is,handler);
+                }
+                break;
+            case DataTypeID::UINT8_ARR:
+                readWords<UINT8_T>(is,len,handler,&BTagHandler::byteChunk);
+                break;
+            case DataTypeID::UINT16_ARR:
+                readWords<UINT16_T>(is,len,handler,&BTagHandler::shortChunk);
+                break;
+            case DataTypeID::UINT32_ARR:
+                readWords<UINT32_T>(is,len,handler,&BTagHandler::intChunk);
+                break;
+            case DataTypeID::UINT64_ARR:
+                readWords<UINT64_T>(is,len,handler,&BTagHandler::longChunk);
+                break;
+            case DataTypeID::FLOAT_ARR:
+            case DataTypeID::FLOAT_ARR_LEGACY:
+                readFloats<FLOAT_T,UINT32_T>(is,len,handler,&BTagHandler::floatChunk,
+                        type_id == DataTypeID::FLOAT_ARR_LEGACY);
+                break;
+            case DataTypeID::DOUBLE_ARR:
+            case DataTypeID::DOUBLE_ARR_LEGACY:
+                readFloats<DOUBLE_T,UINT64_T>(is,len,handler,&BTagHandler::doubleChunk,
+                        type_id == DataTypeID::DOUBLE_ARR_LEGACY);
+                break;
+            default:
+                throw unknown_type_error("BTC::serialize_::BTagReader::read", type_id);
+        }
+    }
+
+    template<typename Source>
+    void readValue(Source& is, UINT8_T type_id, BTagHandler& handler) {
+        if (hasByteSize(type_id)) {
+            deserializeIntVar<SIZE_T>(is);
+        }
+        switch (type_id) {
+            case DataTypeID::UINT8: handler.byteValue(deserializeByte(is)); break;
+            case DataTypeID::UINT16: handler.shortValue(deserializeShort(is)); break;
+            case DataTypeID::UINT32: handler.intValue(deserializeInt(is)); break;
+            case DataTypeID::UINT64: handler.longValue(deserializeLong(is)); break;
+            case DataTypeID::FLOAT: handler.floatValue(deserializeFloat(is)); break;
+            case DataTypeID::DOUBLE: handler.doubleValue(deserializeDouble(is)); break;
+            case DataTypeID::FLOAT_LEGACY: handler.floatValue(deserializeFloatLegacy(is)); break;
+            case DataTypeID::DOUBLE_LEGACY: handler.doubleValue(deserializeDoubleLegacy(is)); break;
+            case DataTypeID::STRING: readString(is,handler); break;
+            default:
+                if (isCompound(type_id)) {
+                    readCompound(is,handler);
+                } else if (isArray(type_id)) {
+                    readArray(is,type_id,handler);
+                } else {
+                    throw unknown_type_error("BTC::serialize_::BTagReader::read", type_id);
+                }
+        }
+    }
+
+    template<typename Source>
+    void readCompound(Source& is, BTagHandler& handler) {
+        UINT64_T size = deserializeIntVar<UINT64_T>(is);
+        handler.beginCompound(size);
+        char tag[256];
+        for (UINT64_T i=0; i<size; ++i) {
+            UINT8_T tag_len = deserializeByte(is);
+            if (tag_len > 0) {
+                is.read(tag,tag_len);
+            }
+            UINT8_T type_id = deserializeByte(is);
+            handler.key(tag,tag_len,type_id);
+            readValue(is,type_id,handler);
+        }
+        handler.endCompound();
+    }
+
+  public:
+    BTagReader() : text() {}
+
+    // Reads one compound as written by BTagCompound::serialize().
+    template<typename Source>
+    void read(Source& is, BTagHandler& handler) {
+        readCompound(is,handler);
+    }
+
+    void read(std::istream& is, BTagHandler& handler) {
+        BufferSource source(is);
+        readCompound(source,handler);
+    }
+};
+
+}}
+
+#endif
@@ -0,0 +1,287 @@
+#ifndef BTC_SERIALIZE_RECORD_LOG_H
+#define BTC_SERIALIZE_RECORD_LOG_H
+
+#include <cstring>
+#include <ostream>
+#include <vector>
+
+#include "btc.h"
+#include "view.h"
+#include "buffer.h"
+#include "function.h"
+#include "data_type.h"
+#include "exception.h"
+
+namespace BTC {
+namespace serialize_ {
+
+/**
+ * Layout of a record log: a file of independent BTagCompound records.
+ *   header:  MAGIC (4 bytes), VERSION (1 byte)
+ *   record:  SYNC_MARKER (8 bytes), byte size (8 bytes), checksum of the
+ *            compound (4 bytes), the serialized compound
+ *   index:   INDEX_MARKER (8 bytes), record count (8 bytes), the offset
+ *            of every record (8 bytes each)
+ *   trailer: offset of the index (8 bytes), END_MARKER (8 bytes)
+ * All numbers are little endian, offsets are counted from the header.
+ * The index and the trailer are optional (written by
+ * RecordLogWriter::close()). Without them, or after a torn write, the
+ * reader scans the records and continues behind damaged ones at the
+ * next sync marker.
+ */
+namespace RecordLog {
+static const char MAGIC[4] = {'B','T','C','L'};
+static const UINT8_T VERSION = 1;
+static const SIZE_T HEADER_SIZE = 5;
+static const char SYNC_MARKER[8] = {'\xB7','R','E','C','\x00','\xFF','\x1A','\x0A'};
+static const char INDEX_MARKER[8] = {'\xB7','I','D','X','\x00','\xFF','\x1A','\x0A'};
+static const char END_MARKER[8] = {'\xB7','E','N','D','\x00','\xFF','\x1A','\x0A'};
+static const SIZE_T RECORD_HEADER_SIZE = 20;
+static const SIZE_T TRAILER_SIZE = 16;
+
+// FNV-1a with 32 bit arithmetic (the same on all hosts).
+inline UINT32_T checksum(const char* data, SIZE_T len) {
+    UINT32_T hash = 2166136261u;
+    for (SIZE_T i=0; i<len; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+}
+
+/**
+ * Appends records to a new record log in the stream.
+ * Each record is serialized once into a reused buffer.
+ * close() (or the destructor) writes the index unless disabled.
+ */
+class RecordLogWriter {
+
+    std::ostream* stream;
+    std::vector<char> buffer;
+    // sizes of nested compounds, see BTagCompound::serializeTo()
+    std::vector<SIZE_T> sizes;
+    std::vector<UINT64_T> offsets;
+    UINT64_T position;
+    bool indexed;
+    bool closed;
+
+    RecordLogWriter(const RecordLogWriter& writer);
+    RecordLogWriter& operator=(const RecordLogWriter& writer);
+
+    void writeLong(UINT64_T value) {
+        char bytes[8];
+        BufferSink sink(bytes,8);
+        serializeLong(sink,value);
+        stream->write(bytes,8);
+    }
+
+  public:
+    explicit RecordLogWriter(std::ostream& os, bool write_index = true)
+            : stream(&os), buffer(), sizes(), offsets(), position(RecordLog::HEADER_SIZE),
+              indexed(write_index), closed(false) {
+        stream->write(RecordLog::MAGIC,4);
+        char version = char(RecordLog::VERSION);
+        stream->write(&version,1);
+    }
+
+    ~RecordLogWriter() {
+        if (!closed) {
+            close();
+        }
+    }
+
+    // Appends the record, returns its number.
+    SIZE_T append(const BTagCompound& record) {
+        SIZE_T bytesize = record.serializeTo(buffer,sizes);
+        const char* data = (bytesize > 0) ? &buffer[0] : "";
+        char header[RecordLog::RECORD_HEADER_SIZE];
+        std::memcpy(header,RecordLog::SYNC_MARKER,8);
+        BufferSink sink(header+8,12);
+        serializeLong(sink,UINT64_T(bytesize));
+        serializeInt(sink,RecordLog::checksum(data,bytesize));
+        stream->write(header,RecordLog::RECORD_HEADER_SIZE);
+        stream->write(data,bytesize);
+        offsets.push_back(position);
+        position += RecordLog::RECORD_HEADER_SIZE+bytesize;
+        return offsets.size()-1;
+    }
+
+    SIZE_T size() const {
+        return offsets.size();
+    }
+
+    // Writes the index and flushes the stream. No record may follow.
+    void close() {
+        if (indexed) {
+            stream->write(RecordLog::INDEX_MARKER,8);
+            writeLong(offsets.size());
+            for (SIZE_T i=0; i<offsets.size(); ++i) {
+                writeLong(offsets[i]);
+            }
+            writeLong(position);
+            stream->write(RecordLog::END_MARKER,8);
+        }
+        stream->flush();
+        closed = true;
+    }
+};
+
+/**
+ * Reads a record log in memory (e.g. a MappedFile).
+ * With an index every record is found in O(1) (the index is read in
+ * place), otherwise the records are scanned once on construction.
+ * The memory has to outlive the reader.
+ * Throws format_error if the header is wrong.
+ */
+class RecordLogReader {
+
+    const char* begin;
+    SIZE_T len;
+    // Offsets found by the scan, not used with an index
+    std::vector<UINT64_T> offsets;
+    // Offsets in the index of the file (read in place)
+    const char* index_offsets;
+    SIZE_T count;
+    SIZE_T damaged;
+
+    static UINT64_T readLong(const char* data) {
+        BufferSource source(data,8);
+        return deserializeLong(source);
+    }
+
+    // Loads the index, false if there is none or it is not valid.
+    bool loadIndex() {
+        if (len < RecordLog::HEADER_SIZE+RecordLog::TRAILER_SIZE+16 ||
+                std::memcmp(begin+len-8,RecordLog::END_MARKER,8) != 0) {
+            return false;
+        }
+        UINT64_T index = readLong(begin+len-RecordLog::TRAILER_SIZE);
+        if (index < RecordLog::HEADER_SIZE || index > len-RecordLog::TRAILER_SIZE-16 ||
+                std::memcmp(begin+index,RecordLog::INDEX_MARKER,8) != 0) {
+            return false;
+        }
+        UINT64_T records = readLong(begin+index+8);
+        if (records > len/8 || index+16+8*records != len-RecordLog::TRAILER_SIZE) {
+            return false;
+        }
+        index_offsets = begin+index+16;
+        count = SIZE_T(records);
+        return true;
+    }
+
+    // Size of a valid record at offset, 0 if there is none.
+    SIZE_T recordSize(SIZE_T offset, SIZE_T end) const {
+        if (end-offset < RecordLog::RECORD_HEADER_SIZE ||
+                std::memcmp(begin+offset,RecordLog::SYNC_MARKER,8) != 0) {
+            return 0;
+        }
+        UINT64_T bytesize = readLong(begin+offset+8);
+        if (bytesize > end-offset-RecordLog::RECORD_HEADER_SIZE) {
+            return 0;
+        }
+        BufferSource source(begin+offset+16,4);
+        UINT32_T sum = deserializeInt(source);
+        if (sum != RecordLog::checksum(begin+offset+RecordLog::RECORD_HEADER_SIZE,SIZE_T(bytesize))) {
+            return 0;
+        }
+        return RecordLog::RECORD_HEADER_SIZE+SIZE_T(bytesize);
+    }
+
+    // Collects the valid records, damaged ranges are skipped up to the
+    // next sync marker.
+    void scan() {
+        SIZE_T end = len;
+        if (len >= RecordLog::TRAILER_SIZE &&
+                std::memcmp(begin+len-8,RecordLog::END_MARKER,8) == 0) {
+            UINT64_T index = readLong(begin+len-RecordLog::TRAILER_SIZE);
+            if (index >= RecordLog::HEADER_SIZE && index <= len) {
+                end = SIZE_T(index);
+            }
+        }
+        SIZE_T offset = RecordLog::HEADER_SIZE;
+        while (offset < end) {
+            SIZE_T size = recordSize(offset,end);
+            if (size > 0) {
+                offsets.push_back(offset);
+                offset += size;
+                continue;
+            }
+            SIZE_T next = offset+1;
+            while (next+8 <= end && std::memcmp(begin+next,RecordLog::SYNC_MARKER,8) != 0) {
+                ++next;
+            }
+            if (next+8 > end) {
+                next = end;
+            }
+            damaged += next-offset;
+            offset = next;
+        }
+    }
+
+    void record(const char* method, SIZE_T k, const char*& data, SIZE_T& size) const {
+        if (k >= count) {
+            throw buffer_overflow_error(method, k+1, count);
+        }
+        UINT64_T offset = index_offsets ? readLong(index_offsets+8*k) : offsets[k];
+        SIZE_T bytesize = (offset <= len) ? recordSize(SIZE_T(offset),len) : 0;
+        if (bytesize == 0) {
+            throw format_error(method, "The record is damaged");
+        }
+        data = begin+offset+RecordLog::RECORD_HEADER_SIZE;
+        size = bytesize-RecordLog::RECORD_HEADER_SIZE;
+    }
+
+  public:
+    RecordLogReader(const char* data, SIZE_T length)
+            : begin(data), len(length), offsets(), index_offsets(0), count(0), damaged(0) {
+        if (len < RecordLog::HEADER_SIZE || std::memcmp(begin,RecordLog::MAGIC,4) != 0) {
+            throw format_error("BTC::serialize_::RecordLogReader::RecordLogReader", "Not a record log");
+        }
+        if (UINT8_T(begin[4]) != RecordLog::VERSION) {
+            throw format_error("BTC::serialize_::RecordLogReader::RecordLogReader", "Unknown version");
+        }
+        if (!loadIndex()) {
+            scan();
+            count = offsets.size();
+        }
+    }
+
+    // Number of records.
+    SIZE_T size() const {
+        return count;
+    }
+
+    // The index was used (no scan was necessary).
+    bool isIndexed() const {
+        return(index_offsets != 0);
+    }
+
+    // Bytes skipped by the scan because they held no valid record.
+    SIZE_T getDamagedByteCount() const {
+        return damaged;
+    }
+
+    // Deserializes record k into the compound, its previous entries are
+    // removed.
+    // Throws format_error if the checksum does not match.
+    void read(SIZE_T k, BTagCompound& compound) const {
+        const char* data;
+        SIZE_T size;
+        record("BTC::serialize_::RecordLogReader::read",k,data,size);
+        compound.clear();
+        compound.deserializeFrom(data,size);
+    }
+
+    // View of record k (without copying).
+    BTagCompoundView view(SIZE_T k) const {
+        const char* data;
+        SIZE_T size;
+        record("BTC::serialize_::RecordLogReader::view",k,data,size);
+        return BTagCompoundView(data,size);
+    }
+};
+
+}}
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef BTC_SERIALIZE_SNAPSHOT_H
+#define BTC_SERIALIZE_SNAPSHOT_H
+
+// Needs atomic reference counts (ATOMIC_REFCOUNT, which needs ASSERT_C11).
+#ifdef ATOMIC_REFCOUNT
+
+#include <atomic>
+#include <mutex>
+#include <set>
+
+#include "btc.h"
+#include "data_type.h"
+#include "exception.h"
+
+namespace BTC {
+namespace serialize_ {
+
+/**
+ * A BTagCompound that is read by many threads and changed by one.
+ * Every version is an immutable snapshot: readers take the current one
+ * (see SnapshotReader) and read it without locks, the writer builds the
+ * next one with a SnapshotWriter and publishes it. A snapshot is freed
+ * when the last reader lets go of it.
+ * The mutex is only held to copy the pointer to the current snapshot.
+ */
+class SharedCompound {
+
+    mutable std::mutex mutex;
+    ptr_::SharedConstObjPtr<BTagCompound> current;
+    std::atomic<UINT64_T> version;
+
+    SharedCompound(const SharedCompound& shared);
+    SharedCompound& operator=(const SharedCompound& shared);
+
+  public:
+    SharedCompound() : mutex(), current(new BTagCompound()), version(1) {}
+
+    explicit SharedCompound(const BTagCompound& comp)
+            : mutex(), current(new BTagCompound(comp)), version(1) {
+    }
+
+    // The current snapshot.
+    ptr_::SharedConstObjPtr<BTagCompound> snapshot() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return current;
+    }
+
+    // Number of the current snapshot, counted from 1.
+    UINT64_T getVersion() const {
+        return version.load(std::memory_order_acquire);
+    }
+
+    // Makes next the current snapshot. It must not be changed afterwards.
+    void publish(const ptr_::SharedConstObjPtr<BTagCompound>& next) {
+        ptr_::SharedConstObjPtr<BTagCompound> old(next);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            current.swap(old);
+            version.fetch_add(1,std::memory_order_release);
+        }
+        // The old snapshot is released outside of the lock
+    }
+};
+
+/**
+ * Access of one reader thread to a SharedCompound.
+ * Keeps the snapshot it got last and only takes a new one (and the lock)
+ * after a publish, so a read costs one atomic load.
+ * Example:
+ *     SnapshotReader reader(settings);
+ *     UINT32_T limit = reader.get().getValue<UINT32_T>("limit");
+ */
+class SnapshotReader {
+
+    const SharedCompound* shared;
+    UINT64_T version;
+    ptr_::SharedConstObjPtr<BTagCompound> current;
+
+  public:
+    explicit SnapshotReader(const SharedCompound& s)
+            : shared(&s), version(s.getVersion()), current(s.snapshot()) {
+    }
+
+    // The newest snapshot. The reference stays valid until the next call.
+    const BTagCompound& get() {
+        UINT64_T latest = shared->getVersion();
+        if (latest != version) {
+            current = shared->snapshot();
+            version = latest;
+        }
+        return *current;
+    }
+
+    // The snapshot of the last get() (kept even if a newer one exists).
+    const ptr_::SharedConstObjPtr<BTagCompound>& snapshot() const {
+        return current;
+    }
+};
+
+/**
+ * Builds the next snapshot of a SharedCompound copy-on-write.
+ * The root is a copy of the current snapshot that shares all tags with
+ * it (copying a compound copies its entries, not the tags they point
+ * to). edit(path) copies the compounds on the path the same way, once
+ * per writer, so a change copies the path from the root to the entry and
+ * nothing else.
+ * Only root() and the compounds returned by edit() may be changed: a tag
+ * taken from them with getTag() is still shared with the readers, as is
+ * a string changed through getValue().
+ * Only one writer per SharedCompound may exist at a time.
+ * Example:
+ *     SnapshotWriter writer(settings);
+ *     writer.edit("limits.http").setInt("timeout",30u);
+ *     writer.publish();
+ */
+class SnapshotWriter {
+
+    SharedCompound* shared;
+    ptr_::SharedObjPtr<BTagCompound> next;
+    // Compounds copied by this writer
+    std::set<const BTagCompound*> copies;
+
+    SnapshotWriter(const SnapshotWriter& writer);
+    SnapshotWriter& operator=(const SnapshotWriter& writer);
+
+    void start() {
+        next = ptr_::SharedObjPtr<BTagCompound>(new BTagCompound(*shared->snapshot()));
+        copies.clear();
+        copies.insert(&*next);
+    }
+
+  public:
+    explicit SnapshotWriter(SharedCompound& s) : shared(&s), next(), copies() {
+        start();
+    }
+
+    BTagCompound& root() {
+        return *next;
+    }
+
+    // The compound at the path (tags separated by dots, e.g. "a.b") for
+    // changing. Missing compounds on the path are created.
+    // Throws wrong_type_error if an entry on the path is no compound.
+    BTagCompound& edit(const STRING_T& path) {
+        BTagCompound* node = &*next;
+        SIZE_T begin = 0;
+        for (;;) {
+            SIZE_T end = path.find('.',begin);
+            if (end == STRING_T::npos) {
+                end = path.size();
+            }
+            STRING_T tag(path,begin,end-begin);
+            ptr_::SharedObjPtr<BTagCompound> child;
+            if (!node->hasTag(tag)) {
+                child = ptr_::SharedObjPtr<BTagCompound>(new BTagCompound());
+                node->setTag(tag,child);
+                copies.insert(&*child);
+            } else if (!isCompound(node->getTypeID(tag))) {
+                throw wrong_type_error("BTC::serialize_::SnapshotWriter::edit", "compound");
+            } else {
+                child = node->getTag<BTagCompound>(tag);
+                if (copies.find(&*child) == copies.end()) {
+                    child = ptr_::SharedObjPtr<BTagCompound>(new BTagCompound(*child));
+                    node->setTag(tag,child);
+                    copies.insert(&*child);
+                }
+            }
+            node = &*child;
+            if (end == path.size()) {
+                return *node;
+            }
+            begin = end+1;
+        }
+    }
+
+    // Publishes the changes and starts over from the new snapshot.
+    void publish() {
+        shared->publish(next);
+        start();
+    }
+
+    // Drops the changes.
+    void discard() {
+        start();
+    }
+};
+
+}}
+
+#endif
+
+#endif
@@ -0,0 +1,291 @@
+#ifndef BTC_SERIALIZE_VIEW_H
+#define BTC_SERIALIZE_VIEW_H
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+#include "btc.h"
+#include "buffer.h"
+#include "function.h"
+#include "data_type.h"
+#include "exception.h"
+
+namespace BTC {
+namespace serialize_ {
+
+/**
+ * Read-only access to a serialized number array in place.
+ * T is the element type in memory, its size has to match the wire type.
+ * Elements are stored little endian and are usually unaligned (the
+ * payload follows the variable length prefix), so operator[] copies
+ * single elements and copyTo() copies the whole array.
+ */
+template<typename T>
+class ArrayView {
+
+    const char* bytes;
+    SIZE_T len;
+
+  public:
+    ArrayView() : bytes(0), len(0) {}
+
+    ArrayView(const char* b, SIZE_T l) : bytes(b), len(l) {}
+
+    SIZE_T size() const {
+        return len;
+    }
+
+    T operator[](SIZE_T i) const {
+        T val;
+        std::memcpy(&val,bytes+i*sizeof(T),sizeof(T));
+        if (!byte_order.isLittleEndian()) {
+            char* p = reinterpret_cast<char*>(&val);
+            std::reverse(p,p+sizeof(T));
+        }
+        return val;
+    }
+
+    // Pointer to the array in place, null if the host is big endian or
+    // the array is not aligned for T. The layout does not align arrays, 
+    // so this is only non-null by chance; callers need the fallback.
+    const T* data() const {
+        if (!byte_order.isLittleEndian() ||
+                (reinterpret_cast<SIZE_T>(bytes) % sizeof(T) != 0)) {
+            return 0;
+        }
+        return reinterpret_cast<const T*>(bytes);
+    }
+
+    // Copies the array into out (room for size() elements).
+    void copyTo(T* out) const {
+        if (len > 0) {
+            std::memcpy(out,bytes,len*sizeof(T));
+        }
+        if (!byte_order.isLittleEndian()) {
+            for (SIZE_T i=0; i<len; ++i) {
+                char* p = reinterpret_cast<char*>(out+i);
+                std::reverse(p,p+sizeof(T));
+            }
+        }
+    }
+
+    // The raw little-endian bytes.
+    const char* getBytes() const {
+        return bytes;
+    }
+};
+
+/**
+ * Read-only view of a serialized BTagCompound.
+ * Works directly on the memory (e.g. a MappedFile): constructing the view
+ * only indexes the entries of the top level, values are decoded and
+ * nested compounds are indexed on access. Arrays are returned as
+ * ArrayView into the memory, their elements are copied on access.
+ * The memory has to outlive the view and everything taken from it.
+ * Arrays in a legacy layout cannot be viewed, such data has to be
+ * deserialized.
+ */
+class BTagCompoundView {
+
+    struct Entry {
+        const char* tag;
+        SIZE_T tag_len;
+        UINT8_T type;
+        // behind the byte size prefix, if the type has one
+        const char* payload;
+    };
+
+    // Orders entries by tag, equal tags by position (the first one wins
+    // as in BTagCompound).
+    struct EntryOrder {
+        bool operator()(const Entry& a, const Entry& b) const {
+            int cmp = compare(a,b.tag,b.tag_len);
+            return((cmp < 0) || ((cmp == 0) && (a.payload < b.payload)));
+        }
+
+        bool operator()(const Entry& a, const TagRef& tag) const {
+            return(compare(a,tag.data,tag.size) < 0);
+        }
+
+        static int compare(const Entry& a, const char* tag, SIZE_T len) {
+            int cmp = std::memcmp(a.tag,tag,std::min(a.tag_len,len));
+            if (cmp != 0) {
+                return cmp;
+            }
+            return((a.tag_len < len) ? -1 : ((a.tag_len > len) ? 1 : 0));
+        }
+    };
+
+    std::vector<Entry> entries;
+    const char* begin;
+    SIZE_T bytesize;
+
+    static STRING_T typeName(UINT8_T type_id) {
+        std::ostringstream ss;
+        ss << "ID " << int(type_id);
+        return ss.str();
+    }
+
+    const Entry& findEntry(const char* method, const TagRef& tag) const {
+        std::vector<Entry>::const_iterator iter =
+            std::lower_bound(entries.begin(),entries.end(),tag,EntryOrder());
+        if ((iter == entries.end()) || (EntryOrder::compare(*iter,tag.data,tag.size) != 0)) {
+            throw tag_not_found_error(method, tag.str());
+        }
+        return *iter;
+    }
+
+    // Throws buffer_overflow_error if len elements do not fit into is.
+    static void checkLength(const char* method, const BufferSource& is, SIZE_T len, SIZE_T size) {
+        if (len > is.remaining()/size) {
+            throw buffer_overflow_error(method, 
+                    (len > SIZE_T(-1)/size) ? SIZE_T(-1) : len*size, is.remaining());
+        }
+    }
+
+  public:
+    BTagCompoundView() : entries(), begin(0), bytesize(0) {}
+
+    // Indexes the compound at the beginning of the memory.
+    // Throws buffer_overflow_error if the data is truncated.
+    BTagCompoundView(const char* data, SIZE_T len) : entries(), begin(data), bytesize(0) {
+        BufferSource is(data,len);
+        UINT64_T count = deserializeIntVar<UINT64_T>(is);
+        entries.reserve(SIZE_T(std::min(count,UINT64_T(len/3))));
+        for (UINT64_T i=0; i<count; ++i) {
+            Entry entry;
+            entry.tag_len = deserializeByte(is);
+            entry.tag = is.current();
+            is.skip(entry.tag_len);
+            entry.type = deserializeByte(is);
+            if (hasByteSize(entry.type)) {
+                SIZE_T payload_size = deserializeIntVar<SIZE_T>(is);
+                entry.payload = is.current();
+                is.skip(payload_size);
+            } else {
+                entry.payload = is.current();
+                skipTagPayload(is,entry.type);
+            }
+            entries.push_back(entry);
+        }
+        std::sort(entries.begin(),entries.end(),EntryOrder());
+        bytesize = len-is.remaining();
+    }
+
+    // Number of entries.
+    SIZE_T size() const {
+        return entries.size();
+    }
+
+    // Size of the serialized compound in bytes.
+    SIZE_T getByteSize() const {
+        return bytesize;
+    }
+
+    bool hasTag(const TagRef& tag) const {
+        std::vector<Entry>::const_iterator iter =
+            std::lower_bound(entries.begin(),entries.end(),tag,EntryOrder());
+        return((iter != entries.end()) && (EntryOrder::compare(*iter,tag.data,tag.size) == 0));
+    }
+
+    UINT8_T getTypeID(const TagRef& tag) const {
+        return findEntry("BTC::serialize_::BTagCompoundView::getTypeID",tag).type;
+    }
+
+    // Decodes a number and converts it to T.
+    template<typename T>
+    T getValue(const TagRef& tag) const {
+        const Entry& entry = findEntry("BTC::serialize_::BTagCompoundView::getValue",tag);
+        BufferSource is(entry.payload,getElementByteSize(entry.type));
+        switch (entry.type) {
+            case DataTypeID::UINT8: return T(deserializeByte(is));
+            case DataTypeID::UINT16: return T(deserializeShort(is));
+            case DataTypeID::UINT32: return T(deserializeInt(is));
+            case DataTypeID::UINT64: return T(deserializeLong(is));
+            case DataTypeID::FLOAT: return T(deserializeFloat(is));
+            case DataTypeID::DOUBLE: return T(deserializeDouble(is));
+            case DataTypeID::FLOAT_LEGACY: return T(deserializeFloatLegacy(is));
+            case DataTypeID::DOUBLE_LEGACY: return T(deserializeDoubleLegacy(is));
+            default:
+                throw wrong_type_error("BTC::serialize_::BTagCompoundView::getValue", typeName(entry.type));
+        }
+    }
+
+    STRING_T getString(const TagRef& tag) const {
+        const Entry& entry = findEntry("BTC::serialize_::BTagCompoundView::getString",tag);
+        if (entry.type != DataTypeID::STRING) {
+            throw wrong_type_error("BTC::serialize_::BTagCompoundView::getString", typeName(entry.type));
+        }
+        BufferSource is(entry.payload,bytesize-(entry.payload-begin));
+        return deserializeString(is);
+    }
+
+    // View of a number array, sizeof(T) has to match the element size.
+    template<typename T>
+    ArrayView<T> getArray(const TagRef& tag) const {
+        const Entry& entry = findEntry("BTC::serialize_::BTagCompoundView::getArray",tag);
+        if (!isArray(entry.type) || (entry.type == DataTypeID::FLOAT_ARR_LEGACY) ||
+                (entry.type == DataTypeID::DOUBLE_ARR_LEGACY) || isChunkedArray(entry.type) ||
+                (getElementByteSize(entry.type) != sizeof(T))) {
+            throw wrong_type_error("BTC::serialize_::BTagCompoundView::getArray", typeName(entry.type));
+        }
+        BufferSource is(entry.payload,bytesize-(entry.payload-begin));
+        SIZE_T len = deserializeIntVar<SIZE_T>(is);
+        checkLength("BTC::serialize_::BTagCompoundView::getArray",is,len,sizeof(T));
+        return ArrayView<T>(is.current(),len);
+    }
+
+    // Number of elements of an array.
+    SIZE_T getArraySize(const TagRef& tag) const {
+        const Entry& entry = findEntry("BTC::serialize_::BTagCompoundView::getArraySize",tag);
+        if (!isArray(entry.type)) {
+            throw wrong_type_error("BTC::serialize_::BTagCompoundView::getArraySize", typeName(entry.type));
+        }
+        BufferSource is(entry.payload,bytesize-(entry.payload-begin));
+        if (isChunkedArray(entry.type)) {
+            deserializeByte(is);
+        }
+        return deserializeIntVar<SIZE_T>(is);
+    }
+
+    // Copies the elements [first,last) of a number array into out, last is
+    // limited to the size. Chunked arrays only decode the covering chunks.
+    // sizeof(T) has to match the element size.
+    // Returns the number of elements copied.
+    template<typename T>
+    SIZE_T getSlice(const TagRef& tag, SIZE_T first, SIZE_T last, T* out) const {
+        const Entry& entry = findEntry("BTC::serialize_::BTagCompoundView::getSlice",tag);
+        if (!isArray(entry.type) || (entry.type == DataTypeID::FLOAT_ARR_LEGACY) ||
+                (entry.type == DataTypeID::DOUBLE_ARR_LEGACY) ||
+                (getElementByteSize(entry.type) != sizeof(T))) {
+            throw wrong_type_error("BTC::serialize_::BTagCompoundView::getSlice", typeName(entry.type));
+        }
+        SIZE_T size = bytesize-(entry.payload-begin);
+        if (isChunkedArray(entry.type)) {
+            return BTagChunkedArr<T>::readSlice(entry.type,entry.payload,size,first,last,out);
+        }
+        BufferSource is(entry.payload,size);
+        SIZE_T len = deserializeIntVar<SIZE_T>(is);
+        checkLength("BTC::serialize_::BTagCompoundView::getSlice",is,len,sizeof(T));
+        last = std::min(last,len);
+        if (first >= last) {
+            return 0;
+        }
+        ArrayView<T>(is.current()+first*sizeof(T),last-first).copyTo(out);
+        return last-first;
+    }
+
+    BTagCompoundView getCompound(const TagRef& tag) const {
+        const Entry& entry = findEntry("BTC::serialize_::BTagCompoundView::getCompound",tag);
+        if (!isCompound(entry.type)) {
+            throw wrong_type_error("BTC::serialize_::BTagCompoundView::getCompound", typeName(entry.type));
+        }
+        return BTagCompoundView(entry.payload,bytesize-(entry.payload-begin));
+    }
+};
+
+}}
+
+#endif
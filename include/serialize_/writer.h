@@ -0,0 +1,340 @@
+#ifndef BTC_SERIALIZE_WRITER_H
+#define BTC_SERIALIZE_WRITER_H
+
+#include <cstring>
+#include <ostream>
+#include <vector>
+#ifdef DEBUG
+#include <iostream>
+#include <cstdlib>
+#endif
+
+#include "btc.h"
+#include "buffer.h"
+#include "function.h"
+#include "data_type.h"
+#include "exception.h"
+
+namespace BTC {
+namespace serialize_ {
+
+/**
+ * Writes a BTagCompound entry by entry without building it in memory.
+ * The output is read like the output of BTagCompound::serialize().
+ * Counts and byte sizes that are only known at the end of a compound or
+ * an array are written as placeholders of fixed size (an int var of
+ * 9 bytes) and filled in by endCompound() and endArray(). While a
+ * placeholder is still in the buffer it is filled in there, otherwise the
+ * stream has to support seeking (e.g. a file) or stream_error is thrown.
+ * Memory is bounded by the buffer and the nesting depth.
+ * Example:
+ *     BTagWriter writer(file);
+ *     writer.beginCompound();
+ *     writer.writeInt("id",1);
+ *     writer.beginArray("values",DataTypeID::DOUBLE_ARR);
+ *     writer.writeArrayChunk(chunk,n);  // as often as needed
+ *     writer.endArray();
+ *     writer.endCompound();
+ */
+class BTagWriter {
+
+    static const SIZE_T PLACEHOLDER_SIZE = 9;
+    static const UINT64_T NO_OFFSET = UINT64_T(-1);
+
+    // Open compound or array.
+    struct Frame {
+        UINT64_T count_offset;
+        UINT64_T size_offset;
+        UINT64_T count;
+        // 0 for compounds
+        UINT8_T array_type;
+    };
+
+    BufferSink sink;
+    std::ostream* stream;
+    std::streampos start;
+    std::vector<Frame> frames;
+    // State of an open XOR array
+    XorEncoder<FLOAT_T> float_encoder;
+    XorEncoder<DOUBLE_T> double_encoder;
+
+    BTagWriter(const BTagWriter& writer);
+    BTagWriter& operator=(const BTagWriter& writer);
+
+    UINT64_T placeholder() {
+        UINT64_T offset = sink.getByteCount();
+        char bytes[PLACEHOLDER_SIZE] = {0};
+        sink.write(bytes,PLACEHOLDER_SIZE);
+        return offset;
+    }
+
+    // Fills in the placeholder at offset.
+    void patch(UINT64_T offset, UINT64_T value) {
+        char bytes[PLACEHOLDER_SIZE];
+        BufferSink temp(bytes,PLACEHOLDER_SIZE);
+        serializeByte(temp,3);
+        serializeLong(temp,value);
+        UINT64_T buffered = sink.getByteCount()-sink.size();
+        if (offset >= buffered) {
+            std::memcpy(sink.data()+SIZE_T(offset-buffered),bytes,PLACEHOLDER_SIZE);
+            return;
+        }
+        sink.flush();
+        if (start == std::streampos(-1)) {
+            throw stream_error("BTC::serialize_::BTagWriter::patch", "The stream does not support seeking");
+        }
+        std::streampos end = stream->tellp();
+        stream->seekp(start+std::streamoff(offset));
+        stream->write(bytes,PLACEHOLDER_SIZE);
+        stream->seekp(end);
+        if (!(*stream)) {
+            throw stream_error("BTC::serialize_::BTagWriter::patch", "Seeking the stream failed");
+        }
+    }
+
+    void push(UINT64_T count_offset, UINT64_T size_offset, UINT8_T array_type) {
+        Frame frame;
+        frame.count_offset = count_offset;
+        frame.size_offset = size_offset;
+        frame.count = 0;
+        frame.array_type = array_type;
+        frames.push_back(frame);
+    }
+
+    void pop() {
+        const Frame& frame = frames.back();
+        patch(frame.count_offset,frame.count);
+        if (frame.size_offset != NO_OFFSET) {
+            patch(frame.size_offset,sink.getByteCount()-frame.size_offset-PLACEHOLDER_SIZE);
+        }
+        frames.pop_back();
+        if (frames.empty()) {
+            flush();
+        }
+    }
+
+    // Tag and type of a new entry of the current compound.
+    void entry(const STRING_T& tag, UINT8_T type_id) {
+#ifdef DEBUG
+        if(frames.empty() || frames.back().array_type) {
+            std::cout << "Error (serialize_::BTagWriter::entry): No compound open!" << std::endl;
+            exit(1);
+        }
+        if(tag.size() > 255) {
+            std::cout << "Error (serialize_::BTagWriter::entry): Tag too long!" << std::endl;
+            exit(1);
+        }
+#endif
+        serializeString8(sink,tag);
+        serializeByte(sink,type_id);
+        ++frames.back().count;
+    }
+
+    // Elements of the open array.
+    void elements(UINT8_T type_id, SIZE_T n) {
+        if (frames.empty() || (frames.back().array_type != type_id)) {
+            throw wrong_type_error("BTC::serialize_::BTagWriter::writeArrayChunk", "array of another type");
+        }
+        frames.back().count += n;
+    }
+
+  public:
+    // Writes into memory, see data() and size().
+    BTagWriter() : sink(), stream(0), start(-1), frames(), float_encoder(), double_encoder() {}
+
+    // Writes to the stream, starting at its current position.
+    explicit BTagWriter(std::ostream& os, SIZE_T buffer_size = BufferSink::DEFAULT_CAPACITY)
+            : sink(os,buffer_size), stream(&os), start(os.tellp()), frames(),
+              float_encoder(), double_encoder() {
+    }
+
+    // Starts the top level compound.
+    void beginCompound() {
+#ifdef DEBUG
+        if(!frames.empty()) {
+            std::cout << "Error (serialize_::BTagWriter::beginCompound): Compound needs a tag!" << std::endl;
+            exit(1);
+        }
+#endif
+        push(placeholder(),NO_OFFSET,0);
+    }
+
+    // Starts a nested compound.
+    void beginCompound(const STRING_T& tag) {
+        entry(tag,DataTypeID::COMPOUND);
+        UINT64_T size_offset = placeholder();
+        push(placeholder(),size_offset,0);
+    }
+
+    void endCompound() {
+#ifdef DEBUG
+        if(frames.empty() || frames.back().array_type) {
+            std::cout << "Error (serialize_::BTagWriter::endCompound): No compound open!" << std::endl;
+            exit(1);
+        }
+#endif
+        pop();
+    }
+
+    void writeByte(const STRING_T& tag, UINT8_T value) {
+        entry(tag,DataTypeID::UINT8);
+        serializeByte(sink,value);
+    }
+
+    void writeShort(const STRING_T& tag, UINT16_T value) {
+        entry(tag,DataTypeID::UINT16);
+        serializeShort(sink,value);
+    }
+
+    void writeInt(const STRING_T& tag, UINT32_T value) {
+        entry(tag,DataTypeID::UINT32);
+        serializeInt(sink,value);
+    }
+
+    void writeLong(const STRING_T& tag, UINT64_T value) {
+        entry(tag,DataTypeID::UINT64);
+        serializeLong(sink,value);
+    }
+
+    void writeFloat(const STRING_T& tag, FLOAT_T value) {
+        entry(tag,DataTypeID::FLOAT);
+        serializeFloat(sink,value);
+    }
+
+    void writeDouble(const STRING_T& tag, DOUBLE_T value) {
+        entry(tag,DataTypeID::DOUBLE);
+        serializeDouble(sink,value);
+    }
+
+    void writeString(const STRING_T& tag, const STRING_T& value) {
+        entry(tag,DataTypeID::STRING);
+        serializeString(sink,value);
+    }
+
+    // Writes a tag that exists in memory (e.g. one record).
+    void writeTag(const STRING_T& tag, const IBTagBase& value) {
+        entry(tag,value.getTypeID());
+        if (hasByteSize(value.getTypeID())) {
+            serializeIntVar(sink,value.getByteSize());
+        }
+        value.serialize(sink);
+    }
+
+    // Starts an array of the type (one of the current array type IDs or
+    // an XOR array), the elements are written with writeArrayChunk().
+    void beginArray(const STRING_T& tag, UINT8_T type_id) {
+        switch (type_id) {
+            case DataTypeID::STRING_ARR:
+            case DataTypeID::UINT8_ARR:
+            case DataTypeID::UINT16_ARR:
+            case DataTypeID::UINT32_ARR:
+            case DataTypeID::UINT64_ARR:
+            case DataTypeID::FLOAT_ARR:
+            case DataTypeID::DOUBLE_ARR:
+                break;
+            case DataTypeID::XOR_FLOAT_ARR:
+            case DataTypeID::XOR_DOUBLE_ARR:
+                // The length comes before the byte size of the bits
+                float_encoder.reset();
+                double_encoder.reset();
+                entry(tag,type_id);
+                {
+                    UINT64_T count_offset = placeholder();
+                    push(count_offset,placeholder(),type_id);
+                }
+                return;
+            default:
+                throw unknown_type_error("BTC::serialize_::BTagWriter::beginArray", type_id);
+        }
+        entry(tag,type_id);
+        UINT64_T size_offset = hasByteSize(type_id) ? placeholder() : NO_OFFSET;
+        push(placeholder(),size_offset,type_id);
+    }
+
+    // Integers are converted to the element type of the array.
+    // Throws wrong_type_error if the open array does not hold integers.
+    template<typename T>
+    void writeArrayChunk(const T* data, SIZE_T n) {
+        if (frames.empty()) {
+            throw wrong_type_error("BTC::serialize_::BTagWriter::writeArrayChunk", "no array");
+        }
+        UINT8_T type_id = frames.back().array_type;
+        elements(type_id,n);
+        switch (type_id) {
+            case DataTypeID::UINT8_ARR: serializeWordArrayData<UINT8_T>(sink,n,data); break;
+            case DataTypeID::UINT16_ARR: serializeWordArrayData<UINT16_T>(sink,n,data); break;
+            case DataTypeID::UINT32_ARR: serializeWordArrayData<UINT32_T>(sink,n,data); break;
+            case DataTypeID::UINT64_ARR: serializeWordArrayData<UINT64_T>(sink,n,data); break;
+            default:
+                frames.back().count -= n;
+                throw wrong_type_error("BTC::serialize_::BTagWriter::writeArrayChunk", "array of another type");
+        }
+    }
+
+    void writeArrayChunk(const FLOAT_T* data, SIZE_T n) {
+        if (!frames.empty() && (frames.back().array_type == DataTypeID::XOR_FLOAT_ARR)) {
+            elements(DataTypeID::XOR_FLOAT_ARR,n);
+            for (SIZE_T i=0; i<n; ++i) {
+                float_encoder.encode(sink,data[i]);
+            }
+            return;
+        }
+        elements(DataTypeID::FLOAT_ARR,n);
+        serializeBitArrayData<UINT32_T>(sink,n,data);
+    }
+
+    void writeArrayChunk(const DOUBLE_T* data, SIZE_T n) {
+        if (!frames.empty() && (frames.back().array_type == DataTypeID::XOR_DOUBLE_ARR)) {
+            elements(DataTypeID::XOR_DOUBLE_ARR,n);
+            for (SIZE_T i=0; i<n; ++i) {
+                double_encoder.encode(sink,data[i]);
+            }
+            return;
+        }
+        elements(DataTypeID::DOUBLE_ARR,n);
+        serializeBitArrayData<UINT64_T>(sink,n,data);
+    }
+
+    void writeArrayChunk(const STRING_T* data, SIZE_T n) {
+        elements(DataTypeID::STRING_ARR,n);
+        for (SIZE_T i=0; i<n; ++i) {
+            serializeString(sink,data[i]);
+        }
+    }
+
+    void endArray() {
+#ifdef DEBUG
+        if(frames.empty() || !frames.back().array_type) {
+            std::cout << "Error (serialize_::BTagWriter::endArray): No array open!" << std::endl;
+            exit(1);
+        }
+#endif
+        if (frames.back().array_type == DataTypeID::XOR_FLOAT_ARR) {
+            float_encoder.finish(sink);
+        } else if (frames.back().array_type == DataTypeID::XOR_DOUBLE_ARR) {
+            double_encoder.finish(sink);
+        }
+        pop();
+    }
+
+    // Writes the buffer to the stream (done after the top level compound).
+    void flush() {
+        sink.flush();
+        if (stream) {
+            stream->flush();
+        }
+    }
+
+    // The output when writing into memory.
+    const char* data() const {
+        return sink.data();
+    }
+
+    SIZE_T size() const {
+        return sink.size();
+    }
+};
+
+}}
+
+#endif
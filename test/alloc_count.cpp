@@ -0,0 +1,30 @@
+#include <cstdlib>
+#include <new>
+
+// Replaces the global operator new to count the allocations of the
+// benchmark. Kept in its own file so that the compiler does not inline
+// it into the library code. Needs C++11 (the benchmark reports 0 else).
+static size_t allocations = 0;
+
+size_t allocationCount() {
+    return allocations;
+}
+
+#if __cplusplus >= 201103L
+void* operator new(std::size_t n) {
+    ++allocations;
+    void* p = std::malloc(n ? n : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+#endif
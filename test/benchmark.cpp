@@ -0,0 +1,622 @@
+#include <sstream>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <ctime>
+#include <cstdlib>
+
+#include "BTC.h"
+
+// Number of calls of the global operator new (see alloc_count.cpp).
+size_t allocationCount();
+
+// Time per repetition in microseconds.
+double elapsed(std::clock_t start, size_t reps) {
+    return (double(std::clock()-start)/CLOCKS_PER_SEC)*1.e6/reps;
+}
+
+std::vector<std::string> makeKeys(size_t n) {
+    std::vector<std::string> keys(n);
+    for (size_t i=0; i<n; ++i) {
+        std::ostringstream ss;
+        ss << "key_" << (i*2654435761u)%1000003;
+        keys[i] = ss.str();
+    }
+    return keys;
+}
+
+void benchInsert(size_t n) {
+    std::vector<std::string> keys = makeKeys(n);
+    size_t reps = 1+200000/n;
+    // One by one
+    std::clock_t start = std::clock();
+    for (size_t r=0; r<reps; ++r) {
+        BTC::BTagCompound comp;
+        for (size_t i=0; i<n; ++i) {
+            comp.setInt(keys[i],BTC::UINT32_T(i));
+        }
+    }
+    double single = elapsed(start,reps);
+    // Bulk
+    start = std::clock();
+    for (size_t r=0; r<reps; ++r) {
+        BTC::BTagCompound comp;
+        comp.beginBulkInsert(n);
+        for (size_t i=0; i<n; ++i) {
+            comp.setInt(keys[i],BTC::UINT32_T(i));
+        }
+        comp.endBulkInsert();
+    }
+    double bulk = elapsed(start,reps);
+    std::cout << "insert n=" << n << ": setTag " << single << " us, bulk " << 
+        bulk << " us" << std::endl;
+}
+
+// Looks up every key once by a string literal style pointer, with binary
+// search and with the hash index.
+void benchLookup(size_t n) {
+    std::vector<std::string> keys = makeKeys(n);
+    size_t reps = 1+2000000/n;
+    BTC::BTagCompound comp;
+    for (size_t i=0; i<n; ++i) {
+        comp.setInt(keys[i],BTC::UINT32_T(i));
+    }
+    double time[2];
+    BTC::UINT64_T sum = 0;
+    for (int h=0; h<2; ++h) {
+        comp.setHashIndex(h == 1);
+        std::clock_t start = std::clock();
+        for (size_t r=0; r<reps; ++r) {
+            for (size_t i=0; i<n; ++i) {
+                sum += comp.getValue<BTC::UINT32_T>(keys[i].c_str());
+            }
+        }
+        time[h] = elapsed(start,reps*n)*1000.;
+    }
+    std::cout << "lookup n=" << n << ": binary search " << time[0] << " ns, hash " <<
+        time[1] << " ns (" << sum%10 << ")" << std::endl;
+}
+
+// Reads three tags from many compounds with the same layout, by literal
+// and by precompiled key.
+void benchKey(size_t n) {
+    std::vector<BTC::BTagCompound> comps(n);
+    for (size_t i=0; i<n; ++i) {
+        comps[i].setInt("row",BTC::UINT32_T(i));
+        comps[i].setInt("col",BTC::UINT32_T(i));
+        comps[i].setInt("data",BTC::UINT32_T(i));
+    }
+    size_t reps = 1+2000000/n;
+    BTC::UINT64_T sum = 0;
+    std::clock_t start = std::clock();
+    for (size_t r=0; r<reps; ++r) {
+        for (size_t i=0; i<n; ++i) {
+            sum += comps[i].getValue<BTC::UINT32_T>("row");
+            sum += comps[i].getValue<BTC::UINT32_T>("col");
+            sum += comps[i].getValue<BTC::UINT32_T>("data");
+        }
+    }
+    double literal = elapsed(start,3*reps*n)*1000.;
+    const BTC::BTagCompound::Key row("row"), col("col"), data("data");
+    start = std::clock();
+    for (size_t r=0; r<reps; ++r) {
+        for (size_t i=0; i<n; ++i) {
+            sum += comps[i].getValue<BTC::UINT32_T>(row);
+            sum += comps[i].getValue<BTC::UINT32_T>(col);
+            sum += comps[i].getValue<BTC::UINT32_T>(data);
+        }
+    }
+    double key = elapsed(start,3*reps*n)*1000.;
+    std::cout << "key n=" << n << ": literal " << literal << " ns, key " <<
+        key << " ns (" << sum%10 << ")" << std::endl;
+}
+
+// Serializes and deserializes a record of n numbers.
+void benchScalars(size_t n) {
+    std::vector<std::string> keys = makeKeys(n);
+    BTC::BTagCompound comp;
+    for (size_t i=0; i<n; ++i) {
+        if (i%2) {
+            comp.setInt(keys[i],BTC::UINT32_T(i));
+        } else {
+            comp.setDouble(keys[i],BTC::DOUBLE_T(i));
+        }
+    }
+    std::vector<char> buffer;
+    comp.serializeTo(buffer);
+    size_t reps = 1+2000000/n;
+    std::clock_t start = std::clock();
+    for (size_t r=0; r<reps; ++r) {
+        BTC::BTagCompound other;
+        other.deserializeFrom(&buffer[0],buffer.size());
+    }
+    double time = elapsed(start,reps);
+    std::cout << "scalars n=" << n << ": deserialize " << time << " us" << std::endl;
+}
+
+// Deserializes a tree of n compounds holding arrays, with and without
+// an arena.
+void benchArena(size_t n) {
+    BTC::BTagCompound comp;
+    std::vector<BTC::UINT32_T> ints(64,1);
+    std::vector<BTC::DOUBLE_T> doubles(64,1.);
+    for (size_t i=0; i<n; ++i) {
+        BTC::BTagCompoundPtr child(new BTC::BTagCompound());
+        child->setIntArray("ints",&ints[0],ints.size());
+        child->setDoubleArray("doubles",&doubles[0],doubles.size());
+        std::ostringstream ss;
+        ss << "c" << i;
+        comp.setTag(ss.str(),child);
+    }
+    std::vector<char> buffer;
+    comp.serializeTo(buffer);
+    size_t reps = 1+20000/n;
+    double time[2];
+    size_t allocs[2];
+    BTC::container_::Arena arena;
+    for (int a=0; a<2; ++a) {
+        size_t before = allocationCount();
+        std::clock_t start = std::clock();
+        for (size_t r=0; r<reps; ++r) {
+            BTC::BTagCompound other;
+            if (a) {
+                other.deserializeFrom(&buffer[0],buffer.size(),arena);
+            } else {
+                other.deserializeFrom(&buffer[0],buffer.size());
+            }
+            other.clear();
+            arena.release();
+        }
+        time[a] = elapsed(start,reps);
+        allocs[a] = (allocationCount()-before)/reps;
+    }
+    std::cout << "arena n=" << n << ": new[] " << time[0] << " us (" << allocs[0] << 
+        " allocations), arena " << time[1] << " us (" << allocs[1] << " allocations)" << std::endl;
+}
+
+// Reads one element of a large array, deserializing everything and
+// through a view.
+void benchView(size_t n) {
+    std::vector<BTC::DOUBLE_T> doubles(n,0.5);
+    BTC::BTagCompound comp;
+    comp.setDoubleArray("doubles",&doubles[0],n);
+    comp.setInt("count",BTC::UINT32_T(n));
+    std::vector<char> buffer;
+    comp.serializeTo(buffer);
+    size_t reps = 20;
+    double sum = 0;
+    std::clock_t start = std::clock();
+    for (size_t r=0; r<reps; ++r) {
+        BTC::BTagCompound other;
+        other.deserializeFrom(&buffer[0],buffer.size());
+        BTC::SIZE_T len;
+        sum += other.getArray<BTC::DOUBLE_T>("doubles",len)[n/2];
+    }
+    double full = elapsed(start,reps);
+    start = std::clock();
+    for (size_t r=0; r<reps; ++r) {
+        BTC::BTagCompoundView view(&buffer[0],buffer.size());
+        sum += view.getArray<BTC::DOUBLE_T>("doubles")[n/2];
+    }
+    double view = elapsed(start,reps);
+    std::cout << "view n=" << n << ": deserialize " << full << " us, view " << view << 
+        " us (" << sum << ")" << std::endl;
+}
+
+// Deserializes a tree of n compounds with arrays (about 1 MB) and reads
+// every 20th of them, eagerly and lazily.
+void benchLazy(size_t n) {
+    BTC::BTagCompound comp;
+    std::vector<BTC::UINT32_T> ints(200,1);
+    std::vector<std::string> keys = makeKeys(n);
+    BTC::BTagCompound child;
+    child.setIntArray("ints",&ints[0],ints.size());
+    for (size_t i=0; i<n; ++i) {
+        child.setInt("id",BTC::UINT32_T(i));
+        comp.setTag(keys[i],BTC::ptr_::SharedObjPtr<BTC::serialize_::IBTagBase>(
+                    new BTC::BTagCompound(child)));
+    }
+    std::vector<char> buffer;
+    comp.serializeTo(buffer);
+    size_t reps = 50;
+    double time[2];
+    BTC::UINT64_T sum = 0;
+    for (int l=0; l<2; ++l) {
+        std::clock_t start = std::clock();
+        for (size_t r=0; r<reps; ++r) {
+            BTC::BTagCompound other;
+            if (l) {
+                other.deserializeLazy(&buffer[0],buffer.size());
+            } else {
+                other.deserializeFrom(&buffer[0],buffer.size());
+            }
+            for (size_t i=0; i<n; i+=20) {
+                sum += other.getTag<BTC::BTagCompound>(keys[i])->getValue<BTC::UINT32_T>("id");
+            }
+        }
+        time[l] = elapsed(start,reps);
+    }
+    std::cout << "lazy " << buffer.size() << " bytes: eager " << time[0] << " us, lazy " << 
+        time[1] << " us (" << sum%10 << ")" << std::endl;
+}
+
+// A record of 200 fields of which 3 are read.
+void benchProjection(size_t reps) {
+    std::vector<BTC::DOUBLE_T> doubles(100,0.5);
+    std::vector<std::string> keys = makeKeys(200);
+    BTC::BTagCompound inner;
+    inner.setDoubleArray("doubarr",&doubles[0],doubles.size());
+    inner.setInt("other",1);
+    BTC::BTagCompound record;
+    record.setTag("inner_tag",BTC::ptr_::SharedObjPtr<BTC::serialize_::IBTagBase>(
+                new BTC::BTagCompound(inner)));
+    record.setInt("integer",42);
+    for (size_t i=2; i<200; ++i) {
+        if (i%4 == 0) {
+            record.setDoubleArray(keys[i],&doubles[0],doubles.size());
+        } else {
+            record.setString(keys[i],keys[i]);
+        }
+    }
+    std::vector<char> buffer;
+    record.serializeTo(buffer);
+    std::string paths[] = {"inner_tag.doubarr","integer",keys[3]};
+    BTC::Projection projection(paths,3);
+    double time[2];
+    BTC::UINT64_T sum = 0;
+    for (int l=0; l<2; ++l) {
+        std::clock_t start = std::clock();
+        for (size_t r=0; r<reps; ++r) {
+            BTC::BTagCompound other;
+            if (l) {
+                other.deserializeFrom(&buffer[0],buffer.size(),projection);
+            } else {
+                other.deserializeFrom(&buffer[0],buffer.size());
+            }
+            sum += other.getValue<BTC::UINT32_T>("integer");
+        }
+        time[l] = elapsed(start,reps);
+    }
+    std::cout << "projection 3 of 200: full " << time[0] << " us, projection " << 
+        time[1] << " us (" << sum%10 << ")" << std::endl;
+}
+
+// Sums all integers of a tree.
+struct IntSum : BTC::BTagHandler {
+    BTC::UINT64_T sum;
+
+    IntSum() : sum(0) {}
+
+    void intValue(BTC::UINT32_T value) {
+        sum += value;
+    }
+
+    void intChunk(const BTC::UINT32_T* data, BTC::SIZE_T n) {
+        for (BTC::SIZE_T i=0; i<n; ++i) {
+            sum += data[i];
+        }
+    }
+};
+
+// Visits every value once: deserialize the tree or read it as events.
+void benchReader(size_t n) {
+    BTC::BTagCompound comp;
+    std::vector<BTC::UINT32_T> ints(200,1);
+    std::vector<std::string> keys = makeKeys(n);
+    BTC::BTagCompound child;
+    child.setIntArray("ints",&ints[0],ints.size());
+    child.setString("name",std::string("child"));
+    for (size_t i=0; i<n; ++i) {
+        child.setInt("id",BTC::UINT32_T(i));
+        comp.setTag(keys[i],BTC::ptr_::SharedObjPtr<BTC::serialize_::IBTagBase>(
+                    new BTC::BTagCompound(child)));
+    }
+    std::vector<char> buffer;
+    comp.serializeTo(buffer);
+    size_t reps = 50;
+    std::clock_t start = std::clock();
+    for (size_t r=0; r<reps; ++r) {
+        BTC::BTagCompound other;
+        other.deserializeFrom(&buffer[0],buffer.size());
+    }
+    double tree = elapsed(start,reps);
+    BTC::BTagReader reader;
+    IntSum handler;
+    start = std::clock();
+    for (size_t r=0; r<reps; ++r) {
+        BTC::BufferSource source(&buffer[0],buffer.size());
+        reader.read(source,handler);
+    }
+    double events = elapsed(start,reps);
+    std::cout << "reader " << buffer.size() << " bytes: deserialize " << tree << 
+        " us, events " << events << " us (" << handler.sum%10 << ")" << std::endl;
+}
+
+// Writes n records with a double array each: built as one tree and
+// serialized, or written entry by entry.
+void benchWriter(size_t n) {
+    std::vector<std::string> keys = makeKeys(n);
+    std::vector<BTC::DOUBLE_T> doubles(100,0.5);
+    std::ostringstream tree_out;
+    size_t count = allocationCount();
+    std::clock_t start = std::clock();
+    {
+        BTC::BTagCompound comp;
+        for (size_t i=0; i<n; ++i) {
+            BTC::BTagCompound record;
+            record.setLong("id",BTC::UINT64_T(i));
+            record.setDoubleArray("values",&doubles[0],doubles.size());
+            comp.setTag(keys[i],BTC::ptr_::SharedObjPtr<BTC::serialize_::IBTagBase>(
+                        new BTC::BTagCompound(record)));
+        }
+        comp.serialize(tree_out);
+    }
+    double tree = elapsed(start,1);
+    size_t tree_count = allocationCount()-count;
+    std::ostringstream writer_out;
+    count = allocationCount();
+    start = std::clock();
+    {
+        BTC::BTagWriter writer(writer_out);
+        writer.beginCompound();
+        for (size_t i=0; i<n; ++i) {
+            writer.beginCompound(keys[i]);
+            writer.writeLong("id",BTC::UINT64_T(i));
+            writer.beginArray("values",BTC::serialize_::DataTypeID::DOUBLE_ARR);
+            writer.writeArrayChunk(&doubles[0],doubles.size());
+            writer.endArray();
+            writer.endCompound();
+        }
+        writer.endCompound();
+    }
+    double events = elapsed(start,1);
+    size_t writer_count = allocationCount()-count;
+    std::cout << "writer n=" << n << ": tree " << tree << " us (" << tree_count << 
+        " allocations), writer " << events << " us (" << writer_count << 
+        " allocations, " << writer_out.str().size() << " bytes)" << std::endl;
+}
+
+// Reads a window of 1000 elements of a chunked double array.
+void benchSlice(size_t n) {
+    std::vector<BTC::DOUBLE_T> doubles(n);
+    for (size_t i=0; i<n; ++i) {
+        doubles[i] = BTC::DOUBLE_T(i);
+    }
+    BTC::BTagCompound comp;
+    comp.setChunkedArray("series",BTC::serialize_::DataTypeID::DOUBLE_ARR,&doubles[0],n);
+    std::vector<char> buffer;
+    comp.serializeTo(buffer);
+    std::clock_t start = std::clock();
+    BTC::BTagCompound other;
+    other.deserializeFrom(&buffer[0],buffer.size());
+    double full = elapsed(start,1);
+    size_t reps = 10000;
+    std::vector<BTC::DOUBLE_T> window(1000);
+    BTC::DOUBLE_T sum = 0;
+    start = std::clock();
+    for (size_t r=0; r<reps; ++r) {
+        BTC::BTagCompoundView view(&buffer[0],buffer.size());
+        view.getSlice("series",n/2+r,n/2+r+window.size(),&window[0]);
+        sum += window[0];
+    }
+    double slice = elapsed(start,reps);
+    std::cout << "slice n=" << n << ": deserialize " << full << " us, window " << 
+        slice << " us (" << sum << ")" << std::endl;
+}
+
+// Millisecond timestamps as a plain long array and delta encoded: size
+// and time to deserialize.
+void benchDelta(size_t n) {
+    std::vector<BTC::UINT64_T> stamps(n);
+    for (size_t i=0; i<n; ++i) {
+        stamps[i] = BTC::UINT64_T(1700000000)*1000+i*250+(i*7919)%100;
+    }
+    BTC::BTagCompound plain;
+    plain.setLongArray("t",&stamps[0],n);
+    BTC::BTagCompound delta;
+    delta.setDeltaArray("t",&stamps[0],n);
+    std::vector<char> plain_buffer;
+    std::vector<char> delta_buffer;
+    plain.serializeTo(plain_buffer);
+    delta.serializeTo(delta_buffer);
+    size_t reps = 10;
+    std::clock_t start = std::clock();
+    for (size_t r=0; r<reps; ++r) {
+        BTC::BTagCompound other;
+        other.deserializeFrom(&plain_buffer[0],plain_buffer.size());
+    }
+    double plain_time = elapsed(start,reps);
+    start = std::clock();
+    for (size_t r=0; r<reps; ++r) {
+        BTC::BTagCompound other;
+        other.deserializeFrom(&delta_buffer[0],delta_buffer.size());
+    }
+    double delta_time = elapsed(start,reps);
+    std::cout << "delta n=" << n << ": plain " << plain_buffer.size() << " bytes " << 
+        plain_time << " us, delta " << delta_buffer.size() << " bytes " << 
+        delta_time << " us" << std::endl;
+}
+
+// Category codes (0-199) as a plain int array and bit-packed: size and
+// time to deserialize.
+void benchPacked(size_t n) {
+    std::vector<BTC::UINT32_T> codes(n);
+    for (size_t i=0; i<n; ++i) {
+        codes[i] = BTC::UINT32_T((i*7919)%200);
+    }
+    BTC::BTagCompound plain;
+    plain.setIntArray("c",&codes[0],n);
+    BTC::BTagCompound packed;
+    packed.setPackedArray("c",&codes[0],n);
+    std::vector<char> plain_buffer;
+    std::vector<char> packed_buffer;
+    plain.serializeTo(plain_buffer);
+    packed.serializeTo(packed_buffer);
+    size_t reps = 10;
+    std::clock_t start = std::clock();
+    for (size_t r=0; r<reps; ++r) {
+        BTC::BTagCompound other;
+        other.deserializeFrom(&plain_buffer[0],plain_buffer.size());
+    }
+    double plain_time = elapsed(start,reps);
+    start = std::clock();
+    for (size_t r=0; r<reps; ++r) {
+        BTC::BTagCompound other;
+        other.deserializeFrom(&packed_buffer[0],packed_buffer.size());
+    }
+    double packed_time = elapsed(start,reps);
+    std::cout << "packed n=" << n << ": plain " << plain_buffer.size() << " bytes " << 
+        plain_time << " us, packed " << packed_buffer.size() << " bytes " << 
+        packed_time << " us (" << n*4/packed_time/1000 << " GB/s)" << std::endl;
+}
+
+// Sensor series as a plain double array and XOR encoded: size and 
+// throughput of serializing and deserializing. The readings change in
+// steps of 0.25 every few samples.
+void benchXor(size_t n) {
+    std::vector<BTC::DOUBLE_T> series(n);
+    for (size_t i=0; i<n; ++i) {
+        series[i] = 20+0.25*BTC::DOUBLE_T(((i/8)*7919)%16);
+    }
+    BTC::BTagCompound plain;
+    plain.setDoubleArray("s",&series[0],n);
+    BTC::BTagCompound compressed;
+    compressed.setXorArray("s",&series[0],n);
+    std::vector<char> plain_buffer;
+    std::vector<char> xor_buffer;
+    plain.serializeTo(plain_buffer);
+    size_t reps = 10;
+    std::clock_t start = std::clock();
+    for (size_t r=0; r<reps; ++r) {
+        compressed.serializeTo(xor_buffer);
+    }
+    double encode = elapsed(start,reps);
+    start = std::clock();
+    for (size_t r=0; r<reps; ++r) {
+        BTC::BTagCompound other;
+        other.deserializeFrom(&xor_buffer[0],xor_buffer.size());
+    }
+    double decode = elapsed(start,reps);
+    std::cout << "xor n=" << n << ": plain " << plain_buffer.size() << " bytes, xor " << 
+        xor_buffer.size() << " bytes, encode " << n*8/encode << " MB/s, decode " << 
+        n*8/decode << " MB/s" << std::endl;
+}
+
+// Reads the last of n records: from a plain concatenation every record
+// before it has to be deserialized, the record log seeks with its index.
+void benchRecordLog(size_t n) {
+    std::ostringstream plain;
+    std::ostringstream log;
+    {
+        BTC::RecordLogWriter writer(log);
+        for (size_t i=0; i<n; ++i) {
+            BTC::BTagCompound record;
+            record.setLong("id",BTC::UINT64_T(i));
+            record.setString("name",std::string("record"));
+            record.serialize(plain);
+            writer.append(record);
+        }
+    }
+    std::string plain_data = plain.str();
+    std::string log_data = log.str();
+    std::clock_t start = std::clock();
+    BTC::UINT64_T sum = 0;
+    {
+        BTC::BufferSource source(plain_data.data(),plain_data.size());
+        BTC::BTagCompound record;
+        for (size_t i=0; i<n; ++i) {
+            record.clear();
+            record.deserialize(source);
+        }
+        sum += record.getValue<BTC::UINT64_T>("id");
+    }
+    double scan = elapsed(start,1);
+    size_t reps = 1000;
+    start = std::clock();
+    for (size_t r=0; r<reps; ++r) {
+        BTC::RecordLogReader reader(log_data.data(),log_data.size());
+        BTC::BTagCompound record;
+        reader.read(n-1-r,record);
+        sum += record.getValue<BTC::UINT64_T>("id");
+    }
+    double seek = elapsed(start,reps);
+    std::cout << "record log n=" << n << ": scan " << scan << " us, open and seek " << 
+        seek << " us (" << sum%10 << ")" << std::endl;
+}
+
+// Compound with fanout nested compounds per level, each with a string,
+// a small array and a number.
+BTC::BTagCompound makeTree(size_t depth, size_t fanout) {
+    BTC::BTagCompound comp;
+    BTC::UINT32_T values[4] = {1,2,3,4};
+    comp.setInt("id",BTC::UINT32_T(depth));
+    comp.setString("name",std::string("node"));
+    comp.setIntArray("values",values,4);
+    if (depth > 0) {
+        for (size_t i=0; i<fanout; ++i) {
+            std::ostringstream tag;
+            tag << "child_" << i;
+            comp.setTag(tag.str(),BTC::ptr_::SharedObjPtr<BTC::serialize_::IBTagBase>(
+                        new BTC::BTagCompound(makeTree(depth-1,fanout))));
+        }
+    }
+    return comp;
+}
+
+void benchDeepTree(size_t depth, size_t fanout) {
+    std::string data;
+    {
+        std::ostringstream out;
+        makeTree(depth,fanout).serialize(out);
+        data = out.str();
+    }
+    size_t reps = 200;
+    size_t count = allocationCount();
+    std::clock_t start = std::clock();
+    for (size_t r=0; r<reps; ++r) {
+        BTC::BTagCompound comp;
+        comp.deserializeFrom(data.data(),data.size());
+    }
+    double time = elapsed(start,reps);
+    size_t allocs = (allocationCount()-count)/reps;
+    // serializing again into the same buffer and list of sizes
+    BTC::BTagCompound comp;
+    comp.deserializeFrom(data.data(),data.size());
+    std::vector<char> buffer;
+    std::vector<BTC::SIZE_T> sizes;
+    comp.serializeTo(buffer,sizes);
+    count = allocationCount();
+    start = std::clock();
+    for (size_t r=0; r<reps; ++r) {
+        comp.serializeTo(buffer,sizes);
+    }
+    double serialize_time = elapsed(start,reps);
+    size_t serialize_allocs = (allocationCount()-count)/reps;
+    std::cout << "deep tree depth=" << depth << " fanout=" << fanout << ": deserialize " <<
+        time << " us (" << allocs << " allocations), serializeTo " << serialize_time << 
+        " us (" << serialize_allocs << " allocations)" << std::endl;
+}
+
+int main() {
+    benchInsert(10);
+    benchInsert(1000);
+    benchInsert(100000);
+    benchLookup(10);
+    benchLookup(1000);
+    benchLookup(100000);
+    benchKey(100000);
+    benchScalars(1000);
+    benchArena(1000);
+    benchView(10000000);
+    benchLazy(1200);
+    benchProjection(2000);
+    benchReader(1200);
+    benchWriter(100000);
+    benchSlice(10000000);
+    benchDelta(1000000);
+    benchPacked(1000000);
+    benchXor(1000000);
+    benchRecordLog(100000);
+    benchDeepTree(4,6);
+    return 0;
+}
@@ -0,0 +1,189 @@
+#include <sstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <mutex>
+
+#include "BTC.h"
+
+// Wall clock time in milliseconds (std::clock() adds up all threads).
+double elapsed(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+}
+
+std::string makeLog(size_t n) {
+    std::ostringstream log;
+    BTC::RecordLogWriter writer(log);
+    for (size_t i=0; i<n; ++i) {
+        BTC::BTagCompound record;
+        record.setLong("id",BTC::UINT64_T(i));
+        record.setString("name",std::string("record"));
+        BTC::UINT32_T values[64];
+        for (size_t j=0; j<64; ++j) {
+            values[j] = BTC::UINT32_T(i+j);
+        }
+        record.setIntArray("values",values,64);
+        writer.append(record);
+    }
+    writer.close();
+    return log.str();
+}
+
+void benchDecode(const std::string& data, unsigned nthreads, bool ordered) {
+    BTC::RecordLogReader reader(data.data(),data.size());
+    std::atomic<BTC::UINT64_T> sum(0);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    BTC::parallelDecode(reader,nthreads,[&](BTC::SIZE_T k, const BTC::BTagCompound& record) {
+        sum += record.getValue<BTC::UINT64_T>("id");
+    },ordered);
+    double time = elapsed(start);
+    std::cout << "decode n=" << reader.size() << " threads=" << nthreads <<
+        (ordered ? " ordered: " : " unordered: ") << time << " ms (" << sum%10 << ")" << std::endl;
+}
+
+void benchSerialize(size_t n, unsigned nthreads) {
+    std::vector<BTC::DOUBLE_T> values(n);
+    for (size_t i=0; i<n; ++i) {
+        values[i] = 0.5*i;
+    }
+    BTC::BTagCompound comp;
+    comp.setDoubleArray("a",&values[0],n);
+    comp.setDoubleArray("b",&values[0],n);
+    comp.setDoubleArray("c",&values[0],n);
+    comp.setDoubleArray("d",&values[0],n);
+    std::vector<char> buffer;
+    comp.serializeTo(buffer);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    comp.serializeTo(buffer);
+    double single = elapsed(start);
+    start = std::chrono::steady_clock::now();
+    BTC::parallelSerialize(comp,buffer,nthreads);
+    double parallel = elapsed(start);
+    std::cout << "serialize 4x" << n << " doubles threads=" << nthreads << ": serializeTo " <<
+        single << " ms, parallelSerialize " << parallel << " ms" << std::endl;
+}
+
+// Readers share one tree (needs ATOMIC_REFCOUNT, see the Makefile).
+void benchSharedTree(unsigned nthreads) {
+    BTC::BTagCompoundPtr config(new BTC::BTagCompound());
+    for (size_t i=0; i<100; ++i) {
+        std::ostringstream tag;
+        tag << "section_" << i;
+        BTC::BTagCompound section;
+        section.setInt("id",BTC::UINT32_T(i));
+        section.setString("name",tag.str());
+        config->setTag(tag.str(),BTC::BTagCompoundPtr(new BTC::BTagCompound(section)));
+    }
+    BTC::BTagCompoundConstPtr shared(config);
+    std::atomic<BTC::UINT64_T> sum(0);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (unsigned t=0; t<nthreads; ++t) {
+        threads.push_back(std::thread([&]() {
+            BTC::BTagCompoundConstPtr tree(shared);
+            BTC::UINT64_T local = 0;
+            for (size_t r=0; r<100000/nthreads; ++r) {
+                std::ostringstream tag;
+                tag << "section_" << r%100;
+                BTC::BTagCompoundConstPtr section = tree->getTag<BTC::BTagCompound>(tag.str());
+                local += section->getValue<BTC::UINT32_T>("id");
+            }
+            sum += local;
+        }));
+    }
+    for (size_t t=0; t<threads.size(); ++t) {
+        threads[t].join();
+    }
+    std::cout << "shared tree threads=" << nthreads << ": 100000 lookups " << elapsed(start) <<
+        " ms (" << sum%10 << ")" << std::endl;
+}
+
+// Readers of live settings: a global mutex around every read against
+// snapshots; and the cost of one change (the path is copied).
+void benchSnapshots(unsigned nthreads) {
+    BTC::BTagCompound settings;
+    for (size_t i=0; i<100; ++i) {
+        std::ostringstream tag;
+        tag << "section_" << i;
+        BTC::BTagCompound section;
+        for (size_t j=0; j<100; ++j) {
+            std::ostringstream key;
+            key << "value_" << j;
+            section.setInt(key.str(),BTC::UINT32_T(j));
+        }
+        settings.setTag(tag.str(),BTC::BTagCompoundPtr(new BTC::BTagCompound(section)));
+    }
+    settings.setInt("limit",1u);
+    const size_t reads = 1000000/nthreads;
+    std::mutex mutex;
+    std::atomic<BTC::UINT64_T> sum(0);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (unsigned t=0; t<nthreads; ++t) {
+        threads.push_back(std::thread([&]() {
+            BTC::UINT64_T local = 0;
+            for (size_t r=0; r<reads; ++r) {
+                std::lock_guard<std::mutex> lock(mutex);
+                local += settings.getValue<BTC::UINT32_T>("limit");
+            }
+            sum += local;
+        }));
+    }
+    for (size_t t=0; t<threads.size(); ++t) {
+        threads[t].join();
+    }
+    double locked = elapsed(start);
+    BTC::SharedCompound shared(settings);
+    threads.clear();
+    start = std::chrono::steady_clock::now();
+    for (unsigned t=0; t<nthreads; ++t) {
+        threads.push_back(std::thread([&]() {
+            BTC::SnapshotReader reader(shared);
+            BTC::UINT64_T local = 0;
+            for (size_t r=0; r<reads; ++r) {
+                local += reader.get().getValue<BTC::UINT32_T>("limit");
+            }
+            sum += local;
+        }));
+    }
+    for (size_t t=0; t<threads.size(); ++t) {
+        threads[t].join();
+    }
+    double snapshots = elapsed(start);
+    size_t reps = 1000;
+    BTC::SnapshotWriter writer(shared);
+    start = std::chrono::steady_clock::now();
+    for (size_t r=0; r<reps; ++r) {
+        writer.edit("section_42").setInt("value_7",BTC::UINT32_T(r));
+        writer.publish();
+    }
+    double change = elapsed(start)*1000/reps;
+    start = std::chrono::steady_clock::now();
+    for (size_t r=0; r<reps/10; ++r) {
+        std::vector<char> copy;
+        settings.serializeTo(copy);
+        BTC::BTagCompound deep;
+        deep.deserializeFrom(&copy[0],copy.size());
+    }
+    double deep = elapsed(start)*1000/(reps/10);
+    std::cout << "settings threads=" << nthreads << ": 1M reads with mutex " << locked <<
+        " ms, snapshots " << snapshots << " ms; change " << change << " us, deep copy " <<
+        deep << " us (" << sum%10 << ")" << std::endl;
+}
+
+int main() {
+    std::string data = makeLog(200000);
+    unsigned cores = std::max(1u,std::thread::hardware_concurrency());
+    std::cout << "hardware threads: " << cores << std::endl;
+    for (unsigned nthreads=1; nthreads<=cores; nthreads*=2) {
+        benchDecode(data,nthreads,false);
+        benchDecode(data,nthreads,true);
+        benchSerialize(10000000,nthreads);
+        benchSharedTree(nthreads);
+        benchSnapshots(nthreads);
+    }
+    return 0;
+}
@@ -63,15 +63,26 @@ void serializeMatrix(std::ostream& os, const Matrix<float>& matrix) {
     serializer->serialize(os);
 }
 
-Matrix<float> deserializeMatrix(std::istream& is) {
+// Keys remember where their tag was found, which speeds up reading
+// many matrices. A Key updates this hint on lookups, so every thread
+// needs its own keys (no static ones).
+struct MatrixKeys {
+    BTC::BTagCompound::Key row;
+    BTC::BTagCompound::Key col;
+    BTC::BTagCompound::Key data;
+
+    MatrixKeys() : row("row"), col("col"), data("data") {}
+};
+
+Matrix<float> deserializeMatrix(std::istream& is, const MatrixKeys& keys) {
     BTC::BTagCompoundPtr serializer(new BTC::BTagCompound());
     serializer->deserialize(is);
     // Create new matrix
-    Matrix<float> result(serializer->getValue<BTC::UINT32_T>("row"),
-                          serializer->getValue<BTC::UINT32_T>("col"));
+    Matrix<float> result(serializer->getValue<BTC::UINT32_T>(keys.row),
+                          serializer->getValue<BTC::UINT32_T>(keys.col));
     BTC::SIZE_T len;
     float* data = result.getDataPtr();
-    BTC::FLOAT_T* deserialized_data = serializer->getArray<BTC::FLOAT_T>("data",len);
+    BTC::FLOAT_T* deserialized_data = serializer->getArray<BTC::FLOAT_T>(keys.data,len);
     for (size_t i=0; i<len; ++i) {
         data[i] = deserialized_data[i];
     }
@@ -91,7 +102,8 @@ int main() {
     std::stringstream ss;
     serializeMatrix(ss,mat);
     // Deserialize the matrix from stream
-    Matrix<float> new_mat = deserializeMatrix(ss);
+    MatrixKeys keys;
+    Matrix<float> new_mat = deserializeMatrix(ss,keys);
     std::cout << "Deserialized matrix" << std::endl;
     new_mat.print(std::cout);
 
@@ -0,0 +1,525 @@
+// Round trips of the encoded arrays: the decoded elements have to equal
+// the input bit for bit, whichever way the compound was written.
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+
+#include "BTC.h"
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        exit(1);
+    }
+}
+
+template<typename T>
+void checkBits(const BTC::BTagCompound& comp, const char* tag, const std::vector<T>& values,
+        const std::string& what) {
+    BTC::SIZE_T len = 0;
+    const T* data = comp.getArray<T>(tag,len);
+    check(len == values.size(), what + " " + tag + ": length");
+    check((len == 0) || (std::memcmp(data,&values[0],len*sizeof(T)) == 0),
+            what + " " + tag + ": elements");
+}
+
+// The writer gives the entry count the size of a placeholder (9 bytes),
+// the entries have to be the same bytes as in buffer (count of 2 bytes).
+template<typename T>
+void checkWritten(const BTC::BTagWriter& writer, const std::vector<char>& buffer, 
+        const char* tag, const std::vector<T>& values) {
+    check((writer.size() == buffer.size()+7) && 
+            (std::memcmp(writer.data()+9,&buffer[2],buffer.size()-2) == 0),
+            std::string("BTagWriter ") + tag);
+    BTC::BTagCompound decoded;
+    decoded.deserializeFrom(writer.data(),writer.size());
+    checkBits(decoded,tag,values,"BTagWriter");
+}
+
+// Writes comp (holding only tag) with serializeTo(), serialize(ostream)
+// and BTagWriter, all have to give the same entry and decode to values.
+template<typename T>
+void checkArray(const BTC::BTagCompound& comp, const char* tag, const std::vector<T>& values) {
+    std::vector<char> buffer;
+    BTC::SIZE_T size = comp.serializeTo(buffer);
+    check(size == comp.getByteSize(), std::string("getByteSize() ") + tag);
+    BTC::BTagCompound decoded;
+    decoded.deserializeFrom(&buffer[0],buffer.size());
+    checkBits(decoded,tag,values,"serializeTo()");
+    std::vector<char> again;
+    decoded.serializeTo(again);
+    check(again == buffer, std::string("serializeTo() of the decoded array ") + tag);
+
+    std::ostringstream os;
+    comp.serialize(os);
+    std::string stream = os.str();
+    check(std::string(buffer.begin(),buffer.end()) == stream, std::string("serialize(ostream) ") + tag);
+    std::istringstream is(stream);
+    BTC::BTagCompound from_stream;
+    from_stream.deserialize(is);
+    checkBits(from_stream,tag,values,"deserialize(istream)");
+
+    BTC::BTagWriter writer;
+    writer.beginCompound();
+    writer.writeTag(tag,*comp.getTag<BTC::serialize_::IBTagBase>(tag));
+    writer.endCompound();
+    checkWritten(writer,buffer,tag,values);
+}
+
+// Sets the values with one of the setters of the encoded arrays, e.g.
+// &BTC::BTagCompound::setDeltaArray, and checks the round trips.
+// The compound points to the values, they are taken by copy.
+template<typename T>
+void checkEncoded(void (BTC::BTagCompound::*setter)(const std::string&, T*, BTC::SIZE_T),
+        const char* tag, std::vector<T> values) {
+    BTC::BTagCompound comp;
+    (comp.*setter)(tag,values.empty() ? (T*)0 : &values[0],values.size());
+    checkArray(comp,tag,values);
+}
+
+// Pseudo random numbers (64 bit LCG, the high bits are used).
+BTC::UINT64_T nextRandom(BTC::UINT64_T& state) {
+    const BTC::UINT64_T multiplier = (BTC::UINT64_T(0x5851F42Du) << 32) | 0x4C957F2Du;
+    state = state*multiplier + 1;
+    return state;
+}
+
+// n values of exactly bits bits above a base.
+template<typename T>
+std::vector<T> makeFrame(unsigned bits, BTC::SIZE_T n, BTC::UINT64_T seed) {
+    const T mask = (bits == 0) ? T(0) : T(~T(0) >> (8*sizeof(T)-bits));
+    const T base = (bits == 8*sizeof(T)) ? T(0) : T(seed*977);
+    std::vector<T> values(n);
+    for (BTC::SIZE_T i=0; i<n; ++i) {
+        values[i] = T(base + (T(nextRandom(seed) >> (64-8*sizeof(T))) & mask));
+    }
+    if (n > 1) {
+        // both ends of the frame
+        values[0] = base;
+        values[n-1] = T(base + mask);
+    }
+    return values;
+}
+
+void testBitPacked() {
+    // every width, lengths with full and partial blocks
+    const BTC::SIZE_T lengths[] = {1, 7, 127, 128, 129, 1000};
+    for (unsigned bits=0; bits<=32; ++bits) {
+        for (BTC::SIZE_T k=0; k<sizeof(lengths)/sizeof(lengths[0]); ++k) {
+            checkEncoded(&BTC::BTagCompound::setPackedArray,"packed32",
+                    makeFrame<BTC::UINT32_T>(bits,lengths[k],bits*31+k));
+        }
+    }
+    for (unsigned bits=0; bits<=64; ++bits) {
+        for (BTC::SIZE_T k=0; k<sizeof(lengths)/sizeof(lengths[0]); ++k) {
+            checkEncoded(&BTC::BTagCompound::setPackedArray,"packed64",
+                    makeFrame<BTC::UINT64_T>(bits,lengths[k],bits*31+k));
+        }
+    }
+
+    // blocks of different widths in one array
+    std::vector<BTC::UINT64_T> mixed;
+    for (int bits=64; bits>0; bits-=3) {
+        std::vector<BTC::UINT64_T> block = makeFrame<BTC::UINT64_T>(unsigned(bits),128,bits);
+        mixed.insert(mixed.end(),block.begin(),block.end());
+    }
+    checkEncoded(&BTC::BTagCompound::setPackedArray,"mixed",mixed);
+
+    checkEncoded(&BTC::BTagCompound::setPackedArray,"empty",std::vector<BTC::UINT32_T>());
+}
+
+// Streams the values in chunks of 1, 2, 3, ... elements.
+template<typename F>
+void checkXorStream(const char* tag, BTC::UINT8_T type_id, const std::vector<F>& values) {
+    BTC::BTagWriter writer;
+    writer.beginCompound();
+    writer.beginArray(tag,type_id);
+    for (BTC::SIZE_T i=0, n=1; i<values.size(); i+=n, ++n) {
+        writer.writeArrayChunk(&values[i],std::min(n,values.size()-i));
+    }
+    writer.endArray();
+    writer.endCompound();
+    BTC::BTagCompound decoded;
+    decoded.deserializeFrom(writer.data(),writer.size());
+    checkBits(decoded,tag,values,"BTagWriter chunks");
+}
+
+template<typename F, typename W>
+F fromBits(W bits) {
+    F value;
+    std::memcpy(&value,&bits,sizeof(F));
+    return value;
+}
+
+void testXor() {
+    // NaN payloads, signed zeros, infinities, denormals and the limits
+    const BTC::UINT32_T float_bits[] = {
+        0x7FC00000u, 0xFFC00000u, 0x7F800001u, 0x7FBFFFFFu, 0xFFFFFFFFu, 0x7FC12345u,
+        0x00000000u, 0x80000000u, 0x7F800000u, 0xFF800000u,
+        0x00000001u, 0x80000001u, 0x007FFFFFu, 0x807FFFFFu, 0x00800000u,
+        0x7F7FFFFFu, 0xFF7FFFFFu, 0x3F800000u, 0x3F800000u, 0x3F800001u};
+    std::vector<BTC::FLOAT_T> floats;
+    for (BTC::SIZE_T i=0; i<sizeof(float_bits)/sizeof(float_bits[0]); ++i) {
+        floats.push_back(fromBits<BTC::FLOAT_T>(float_bits[i]));
+    }
+    const BTC::UINT64_T quiet = BTC::UINT64_T(0x7FF80000u) << 32;
+    const BTC::UINT64_T sign = BTC::UINT64_T(1) << 63;
+    const BTC::UINT64_T infinity = BTC::UINT64_T(0x7FF00000u) << 32;
+    const BTC::UINT64_T max_denormal = (BTC::UINT64_T(0x000FFFFFu) << 32) | 0xFFFFFFFFu;
+    const BTC::UINT64_T double_bits[] = {
+        quiet, quiet | sign, infinity | 1, quiet | 0xDEADBEEFu, ~BTC::UINT64_T(0),
+        0, sign, infinity, infinity | sign,
+        1, sign | 1, max_denormal, sign | max_denormal, max_denormal+1,
+        (BTC::UINT64_T(0x7FEFFFFFu) << 32) | 0xFFFFFFFFu, BTC::UINT64_T(0x3FF00000u) << 32,
+        BTC::UINT64_T(0x3FF00000u) << 32, (BTC::UINT64_T(0x3FF00000u) << 32) | 1};
+    std::vector<BTC::DOUBLE_T> doubles;
+    for (BTC::SIZE_T i=0; i<sizeof(double_bits)/sizeof(double_bits[0]); ++i) {
+        doubles.push_back(fromBits<BTC::DOUBLE_T>(double_bits[i]));
+    }
+    // a slowly changing series after the special values
+    BTC::UINT64_T state = 1;
+    for (BTC::SIZE_T i=0; i<2000; ++i) {
+        floats.push_back(BTC::FLOAT_T(20+0.01*(i%100)) + BTC::FLOAT_T(nextRandom(state) >> 62));
+        doubles.push_back(20+0.01*(i%100) + BTC::DOUBLE_T(nextRandom(state) >> 40));
+    }
+    checkEncoded(&BTC::BTagCompound::setXorArray,"floats",floats);
+    checkEncoded(&BTC::BTagCompound::setXorArray,"doubles",doubles);
+    checkXorStream("floats",BTC::serialize_::DataTypeID::XOR_FLOAT_ARR,floats);
+    checkXorStream("doubles",BTC::serialize_::DataTypeID::XOR_DOUBLE_ARR,doubles);
+    checkEncoded(&BTC::BTagCompound::setXorArray,"empty",std::vector<BTC::DOUBLE_T>());
+    checkXorStream("empty",BTC::serialize_::DataTypeID::XOR_DOUBLE_ARR,std::vector<BTC::DOUBLE_T>());
+}
+
+void testVarint() {
+    // differences wrap around in both directions
+    std::vector<BTC::UINT32_T> wrap32;
+    wrap32.push_back(5);
+    wrap32.push_back(3);
+    wrap32.push_back(0xFFFFFFFFu);
+    wrap32.push_back(0);
+    wrap32.push_back(0x80000000u);
+    wrap32.push_back(0x7FFFFFFFu);
+    wrap32.push_back(0xFFFFFFFFu);
+    checkEncoded(&BTC::BTagCompound::setDeltaArray,"wrap32",wrap32);
+    checkEncoded(&BTC::BTagCompound::setZigzagArray,"wrap32",wrap32);
+
+    const BTC::UINT64_T max64 = ~BTC::UINT64_T(0);
+    const BTC::UINT64_T top64 = BTC::UINT64_T(1) << 63;
+    std::vector<BTC::UINT64_T> wrap64;
+    wrap64.push_back(0);
+    wrap64.push_back(max64);
+    wrap64.push_back(1);
+    wrap64.push_back(top64);
+    wrap64.push_back(top64-1);
+    wrap64.push_back(max64);
+    wrap64.push_back(0);
+    checkEncoded(&BTC::BTagCompound::setDeltaArray,"wrap64",wrap64);
+    checkEncoded(&BTC::BTagCompound::setZigzagArray,"wrap64",wrap64);
+
+    // signed numbers, zigzag keeps small magnitudes short
+    std::vector<BTC::UINT32_T> signed32;
+    for (int i=-300; i<300; ++i) {
+        signed32.push_back(BTC::UINT32_T(i*(i%3-1)*1000));
+    }
+    signed32.push_back(0x80000000u);
+    signed32.push_back(0x7FFFFFFFu);
+    checkEncoded(&BTC::BTagCompound::setZigzagArray,"signed32",signed32);
+
+    // timestamps: deltas of every varint length, long enough for the
+    // 8 byte decoder path
+    std::vector<BTC::UINT64_T> times;
+    BTC::UINT64_T time = BTC::UINT64_T(1700000000) * 1000;
+    for (BTC::UINT64_T i=0; i<10000; ++i) {
+        time += (i%5 == 0) ? (i*i*i*i) : (i%7);
+        times.push_back(time);
+    }
+    checkEncoded(&BTC::BTagCompound::setDeltaArray,"times",times);
+
+    // runs of one and two byte varints (the 16 byte decoder path),
+    // broken by longer ones
+    std::vector<BTC::UINT32_T> runs32;
+    std::vector<BTC::UINT64_T> runs64;
+    BTC::UINT32_T run = 0;
+    for (BTC::UINT32_T i=0; i<2000; ++i) {
+        BTC::UINT32_T segment = (i/37)%3;
+        run += (segment == 0) ? (i%60) : ((segment == 1) ? (64+i%8000) : (i*i));
+        runs32.push_back(run);
+        runs64.push_back((BTC::UINT64_T(1) << 40)+run);
+    }
+    checkEncoded(&BTC::BTagCompound::setDeltaArray,"runs32",runs32);
+    checkEncoded(&BTC::BTagCompound::setZigzagArray,"runs32",runs32);
+    checkEncoded(&BTC::BTagCompound::setDeltaArray,"runs64",runs64);
+
+    checkEncoded(&BTC::BTagCompound::setDeltaArray,"empty",std::vector<BTC::UINT32_T>());
+}
+
+// A compound written by the library before floats were stored by their
+// IEEE-754 bits: compound, float, double and array type IDs 0, 6, 7, 64,
+// 69 and 70 (see checkLegacy() for the values).
+const signed char legacy_bytes[] = {
+    0, 6, 1, 102, 6, 0, 0, 64, -64, 1, 100, 7, 23, -59, 87, -54,
+    -123, -31, -17, 68, 2, 102, 97, 69, 0, 7, 0, 0, -128, 127, 0, 0,
+    -128, -64, 0, 0, -48, 64, 8, -27, -68, 30, -1, -1, -1, 127, 0, 0,
+    0, 1, 0, 0, -64, 127, 2, 100, 97, 70, 0, 5, 0, 0, 0, 0,
+    0, 0, -16, 127, -102, -103, -103, -103, -103, -103, -55, -65, -100, 117, 0, -120,
+    60, -28, 71, 126, 0, 0, 0, 0, 0, 0, 32, 0, 0, 0, 0, 0,
+    0, 0, -8, -1, 2, 115, 97, 64, 0, 3, 0, 2, 97, 98, 0, 0,
+    0, 3, 99, 100, 101, 1, 99, 0, 0, 2, 1, 105, 4, 64, -30, 1,
+    0, 1, 102, 6, -51, -52, 76, 62};
+
+std::vector<BTC::FLOAT_T> legacyFloats() {
+    const BTC::UINT32_T bits[] = {
+        0x00000000u, 0xC0000000u, 0x40500000u, 0x1E3CE508u, 0x7F7FFFFFu, 0x00800000u, 0x7F800000u};
+    std::vector<BTC::FLOAT_T> values;
+    for (BTC::SIZE_T i=0; i<sizeof(bits)/sizeof(bits[0]); ++i) {
+        values.push_back(fromBits<BTC::FLOAT_T>(bits[i]));
+    }
+    return values;
+}
+
+std::vector<BTC::DOUBLE_T> legacyDoubles() {
+    const BTC::UINT64_T bits[] = {
+        0, (BTC::UINT64_T(0xBFB99999u) << 32) | 0x9999999Au,
+        (BTC::UINT64_T(0x7E37E43Cu) << 32) | 0x8800759Cu,
+        BTC::UINT64_T(0x00100000u) << 32, BTC::UINT64_T(0xFFF00000u) << 32};
+    std::vector<BTC::DOUBLE_T> values;
+    for (BTC::SIZE_T i=0; i<sizeof(bits)/sizeof(bits[0]); ++i) {
+        values.push_back(fromBits<BTC::DOUBLE_T>(bits[i]));
+    }
+    return values;
+}
+
+void checkLegacy(const BTC::BTagCompound& comp, const std::string& what) {
+    check(comp.getValue<BTC::FLOAT_T>("f") == -1.5f, what + " f");
+    check(comp.getValue<BTC::DOUBLE_T>("d") == 6.02214076e23, what + " d");
+    checkBits(comp,"fa",legacyFloats(),what);
+    checkBits(comp,"da",legacyDoubles(),what);
+    BTC::SIZE_T len = 0;
+    const std::string* strings = comp.getArray<std::string>("sa",len);
+    check((len == 3) && (strings[0] == "ab") && strings[1].empty() && (strings[2] == "cde"), 
+            what + " sa");
+    BTC::BTagCompoundConstPtr inner = comp.getTag<BTC::BTagCompound>("c");
+    check(inner->getValue<BTC::UINT32_T>("i") == 123456, what + " c.i");
+    check(inner->getValue<BTC::FLOAT_T>("f") == 0.1f, what + " c.f");
+}
+
+// Collects the numbers and strings in the order they are read.
+struct LegacyEvents : BTC::BTagHandler {
+    std::vector<BTC::FLOAT_T> floats;
+    std::vector<BTC::DOUBLE_T> doubles;
+    std::vector<std::string> strings;
+    BTC::UINT32_T integer;
+
+    LegacyEvents() : floats(), doubles(), strings(), integer(0) {}
+
+    void floatValue(BTC::FLOAT_T value) {
+        floats.push_back(value);
+    }
+
+    void doubleValue(BTC::DOUBLE_T value) {
+        doubles.push_back(value);
+    }
+
+    void intValue(BTC::UINT32_T value) {
+        integer = value;
+    }
+
+    void stringValue(const char* data, BTC::SIZE_T len) {
+        strings.push_back(std::string(data,len));
+    }
+
+    void floatChunk(const BTC::FLOAT_T* data, BTC::SIZE_T n) {
+        floats.insert(floats.end(),data,data+n);
+    }
+
+    void doubleChunk(const BTC::DOUBLE_T* data, BTC::SIZE_T n) {
+        doubles.insert(doubles.end(),data,data+n);
+    }
+};
+
+void testLegacy() {
+    const std::string data(reinterpret_cast<const char*>(legacy_bytes),sizeof(legacy_bytes));
+    BTC::BTagCompound from_memory;
+    from_memory.deserializeFrom(data.data(),data.size());
+    checkLegacy(from_memory,"legacy deserializeFrom()");
+    std::istringstream is(data);
+    BTC::BTagCompound from_stream;
+    from_stream.deserialize(is);
+    checkLegacy(from_stream,"legacy deserialize(istream)");
+    BTC::BTagCompound lazy;
+    lazy.deserializeLazy(data.data(),data.size());
+    checkLegacy(lazy,"legacy deserializeLazy()");
+
+    // written again in the current layout
+    std::vector<char> buffer;
+    from_memory.serializeTo(buffer);
+    BTC::BTagCompound rewritten;
+    rewritten.deserializeFrom(&buffer[0],buffer.size());
+    checkLegacy(rewritten,"legacy rewritten");
+    BTC::BTagCompoundView rewritten_view(&buffer[0],buffer.size());
+    check((rewritten_view.getTypeID("fa") == BTC::serialize_::DataTypeID::FLOAT_ARR) &&
+            (rewritten_view.getTypeID("c") == BTC::serialize_::DataTypeID::COMPOUND),
+            "legacy rewritten type IDs");
+
+    // the view converts numbers, legacy arrays cannot be viewed
+    BTC::BTagCompoundView view(data.data(),data.size());
+    check(view.getValue<BTC::FLOAT_T>("f") == -1.5f, "legacy view f");
+    check(view.getValue<BTC::DOUBLE_T>("d") == 6.02214076e23, "legacy view d");
+    check(view.getCompound("c").getValue<BTC::FLOAT_T>("f") == 0.1f, "legacy view c.f");
+    check(view.getArraySize("da") == 5, "legacy view array size");
+    bool thrown = false;
+    try {
+        view.getArray<BTC::FLOAT_T>("fa");
+    } catch (wrong_type_error&) {
+        thrown = true;
+    }
+    check(thrown,"legacy view getArray()");
+
+    BTC::BTagReader reader;
+    LegacyEvents events;
+    BTC::BufferSource source(data.data(),data.size());
+    reader.read(source,events);
+    std::vector<BTC::FLOAT_T> floats(1,-1.5f);
+    std::vector<BTC::FLOAT_T> legacy_floats = legacyFloats();
+    floats.insert(floats.end(),legacy_floats.begin(),legacy_floats.end());
+    floats.push_back(0.1f);
+    std::vector<BTC::DOUBLE_T> doubles(1,6.02214076e23);
+    std::vector<BTC::DOUBLE_T> legacy_doubles = legacyDoubles();
+    doubles.insert(doubles.end(),legacy_doubles.begin(),legacy_doubles.end());
+    check((events.floats.size() == floats.size()) && 
+            (std::memcmp(&events.floats[0],&floats[0],floats.size()*sizeof(BTC::FLOAT_T)) == 0),
+            "legacy reader floats");
+    check((events.doubles.size() == doubles.size()) && 
+            (std::memcmp(&events.doubles[0],&doubles[0],doubles.size()*sizeof(BTC::DOUBLE_T)) == 0),
+            "legacy reader doubles");
+    check((events.strings.size() == 3) && (events.strings[2] == "cde") && (events.integer == 123456),
+            "legacy reader strings and integer");
+}
+
+// A compound with one array "a" of the type whose length is 2^62,
+// without any elements behind it.
+std::string hugeArray(BTC::UINT8_T type_id) {
+    const char bytes[] = {0, 1, 1, 'a', char(type_id), 3, 0, 0, 0, 0, 0, 0, 0, 0x40};
+    return std::string(bytes,sizeof(bytes));
+}
+
+bool rejected(const std::string& data, BTC::container_::Arena* arena) {
+    BTC::BTagCompound comp;
+    try {
+        if (arena) {
+            comp.deserializeFrom(data.data(),data.size(),*arena);
+        } else {
+            comp.deserializeFrom(data.data(),data.size());
+        }
+    } catch (buffer_overflow_error&) {
+        return true;
+    }
+    return false;
+}
+
+bool viewRejected(const std::string& data) {
+    try {
+        BTC::BTagCompoundView view(data.data(),data.size());
+    } catch (buffer_overflow_error&) {
+        return true;
+    }
+    return false;
+}
+
+bool lazyRejected(const std::string& data) {
+    BTC::BTagCompound comp;
+    try {
+        comp.deserializeLazy(data.data(),data.size());
+    } catch (buffer_overflow_error&) {
+        return true;
+    }
+    return false;
+}
+
+bool sliceRejected(const std::vector<char>& data) {
+    BTC::UINT32_T out[10];
+    try {
+        BTC::BTagCompoundView view(&data[0],data.size());
+        view.getSlice("c",0,10,out);
+    } catch (buffer_overflow_error&) {
+        return true;
+    } catch (unknown_type_error&) {
+        return true;
+    }
+    return false;
+}
+
+void testMalformed() {
+    BTC::container_::Arena arena;
+    for (BTC::UINT8_T type_id=BTC::serialize_::DataTypeID::UINT8_ARR; 
+            type_id<=BTC::serialize_::DataTypeID::DOUBLE_ARR; ++type_id) {
+        check(rejected(hugeArray(type_id),0),"array longer than the data");
+        check(rejected(hugeArray(type_id),&arena),"array longer than the data, arena");
+        check(viewRejected(hugeArray(type_id)),"array longer than the data, view");
+        check(lazyRejected(hugeArray(type_id)),"array longer than the data, lazy");
+    }
+
+    // chunks of the wrong type or length
+    std::vector<BTC::UINT32_T> values(10,7);
+    BTC::BTagCompound comp;
+    comp.setChunkedArray("c",BTC::serialize_::DataTypeID::UINT32_ARR,&values[0],values.size(),4);
+    std::vector<char> chunked;
+    comp.serializeTo(chunked);
+    check(!sliceRejected(chunked),"chunked array slice");
+    // count, tag, type and byte size, then the type of the chunks
+    const BTC::SIZE_T type_pos = 7;
+    // behind it the length, the chunk length and the table of 3 offsets
+    const BTC::SIZE_T first_chunk = type_pos + 1 + 2 + 2 + 3*8;
+    std::vector<char> wrong_type(chunked);
+    wrong_type[type_pos] = char(BTC::serialize_::DataTypeID::UINT16_ARR);
+    check(sliceRejected(wrong_type),"chunks of another type");
+    wrong_type[type_pos] = char(200);
+    check(sliceRejected(wrong_type),"chunks of an unknown type");
+    std::vector<char> short_chunk(chunked);
+    short_chunk[first_chunk+1] = 3;
+    check(sliceRejected(short_chunk),"chunk shorter than the chunk length");
+
+    bool thrown = false;
+    try {
+        arena.allocateArray<BTC::UINT64_T>(BTC::SIZE_T(1) << 62);
+    } catch (std::bad_alloc&) {
+        thrown = true;
+    }
+    check(thrown,"Arena::allocateArray() size overflow");
+}
+
+// Arrays read into an arena belong to it, retrieveArray() hands out a
+// copy the caller deletes.
+void testArena() {
+    std::vector<BTC::UINT32_T> values(100);
+    for (BTC::SIZE_T i=0; i<values.size(); ++i) {
+        values[i] = BTC::UINT32_T(i*i);
+    }
+    BTC::BTagCompound comp;
+    comp.setIntArray("a",&values[0],values.size());
+    std::vector<char> buffer;
+    comp.serializeTo(buffer);
+    BTC::container_::Arena arena;
+    BTC::BTagCompound decoded;
+    decoded.deserializeFrom(&buffer[0],buffer.size(),arena);
+    BTC::SIZE_T len = 0;
+    BTC::UINT32_T* data = decoded.retrieveArray<BTC::UINT32_T>("a",len);
+    check(len == values.size() && std::memcmp(data,&values[0],len*sizeof(BTC::UINT32_T)) == 0,
+            "retrieveArray() of an arena array");
+    delete[] data;
+    checkBits(decoded,"a",values,"arena array after retrieveArray()");
+}
+
+int main() {
+    testVarint();
+    testBitPacked();
+    testXor();
+    testLegacy();
+    testMalformed();
+    testArena();
+    std::cout << "OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,144 @@
+// Reading record logs: the index, the scan without one and the recovery
+// behind torn writes and damaged records.
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+#include "BTC.h"
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        exit(1);
+    }
+}
+
+// n records of the same size: the id and a name.
+std::string writeLog(BTC::SIZE_T n, bool indexed) {
+    std::ostringstream log;
+    BTC::RecordLogWriter writer(log,indexed);
+    for (BTC::SIZE_T i=0; i<n; ++i) {
+        BTC::BTagCompound record;
+        record.setLong("id",BTC::UINT64_T(i));
+        record.setString("name",std::string("record"));
+        writer.append(record);
+    }
+    writer.close();
+    return log.str();
+}
+
+// The ids of all records in the order of the log.
+std::vector<BTC::UINT64_T> readIds(const BTC::RecordLogReader& reader) {
+    std::vector<BTC::UINT64_T> ids;
+    BTC::BTagCompound record;
+    for (BTC::SIZE_T k=0; k<reader.size(); ++k) {
+        reader.read(k,record);
+        ids.push_back(record.getValue<BTC::UINT64_T>("id"));
+    }
+    return ids;
+}
+
+// The ids 0..n-1 without skipped.
+std::vector<BTC::UINT64_T> expectedIds(BTC::UINT64_T n, BTC::UINT64_T skipped) {
+    std::vector<BTC::UINT64_T> ids;
+    for (BTC::UINT64_T i=0; i<n; ++i) {
+        if (i != skipped) {
+            ids.push_back(i);
+        }
+    }
+    return ids;
+}
+
+void testIndex() {
+    const BTC::SIZE_T n = 10;
+    std::string data = writeLog(n,true);
+    BTC::RecordLogReader reader(data.data(),data.size());
+    check(reader.isIndexed() && (reader.size() == n), "indexed log");
+    check(readIds(reader) == expectedIds(n,n), "indexed log ids");
+
+    // a record read into a used compound replaces its entries
+    BTC::BTagCompound record;
+    reader.read(9,record);
+    reader.read(8,record);
+    check((record.size() == 2) && (record.getValue<BTC::UINT64_T>("id") == 8),
+            "read() into a used compound");
+
+    // without its last byte the index is ignored
+    std::string torn = data.substr(0,data.size()-1);
+    BTC::RecordLogReader scanned(torn.data(),torn.size());
+    check(!scanned.isIndexed() && (readIds(scanned) == expectedIds(n,n)), "torn index");
+}
+
+void testRecovery() {
+    const BTC::SIZE_T n = 10;
+    const std::string data = writeLog(n,false);
+    const BTC::SIZE_T record_size = (data.size()-BTC::serialize_::RecordLog::HEADER_SIZE)/n;
+    {
+        BTC::RecordLogReader reader(data.data(),data.size());
+        check(!reader.isIndexed() && (reader.getDamagedByteCount() == 0) &&
+                (readIds(reader) == expectedIds(n,n)), "scanned log");
+    }
+
+    // torn write: the last record is cut off
+    for (BTC::SIZE_T cut=1; cut<record_size; cut+=7) {
+        std::string torn = data.substr(0,data.size()-cut);
+        BTC::RecordLogReader reader(torn.data(),torn.size());
+        check((readIds(reader) == expectedIds(n-1,n)) &&
+                (reader.getDamagedByteCount() == record_size-cut), "torn last record");
+    }
+
+    // a damaged record is skipped up to the next sync marker, whichever
+    // byte of it is changed
+    for (BTC::SIZE_T byte=0; byte<record_size; ++byte) {
+        std::string damaged = data;
+        damaged[BTC::serialize_::RecordLog::HEADER_SIZE+3*record_size+byte] ^= 0x55;
+        BTC::RecordLogReader reader(damaged.data(),damaged.size());
+        check((readIds(reader) == expectedIds(n,3)) &&
+                (reader.getDamagedByteCount() == record_size), "damaged record");
+    }
+
+    // garbage between the records
+    std::string garbage = data;
+    garbage.insert(BTC::serialize_::RecordLog::HEADER_SIZE+5*record_size,std::string(13,'\xB7'));
+    BTC::RecordLogReader reader(garbage.data(),garbage.size());
+    check((readIds(reader) == expectedIds(n,n)) && (reader.getDamagedByteCount() == 13),
+            "garbage between records");
+}
+
+// With an index a damaged record is only found when it is read.
+void testDamagedIndexed() {
+    const BTC::SIZE_T n = 10;
+    std::string data = writeLog(n,true);
+    std::string plain = writeLog(n,false);
+    const BTC::SIZE_T record_size = (plain.size()-BTC::serialize_::RecordLog::HEADER_SIZE)/n;
+    data[BTC::serialize_::RecordLog::HEADER_SIZE+2*record_size+record_size/2] ^= 1;
+    BTC::RecordLogReader reader(data.data(),data.size());
+    check(reader.isIndexed() && (reader.size() == n), "damaged indexed log");
+    BTC::BTagCompound record;
+    reader.read(1,record);
+    bool thrown = false;
+    try {
+        reader.read(2,record);
+    } catch (format_error&) {
+        thrown = true;
+    }
+    check(thrown,"damaged record in an indexed log");
+
+    thrown = false;
+    try {
+        BTC::RecordLogReader other(data.data(),3);
+    } catch (format_error&) {
+        thrown = true;
+    }
+    check(thrown,"log without a header");
+}
+
+int main() {
+    testIndex();
+    testRecovery();
+    testDamagedIndexed();
+    std::cout << "OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,250 @@
+// Checks of the thread safe parts (ATOMIC_REFCOUNT).
+// Build with "make tsan" to run them under the thread sanitizer.
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdlib>
+
+#include "BTC.h"
+
+void check(bool condition, const char* what) {
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        exit(1);
+    }
+}
+
+std::string key(const char* prefix, size_t i) {
+    return prefix + std::to_string(i);
+}
+
+// Lazy tags that share an arena are loaded in several threads at once.
+void testLazyArena(unsigned nthreads) {
+    const size_t n = 2000;
+    std::vector<BTC::UINT32_T> values(n*32);
+    BTC::BTagCompound comp;
+    for (size_t i=0; i<n; ++i) {
+        BTC::BTagCompoundPtr section(new BTC::BTagCompound());
+        section->setInt("id",BTC::UINT32_T(i));
+        for (size_t j=0; j<32; ++j) {
+            values[i*32+j] = BTC::UINT32_T(i*j);
+        }
+        section->setIntArray("values",&values[i*32],32);
+        comp.setTag(key("section",i),section);
+    }
+    std::vector<char> data;
+    comp.serializeTo(data);
+
+    BTC::container_::Arena arena(1024);
+    BTC::BTagCompound loaded;
+    BTC::BufferSource source(&data[0],data.size());
+    source.setArena(&arena);
+    source.setLazy(true);
+    loaded.deserialize(source);
+
+    const BTC::BTagCompound& shared = loaded;
+    std::atomic<size_t> errors(0);
+    std::atomic<bool> start(false);
+    std::vector<std::thread> threads;
+    for (unsigned t=0; t<nthreads; ++t) {
+        threads.push_back(std::thread([&shared,&errors,&start,n,t]() {
+            while (!start) {
+                std::this_thread::yield();
+            }
+            for (size_t k=0; k<n; ++k) {
+                size_t i = (k+t*37)%n;
+                BTC::ptr_::SharedConstObjPtr<BTC::BTagCompound> section =
+                        shared.getTag<BTC::BTagCompound>(key("section",i));
+                BTC::SIZE_T len = 0;
+                const BTC::UINT32_T* values = section->getArray<BTC::UINT32_T>("values",len);
+                if (section->getValue<BTC::UINT32_T>("id") != i || len != 32 || values[31] != i*31) {
+                    ++errors;
+                }
+            }
+        }));
+    }
+    start = true;
+    for (size_t t=0; t<threads.size(); ++t) {
+        threads[t].join();
+    }
+    check(errors == 0,"lazy tags sharing an arena");
+}
+
+// parallelSerialize() has to write the same bytes as serializeTo() for
+// every thread count and size threshold.
+void testParallelSerialize() {
+    const size_t n = 20000;
+    std::vector<BTC::DOUBLE_T> doubles(n);
+    std::vector<BTC::UINT64_T> times(n);
+    std::vector<BTC::UINT32_T> ints(n);
+    for (size_t i=0; i<n; ++i) {
+        doubles[i] = 0.25*i;
+        times[i] = BTC::UINT64_T(1700000000)*1000 + i*i;
+        ints[i] = BTC::UINT32_T(i*2654435761u);
+    }
+    BTC::BTagCompound comp;
+    comp.setInt("id",BTC::UINT32_T(7));
+    comp.setString("name",std::string("parallel"));
+    comp.setDoubleArray("doubles",&doubles[0],n);
+    comp.setChunkedArray("chunked",BTC::serialize_::DataTypeID::UINT32_ARR,&ints[0],n,1000);
+    comp.setDeltaArray("times",&times[0],n);
+    comp.setXorArray("xor",&doubles[0],n);
+    for (size_t i=0; i<4; ++i) {
+        BTC::BTagCompoundPtr section(new BTC::BTagCompound());
+        section->setInt("id",BTC::UINT32_T(i));
+        section->setIntArray("ints",&ints[0],n/(i+1));
+        BTC::BTagCompoundPtr inner(new BTC::BTagCompound());
+        inner->setDoubleArray("doubles",&doubles[0],n/(i+2));
+        inner->setPackedArray("packed",&ints[0],n/(i+2));
+        section->setTag("inner",inner);
+        comp.setTag(key("section",i),section);
+    }
+    std::vector<char> expected;
+    comp.serializeTo(expected);
+
+    // the same tree read lazily, partly loaded
+    BTC::BTagCompound lazy;
+    lazy.deserializeLazy(&expected[0],expected.size());
+    lazy.getTag<BTC::BTagCompound>("section1")->getTag<BTC::BTagCompound>("inner");
+    lazy.getTag<BTC::BTagCompound>("section3");
+
+    const BTC::SIZE_T min_sizes[] = {1, 100, 10000, 100000, BTC::SIZE_T(1) << 20};
+    for (unsigned nthreads=1; nthreads<=4; ++nthreads) {
+        for (size_t k=0; k<sizeof(min_sizes)/sizeof(min_sizes[0]); ++k) {
+            std::vector<char> buffer;
+            BTC::parallelSerialize(comp,buffer,nthreads,min_sizes[k]);
+            check(buffer == expected,"parallelSerialize() equals serializeTo()");
+            BTC::parallelSerialize(lazy,buffer,nthreads,min_sizes[k]);
+            check(buffer == expected,"parallelSerialize() of a lazy compound");
+        }
+    }
+    std::vector<char> small(expected.size()-1);
+    bool thrown = false;
+    try {
+        BTC::parallelSerialize(comp,&small[0],small.size(),2);
+    } catch (buffer_overflow_error&) {
+        thrown = true;
+    }
+    check(thrown,"parallelSerialize() into a small buffer");
+}
+
+// Every record is decoded once, in order if requested.
+void testParallelDecode() {
+    const size_t n = 1000;
+    std::ostringstream log;
+    BTC::RecordLogWriter writer(log);
+    for (size_t i=0; i<n; ++i) {
+        BTC::BTagCompound record;
+        record.setLong("id",BTC::UINT64_T(i));
+        record.setString("name",key("record",i));
+        writer.append(record);
+    }
+    writer.close();
+    std::string data = log.str();
+    BTC::RecordLogReader reader(data.data(),data.size());
+
+    const BTC::SIZE_T batch_sizes[] = {0, 1, 7, 64, 5000};
+    for (unsigned nthreads=1; nthreads<=4; ++nthreads) {
+        for (size_t k=0; k<sizeof(batch_sizes)/sizeof(batch_sizes[0]); ++k) {
+            std::vector<std::atomic<int> > seen(n);
+            for (size_t i=0; i<n; ++i) {
+                seen[i] = 0;
+            }
+            std::atomic<size_t> errors(0);
+            BTC::parallelDecode(reader,nthreads,[&](BTC::SIZE_T i, const BTC::BTagCompound& record) {
+                if (record.getValue<BTC::UINT64_T>("id") != i || 
+                        record.getTag<BTC::serialize_::BTagString<std::string> >("name")->data != key("record",i)) {
+                    ++errors;
+                }
+                ++seen[i];
+            },false,batch_sizes[k]);
+            std::vector<BTC::SIZE_T> order;
+            BTC::parallelDecode(reader,nthreads,[&](BTC::SIZE_T i, const BTC::BTagCompound& record) {
+                if (record.getValue<BTC::UINT64_T>("id") != i) {
+                    ++errors;
+                }
+                order.push_back(i);
+            },true,batch_sizes[k]);
+            check(errors == 0,"parallelDecode() records");
+            for (size_t i=0; i<n; ++i) {
+                check(seen[i] == 1,"parallelDecode() decodes every record once");
+                check(order[i] == i,"parallelDecode() ordered");
+            }
+        }
+    }
+
+    // the first exception of the callback is rethrown
+    bool thrown = false;
+    try {
+        BTC::parallelDecode(reader,3,[&](BTC::SIZE_T i, const BTC::BTagCompound& record) {
+            if (i == n/2) {
+                throw std::runtime_error("callback");
+            }
+        },true,16);
+    } catch (std::runtime_error&) {
+        thrown = true;
+    }
+    check(thrown,"parallelDecode() rethrows");
+}
+
+// Readers never see a half written snapshot and the versions only grow.
+void testSnapshots(unsigned nreaders) {
+    const BTC::UINT32_T versions = 500;
+    BTC::SharedCompound settings;
+    {
+        BTC::SnapshotWriter writer(settings);
+        writer.root().setInt("version",BTC::UINT32_T(0));
+        writer.edit("limits.http").setInt("timeout",BTC::UINT32_T(0));
+        writer.edit("limits.http").setInt("retries",BTC::UINT32_T(0));
+        writer.edit("limits.smtp").setInt("timeout",BTC::UINT32_T(60));
+        writer.publish();
+    }
+    std::atomic<bool> done(false);
+    std::atomic<size_t> errors(0);
+    std::vector<std::thread> readers;
+    for (unsigned t=0; t<nreaders; ++t) {
+        readers.push_back(std::thread([&settings,&done,&errors]() {
+            BTC::SnapshotReader reader(settings);
+            BTC::UINT32_T last = 0;
+            while (!done) {
+                const BTC::BTagCompound& snapshot = reader.get();
+                BTC::UINT32_T version = snapshot.getValue<BTC::UINT32_T>("version");
+                BTC::ptr_::SharedConstObjPtr<BTC::BTagCompound> http = 
+                        snapshot.getTag<BTC::BTagCompound>("limits")->getTag<BTC::BTagCompound>("http");
+                if (version < last || http->getValue<BTC::UINT32_T>("timeout") != version ||
+                        http->getValue<BTC::UINT32_T>("retries") != version ||
+                        snapshot.getTag<BTC::BTagCompound>("limits")->getTag<BTC::BTagCompound>("smtp")
+                            ->getValue<BTC::UINT32_T>("timeout") != 60) {
+                    ++errors;
+                }
+                last = version;
+            }
+        }));
+    }
+    BTC::SnapshotWriter writer(settings);
+    for (BTC::UINT32_T v=1; v<=versions; ++v) {
+        writer.root().setInt("version",v);
+        writer.edit("limits.http").setInt("timeout",v);
+        writer.edit("limits.http").setInt("retries",v);
+        writer.publish();
+    }
+    done = true;
+    for (size_t t=0; t<readers.size(); ++t) {
+        readers[t].join();
+    }
+    check(errors == 0,"snapshots seen by readers");
+    check(settings.snapshot()->getValue<BTC::UINT32_T>("version") == versions,"last snapshot");
+}
+
+int main() {
+    testLazyArena(4);
+    testParallelSerialize();
+    testParallelDecode();
+    testSnapshots(3);
+    std::cout << "OK" << std::endl;
+    return 0;
+}